@@ -9,6 +9,7 @@
 #include "voxelizer.h" // needed for Triangle type definition
 #include <unordered_map>
 #include "cube.h"
+#include "windingnumber.h"
 
 namespace CGALHelper {
 
@@ -116,7 +117,8 @@ void openMeshBooleanIntersection(
     SurfaceMesh& openMesh,
     SurfaceMesh& closedMesh,
     const SideTester* const sideTester,
-    bool clipTriangles
+    bool clipTriangles,
+    const FastWindingNumber* const windingNumber
 ) {
     if (!CGAL::is_triangle_mesh(openMesh)) CGAL::Polygon_mesh_processing::triangulate_faces(openMesh);
     if (!CGAL::is_triangle_mesh(closedMesh)) CGAL::Polygon_mesh_processing::triangulate_faces(closedMesh);
@@ -150,8 +152,10 @@ void openMeshBooleanIntersection(
         const auto& p2 = closedMesh.point(target(next(halfedge, closedMesh), closedMesh));
         Point_3 centroid = CGAL::centroid(p0, p1, p2);
 
-        const auto side = (*sideTester)(centroid);
-        if (side == CGAL::ON_UNBOUNDED_SIDE) {
+        bool isOutside = windingNumber 
+            ? !windingNumber->isInside(MPoint(centroid.x(), centroid.y(), centroid.z()))
+            : (*sideTester)(centroid) == CGAL::ON_UNBOUNDED_SIDE;
+        if (isOutside) {
             // It's fine to modify the mesh while iterating over it,
             // because this only marks faces for removal, does not delete them immediately.
             // As long as we don't traverse the mesh halfedge structure, we're okay.
@@ -14,6 +14,7 @@
 
 // Forward declarations
 struct Triangle;
+class FastWindingNumber;
 
 namespace CGALHelper {
     using Kernel       = CGAL::Exact_predicates_inexact_constructions_kernel;
@@ -78,13 +79,17 @@ namespace CGALHelper {
      * each voxel is independent of each other. This way, each voxel can calculate a boolean with just a piece of
      * the whole mesh, which is much faster than calculating the boolean for the whole mesh for each voxel. It's also parallelizable!
      * 
+     * If a windingNumber is provided, it is used for the inside / outside test in place of the sideTester. That allows the reference mesh
+     * to have holes or self-intersections.
+     * 
      * See the note in the implementation about the return value (void). The union of the openMesh and closedMesh, after modification, form the resulting intersection.
      */
     void openMeshBooleanIntersection(
         SurfaceMesh& openMesh,
         SurfaceMesh& closedMesh,
         const SideTester* const sideTester,
-        bool clipTriangles
+        bool clipTriangles,
+        const FastWindingNumber* const windingNumber = nullptr
     );
 
 } // namespace CGALHelper
\ No newline at end of file
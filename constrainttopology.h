@@ -0,0 +1,35 @@
+#pragma once
+
+#include "directx/directx.h"
+#include "directx/compute/faceconstraintscompute.h"
+#include "directx/compute/longrangeconstraintscompute.h"
+#include <array>
+#include <vector>
+
+/**
+ * Everything about an object's constraints that depends only on which voxels are occupied: the face and long-range constraints in their
+ * initial (unbroken, unpainted) state, and the mapping from each face constraint to the long-range constraints it's part of.
+ *
+ * Copies of the same voxelized asset have the same topology, so PBD objects share one immutable block (see PBD::acquireConstraintTopology)
+ * instead of each building their own. Objects only own the state that changes as they're simulated or painted: their particles, and their
+ * copies of the constraint indices (which hold the broken flags), limits, and long-range counters. The face-to-long-range mapping never changes,
+ * so a single GPU copy of it is bound by every object.
+ */
+struct ConstraintTopology {
+    ConstraintTopology() = default;
+    ConstraintTopology(const ConstraintTopology&) = delete;
+    ConstraintTopology& operator=(const ConstraintTopology&) = delete;
+
+    // Only shared through std::shared_ptr, so (unlike the compute shaders) this is destroyed exactly once, when the last object lets go.
+    ~ConstraintTopology() {
+        for (const ComPtr<ID3D11Buffer>& buffer : faceIdxToLRConstraintBuffers) {
+            if (buffer) DirectX::notifyMayaOfMemoryUsage(buffer);
+        }
+    }
+
+    std::vector<uint32_t> mortonCodes; // Of the occupied voxels this was built for, to match other objects against
+    std::array<FaceConstraints, 3> faceConstraints;
+    LongRangeConstraints longRangeConstraints;
+    std::array<ComPtr<ID3D11Buffer>, 3> faceIdxToLRConstraintBuffers;
+    std::array<ComPtr<ID3D11UnorderedAccessView>, 3> faceIdxToLRConstraintUAVs;
+};
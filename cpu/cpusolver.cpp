@@ -0,0 +1,1443 @@
+#include "cpusolver.h"
+#include "vgscore.h"
+#include "vgssimd.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace VGSCore;
+
+namespace {
+
+// Mirrors getParticleCellHash in particle_collisions_shared.hlsl: the Morton code of the cell, wrapped to 1024 cells per axis, folded into the table.
+// Cells that are adjacent in space are adjacent in the table, so each task's range of cells is a compact region, and the particles gathered
+// for one cell are mostly still in cache for its neighbours.
+uint getParticleCellHash(int gridPosX, int gridPosY, int gridPosZ, uint hashGridSize) {
+    return Utils::toMortonCode(
+        static_cast<uint32_t>(gridPosX) & 1023u,
+        static_cast<uint32_t>(gridPosY) & 1023u,
+        static_cast<uint32_t>(gridPosZ) & 1023u
+    ) % hashGridSize;
+}
+
+// Calls fn(cellHash) for each collision cell the particle overlaps (at most 8, since cells are at least as big as the largest particle).
+template<typename Fn>
+void forEachOverlappedCell(const Particle& particle, float radius, float inverseCellSize, uint hashGridSize, Fn&& fn) {
+    int minX = static_cast<int>(std::floor((particle.x - radius) * inverseCellSize));
+    int minY = static_cast<int>(std::floor((particle.y - radius) * inverseCellSize));
+    int minZ = static_cast<int>(std::floor((particle.z - radius) * inverseCellSize));
+    int maxX = static_cast<int>(std::floor((particle.x + radius) * inverseCellSize));
+    int maxY = static_cast<int>(std::floor((particle.y + radius) * inverseCellSize));
+    int maxZ = static_cast<int>(std::floor((particle.z + radius) * inverseCellSize));
+
+    for (int z = minZ; z <= maxZ; ++z) {
+        for (int y = minY; y <= maxY; ++y) {
+            for (int x = minX; x <= maxX; ++x) {
+                fn(getParticleCellHash(x, y, z, hashGridSize));
+            }
+        }
+    }
+}
+
+// A pair of particles can share up to 8 cells. Its home cell is the lowest corner of the cells both overlap; the pair is only solved there, so that
+// summing each cell's corrections doesn't apply the same contact more than once.
+uint getPairHomeCellHash(const Particle& particleA, float radiusA, const Particle& particleB, float radiusB, float inverseCellSize, uint hashGridSize) {
+    int x = static_cast<int>(std::floor(std::max(particleA.x - radiusA, particleB.x - radiusB) * inverseCellSize));
+    int y = static_cast<int>(std::floor(std::max(particleA.y - radiusA, particleB.y - radiusB) * inverseCellSize));
+    int z = static_cast<int>(std::floor(std::max(particleA.z - radiusA, particleB.z - radiusB) * inverseCellSize));
+    return getParticleCellHash(x, y, z, hashGridSize);
+}
+
+bool doParticlesOverlap(
+    const MFloatVector& positionA,
+    const MFloatVector& positionB,
+    float radiusA,
+    float radiusB,
+    float& distanceSquared,
+    MFloatVector& particleAToB
+) {
+    particleAToB = positionB - positionA;
+    distanceSquared = particleAToB * particleAToB;
+    if (distanceSquared < 1e-6f) return false; // Avoid division by zero or NaN
+
+    return (distanceSquared < (radiusA + radiusB) * (radiusA + radiusB));
+}
+
+// Collider matrices are stored the way Maya lays them out (row vectors, translation in the last row). The shader reads them column-major,
+// so what it calls wMatrix[r][c] is m[c][r] here. Only the upper 3 columns matter for points and directions; the 4th holds collider parameters.
+MFloatVector transformPoint(const float m[4][4], const MFloatVector& p) {
+    return MFloatVector(
+        p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0],
+        p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1],
+        p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2]
+    );
+}
+
+MFloatVector transformDirection(const float m[4][4], const MFloatVector& d) {
+    return MFloatVector(
+        d.x * m[0][0] + d.y * m[1][0] + d.z * m[2][0],
+        d.x * m[0][1] + d.y * m[1][1] + d.z * m[2][1],
+        d.x * m[0][2] + d.y * m[1][2] + d.z * m[2][2]
+    );
+}
+
+MFloatVector clampVector(const MFloatVector& v, const MFloatVector& lo, const MFloatVector& hi) {
+    return MFloatVector(
+        std::clamp(v.x, lo.x, hi.x),
+        std::clamp(v.y, lo.y, hi.y),
+        std::clamp(v.z, lo.z, hi.z)
+    );
+}
+
+MFloatVector solveSphereCollision(const float wMatrix[4][4], MFloatVector& position, float radius) {
+    float sphereRadius = wMatrix[0][3];
+    MFloatVector sphereCenter(wMatrix[3][0], wMatrix[3][1], wMatrix[3][2]);
+
+    MFloatVector toParticle = position - sphereCenter;
+    float distSq = toParticle * toParticle;
+    float combinedRadius = sphereRadius + radius;
+    if (distSq >= combinedRadius * combinedRadius || distSq == 0.0f) return MFloatVector::zero;
+
+    MFloatVector norm = toParticle / std::sqrt(distSq);
+    position = sphereCenter + norm * combinedRadius;
+    return norm;
+}
+
+MFloatVector solveBoxCollision(const float wMatrix[4][4], const float invWMatrix[4][4], MFloatVector& position, float radius) {
+    MFloatVector localPos = transformPoint(invWMatrix, position);
+    MFloatVector halfExtents(wMatrix[0][3] * 0.5f, wMatrix[1][3] * 0.5f, wMatrix[2][3] * 0.5f);
+
+    MFloatVector clamped = clampVector(localPos, -halfExtents, halfExtents);
+    MFloatVector delta = localPos - clamped;
+    float distSq = delta * delta;
+    if (distSq >= radius * radius) return MFloatVector::zero;
+
+    MFloatVector adjustedLocalPos = localPos;
+    MFloatVector localNormal;
+    if (distSq > 0.0f) { // particle center outside box
+        localNormal = delta / std::sqrt(distSq);
+        adjustedLocalPos = clamped + localNormal * radius;
+    } else { // particle center inside box: push out to nearest face
+        MFloatVector distsToFace(halfExtents.x - std::abs(localPos.x), halfExtents.y - std::abs(localPos.y), halfExtents.z - std::abs(localPos.z));
+        int axis = 0;
+        if (distsToFace.y < distsToFace.x) axis = 1;
+        if (distsToFace.z < distsToFace[axis]) axis = 2;
+
+        float axisSign = (localPos[axis] < 0.0f) ? -1.0f : 1.0f;
+        adjustedLocalPos[axis] = (halfExtents[axis] + radius) * axisSign;
+        localNormal = MFloatVector::zero;
+        localNormal[axis] = axisSign;
+    }
+
+    position = transformPoint(wMatrix, adjustedLocalPos);
+    return transformDirection(wMatrix, localNormal).normal();
+}
+
+MFloatVector solvePlaneCollision(const float wMatrix[4][4], MFloatVector& position, float radius) {
+    float width = wMatrix[0][3];
+    float height = wMatrix[1][3];
+    float isInfinite = wMatrix[2][3];
+
+    MFloatVector planePos = transformPoint(wMatrix, MFloatVector::zero);
+    MFloatVector planeNormal = transformDirection(wMatrix, MFloatVector::yAxis).normal();
+    float dist = (position - planePos) * planeNormal - radius;
+    if (dist >= 0.0f) return MFloatVector::zero;
+
+    if (isInfinite == 0.0f) {
+        MFloatVector planeRight = transformDirection(wMatrix, MFloatVector::xAxis).normal();
+        MFloatVector planeForward = transformDirection(wMatrix, MFloatVector::zAxis).normal();
+
+        MFloatVector toPoint = position - planePos;
+        if (std::abs(toPoint * planeRight) > width * 0.5f || std::abs(toPoint * planeForward) > height * 0.5f) return MFloatVector::zero;
+    }
+
+    position -= dist * planeNormal;
+    return planeNormal;
+}
+
+MFloatVector solveCylinderCollision(const float wMatrix[4][4], const float invWMatrix[4][4], MFloatVector& position, float radius) {
+    float cylinderRadius = wMatrix[0][3];
+    float halfHeight = wMatrix[1][3] * 0.5f;
+
+    MFloatVector localPos = transformPoint(invWMatrix, position);
+    float clampedY = std::clamp(localPos.y, -halfHeight, halfHeight);
+
+    float radialX = localPos.x;
+    float radialZ = localPos.z;
+    float radialDistSq = radialX * radialX + radialZ * radialZ;
+    if (radialDistSq > cylinderRadius * cylinderRadius) {
+        float scale = cylinderRadius / std::sqrt(radialDistSq);
+        radialX *= scale;
+        radialZ *= scale;
+    }
+
+    MFloatVector closest(radialX, clampedY, radialZ);
+    MFloatVector delta = localPos - closest;
+    float distSq = delta * delta;
+    if (distSq >= radius * radius) return MFloatVector::zero;
+
+    MFloatVector adjustedLocalPos;
+    MFloatVector localNormal;
+    if (distSq > 0.0f) {
+        localNormal = delta / std::sqrt(distSq);
+        adjustedLocalPos = closest + localNormal * radius;
+    } else {
+        adjustedLocalPos = closest + MFloatVector(radius, 0.0f, 0.0f);
+        localNormal = MFloatVector::xAxis;
+    }
+
+    position = transformPoint(wMatrix, adjustedLocalPos);
+    return transformDirection(wMatrix, localNormal).normal();
+}
+
+MFloatVector solveCapsuleCollision(const float wMatrix[4][4], const float invWMatrix[4][4], MFloatVector& position, float radius) {
+    float capsuleRadius = wMatrix[0][3];
+    float halfHeight = wMatrix[1][3] * 0.5f;
+
+    MFloatVector localPos = transformPoint(invWMatrix, position);
+
+    // Closest point on the capsule's spine (aligned with local Y)
+    float t = (localPos.y + halfHeight) / (2.0f * halfHeight);
+    t = std::clamp(t, 0.0f, 1.0f);
+    MFloatVector closest(0.0f, -halfHeight + 2.0f * halfHeight * t, 0.0f);
+
+    MFloatVector delta = localPos - closest;
+    float distSq = delta * delta;
+    float combined = capsuleRadius + radius;
+    if (distSq >= combined * combined) return MFloatVector::zero;
+
+    MFloatVector adjustedLocalPos;
+    MFloatVector localNormal;
+    if (distSq > 0.0f) {
+        localNormal = delta / std::sqrt(distSq);
+        adjustedLocalPos = closest + localNormal * combined;
+    } else {
+        adjustedLocalPos = closest + MFloatVector(combined, 0.0f, 0.0f);
+        localNormal = MFloatVector::xAxis;
+    }
+
+    position = transformPoint(wMatrix, adjustedLocalPos);
+    return transformDirection(wMatrix, localNormal).normal();
+}
+
+/**
+ * Runs doVGSIterations on each particle group in [begin, end). gather(idx, group, inverseMasses) fills in a group's 8 particles and their
+ * inverse masses (from CPUSimulationBuffers::inverseMasses), or returns false to skip it; scatter(idx, group, inverseMasses) writes the solved group back.
+ * With AVX2 (if allowed), groups are solved 8 at a time (see VGSSimd), otherwise one at a time.
+ * All groups in a batch are gathered before any are scattered, which relies on the groups of a pass not sharing particles.
+ */
+template<typename Gather, typename Scatter>
+void solveVGSGroups(int begin, int end, const VGSConstants& vgsConstants, bool bailOnInverted, float convergedCorrectionSq, bool allowSimd, Gather&& gather, Scatter&& scatter) {
+    if (!allowSimd || !VGSSimd::isSupported()) {
+        Particle group[8];
+        float inverseMasses[8];
+        for (int idx = begin; idx < end; ++idx) {
+            if (!gather(idx, group, inverseMasses)) continue;
+            doVGSIterations(group, vgsConstants, bailOnInverted, convergedCorrectionSq);
+            scatter(idx, group, inverseMasses);
+        }
+        return;
+    }
+
+    VGSSimd::VoxelBatch batch;
+    Particle groups[VGSSimd::laneCount][8];
+    float groupInverseMasses[VGSSimd::laneCount][8];
+    int groupIndices[VGSSimd::laneCount];
+    int numGroups = 0;
+
+    auto solveBatch = [&]() {
+        VGSSimd::doVGSIterations(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        for (int lane = 0; lane < numGroups; ++lane) {
+            batch.store(lane, groups[lane]);
+            scatter(groupIndices[lane], groups[lane], groupInverseMasses[lane]);
+        }
+        batch.clear();
+        numGroups = 0;
+    };
+
+    for (int idx = begin; idx < end; ++idx) {
+        if (!gather(idx, groups[numGroups], groupInverseMasses[numGroups])) continue;
+        batch.load(numGroups, groups[numGroups], groupInverseMasses[numGroups], vgsConstants.compliance);
+        groupIndices[numGroups++] = idx;
+        if (numGroups == VGSSimd::laneCount) solveBatch();
+    }
+    if (numGroups > 0) solveBatch();
+}
+
+/**
+ * Where a constraint pass puts the particles it solved: straight back into the particles (Gauss-Seidel), or, in Jacobi mode, as corrections in
+ * each particle's slot for the pass, leaving the particles as they were for the rest of the sweep (see CPUSolver::applyJacobiCorrections).
+ */
+struct SolvedParticleWriter {
+    Particle* particles;
+    MFloatVector* jacobiCorrections; // Null outside of Jacobi mode
+    uint8_t* jacobiSlotMasks;
+    int slot;
+
+    SolvedParticleWriter(Particle* particles, CPUSimulationBuffers& buffers, uint particleOffset, bool jacobi, int slot)
+        : particles(particles),
+          jacobiCorrections(jacobi ? buffers.jacobiCorrections.data() + static_cast<size_t>(particleOffset) * CPUSimulationBuffers::jacobiSlotsPerParticle : nullptr),
+          jacobiSlotMasks(jacobi ? buffers.jacobiSlotMasks.data() + particleOffset : nullptr),
+          slot(slot)
+    {}
+
+    void write(uint particleIdx, const Particle& solved) const {
+        if (!jacobiCorrections) {
+            particles[particleIdx] = solved;
+            return;
+        }
+
+        jacobiCorrections[static_cast<size_t>(particleIdx) * CPUSimulationBuffers::jacobiSlotsPerParticle + slot] = position(solved) - position(particles[particleIdx]);
+        jacobiSlotMasks[particleIdx] |= static_cast<uint8_t>(1u << slot);
+    }
+};
+
+} // namespace
+
+void CPUSolver::parallelFor(int count, int grainSize, const std::function<void(int, int)>& body) {
+    if (count <= 0) return;
+    if (count <= grainSize) {
+        body(0, count);
+        return;
+    }
+
+    ParallelForTaskData taskData { &body, count, grainSize };
+    MThreadPool::newParallelRegion(CPUSolver::createParallelForTasks, (void*)&taskData);
+    MThreadPool::release(); // reduce reference count incurred by opening a new parallel region
+}
+
+void CPUSolver::createParallelForTasks(void* data, MThreadRootTask* rootTask) {
+    const ParallelForTaskData* taskData = static_cast<ParallelForTaskData*>(data);
+    int numTasks = Utils::divideRoundUp(taskData->count, taskData->grainSize);
+
+    // Many more tasks than threads, so the pool can balance uneven chunks (e.g. collision cells) across its workers.
+    std::vector<ParallelForThreadData> threadData(numTasks);
+    for (int i = 0; i < numTasks; ++i) {
+        threadData[i].taskData = taskData;
+        threadData[i].begin = i * taskData->grainSize;
+        threadData[i].end = std::min(taskData->count, (i + 1) * taskData->grainSize);
+
+        MThreadPool::createTask(CPUSolver::runParallelForRange, (void*)&threadData[i], rootTask);
+    }
+    MThreadPool::executeAndJoin(rootTask);
+}
+
+MThreadRetVal CPUSolver::runParallelForRange(void* data) {
+    const ParallelForThreadData* threadData = static_cast<ParallelForThreadData*>(data);
+    (*threadData->taskData->body)(threadData->begin, threadData->end);
+    return 0;
+}
+
+uint CPUSolver::simulateSubstep(CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    if (jacobiConstraints && buffers.jacobiSlotMasks.size() != buffers.particles.size()) {
+        buffers.jacobiCorrections.assign(buffers.particles.size() * CPUSimulationBuffers::jacobiSlotsPerParticle, MFloatVector::zero);
+        buffers.jacobiSlotMasks.assign(buffers.particles.size(), 0);
+    }
+
+    preVGS(object, buffers);
+    solveRigidClusters(object, buffers);
+    solveVoxels(object, buffers);
+    solveLongRangeConstraints(object, buffers);
+
+    uint numBroken = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        numBroken += solveFaceConstraints(object, buffers, axis);
+    }
+    if (jacobiConstraints) {
+        applyJacobiCorrections(object, buffers);
+    }
+
+    if (numBroken > 0 && object.islands.isValid()) {
+        object.islands.splitAt(object.brokenConnections);
+        object.islandSleepStates.resize(object.islands.numIslands());
+        object.rigidClusters.resize(object.islands.numIslands());
+    }
+    object.brokenConnections.clear();
+
+    if (measureResiduals) {
+        accumulateResiduals(object, buffers);
+    }
+    return numBroken;
+}
+
+void CPUSolver::accumulateResiduals(const CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    const Particle* const particles = buffers.particles.data() + object.particleOffset;
+    const float restVolume = object.vgsConstants.voxelRestVolume;
+    const float particleDiameter = 2.0f * object.vgsConstants.particleRadius;
+    const int numVoxels = static_cast<int>(object.numParticles / 8);
+
+    // Per-task partial results, merged in task order so the totals don't depend on thread timing.
+    std::vector<ResidualStats> volumeErrorsPerTask(Utils::divideRoundUp(numVoxels, particlesPerTask / 8));
+    parallelFor(numVoxels, particlesPerTask / 8, [&](int begin, int end) {
+        ResidualStats& volumeErrors = volumeErrorsPerTask[begin / (particlesPerTask / 8)];
+        for (int voxel = begin; voxel < end; ++voxel) {
+            MFloatVector p[8];
+            for (int i = 0; i < 8; ++i) {
+                p[i] = position(particles[(voxel << 3) + i]);
+            }
+
+            // Same basis vectors as the VGS kernel, at full edge length
+            MFloatVector v0 = 0.25f * ((p[1] - p[0]) + (p[3] - p[2]) + (p[5] - p[4]) + (p[7] - p[6]));
+            MFloatVector v1 = 0.25f * ((p[2] - p[0]) + (p[3] - p[1]) + (p[6] - p[4]) + (p[7] - p[5]));
+            MFloatVector v2 = 0.25f * ((p[4] - p[0]) + (p[5] - p[1]) + (p[6] - p[2]) + (p[7] - p[3]));
+            volumeErrors.add(std::abs(((v0 ^ v1) * v2) - restVolume) / restVolume);
+        }
+    });
+
+    std::vector<ResidualStats> edgeStrainsPerTask;
+    for (int axis = 0; axis < 3; ++axis) {
+        const std::vector<int>& voxelIndices = object.faceConstraints[axis].voxelIndices;
+        const int numConstraints = static_cast<int>(object.faceConstraints[axis].size());
+        const size_t firstTask = edgeStrainsPerTask.size();
+        edgeStrainsPerTask.resize(firstTask + Utils::divideRoundUp(numConstraints, constraintsPerTask));
+
+        parallelFor(numConstraints, constraintsPerTask, [&](int begin, int end) {
+            ResidualStats& edgeStrains = edgeStrainsPerTask[firstTask + begin / constraintsPerTask];
+            for (int constraintIdx = begin; constraintIdx < end; ++constraintIdx) {
+                int voxelAIdx = voxelIndices[constraintIdx * 2];
+                int voxelBIdx = voxelIndices[constraintIdx * 2 + 1];
+                if (voxelAIdx == -1 || voxelBIdx == -1) continue;
+
+                for (int i = 0; i < 4; ++i) {
+                    float edgeLength = (position(particles[(voxelAIdx << 3) + faceAParticles[axis][i]]) - position(particles[(voxelBIdx << 3) + faceBParticles[axis][i]])).length();
+                    edgeStrains.add(std::abs(edgeLength - particleDiameter) / particleDiameter);
+                }
+            }
+        });
+    }
+
+    for (const ResidualStats& volumeErrors : volumeErrorsPerTask) {
+        buffers.residuals.volumeError.merge(volumeErrors);
+    }
+    for (const ResidualStats& edgeStrains : edgeStrainsPerTask) {
+        buffers.residuals.edgeStrain.merge(edgeStrains);
+    }
+}
+
+int CPUSolver::chooseSubsteps(const CPUSimulationBuffers& buffers, int nominalSubsteps, int minSubsteps, int maxSubsteps) {
+    // Fastest particle, in particle radii per frame
+    const Particle* const particles = buffers.particles.data();
+    const Particle* const oldParticles = buffers.oldParticles.data();
+    const float* const radii = buffers.radii.data();
+    const int numParticles = static_cast<int>(buffers.particles.size());
+    std::vector<float> maxDisplacementRatiosPerTask(Utils::divideRoundUp(numParticles, particlesPerTask), 0.0f);
+    parallelFor(numParticles, particlesPerTask, [&](int begin, int end) {
+        float& maxDisplacementRatio = maxDisplacementRatiosPerTask[begin / particlesPerTask];
+        for (int i = begin; i < end; ++i) {
+            float displacement = (position(particles[i]) - position(oldParticles[i])).length();
+            maxDisplacementRatio = std::max(maxDisplacementRatio, displacement / radii[i]);
+        }
+    });
+    float maxDisplacementRatio = 0.0f;
+    for (float ratio : maxDisplacementRatiosPerTask) {
+        maxDisplacementRatio = std::max(maxDisplacementRatio, ratio);
+    }
+
+    constexpr float maxDisplacementPerSubstep = 0.5f; // In particle radii
+    int substepsForSpeed = static_cast<int>(std::ceil(maxDisplacementRatio * nominalSubsteps / maxDisplacementPerSubstep));
+
+    // Below half the breaking strain, speed alone decides. Beyond that, ramp up to the maximum as constraints approach breaking,
+    // so that impacts are resolved over more (smaller) substeps instead of breaking everything they touch.
+    float strainPressure = std::clamp((buffers.peakStrainRatio - 0.5f) / 0.5f, 0.0f, 1.0f);
+    int substepsForStrain = minSubsteps + static_cast<int>(std::ceil(strainPressure * (maxSubsteps - minSubsteps)));
+
+    return std::clamp(std::max(substepsForSpeed, substepsForStrain), minSubsteps, std::max(minSubsteps, maxSubsteps));
+}
+
+void CPUSolver::rescaleVelocities(CPUSimulationBuffers& buffers, float factor) {
+    if (factor == 1.0f) return;
+
+    Particle* const particles = buffers.particles.data();
+    Particle* const oldParticles = buffers.oldParticles.data();
+    parallelFor(static_cast<int>(buffers.particles.size()), particlesPerTask, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            MFloatVector displacement = position(particles[i]) - position(oldParticles[i]);
+            setPosition(oldParticles[i], position(particles[i]) - displacement * factor);
+        }
+    });
+}
+
+void CPUSolver::unpackParticleAttributes(CPUSimulationBuffers& buffers) {
+    const Particle* const particles = buffers.particles.data();
+    const int numParticles = static_cast<int>(buffers.particles.size());
+    buffers.inverseMasses.resize(numParticles);
+    buffers.radii.resize(numParticles);
+
+    parallelFor(numParticles, particlesPerTask, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            buffers.inverseMasses[i] = particleInverseMass(particles[i]);
+            buffers.radii[i] = particleRadius(particles[i]);
+        }
+    });
+}
+
+void CPUSolver::updateIslands(CPUSimulationObject& object) {
+    if (object.islands.isValid()) return;
+
+    object.islands.rebuild(object.faceConstraints, object.numParticles / 8);
+    object.islandSleepStates.assign(object.islands.numIslands(), CPUSimulationObject::IslandSleepState());
+    object.rigidClusters.assign(object.islands.numIslands(), CPUSimulationObject::RigidCluster());
+    object.isRigid.assign(object.numParticles / 8, 0);
+}
+
+void CPUSolver::updateSleepingIslands(CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    const uint numVoxels = object.numParticles / 8;
+    uint8_t* const isAsleep = buffers.isAsleep.data() + object.particleOffset / 8;
+    if (sleepThreshold <= 0.0f) {
+        std::fill(isAsleep, isAsleep + numVoxels, uint8_t(0));
+        std::fill(object.islandSleepStates.begin(), object.islandSleepStates.end(), CPUSimulationObject::IslandSleepState());
+        object.hasSleepingVoxels = false;
+        return;
+    }
+
+    // A voxel is moving if any of its particles moved further than the threshold over the last substep - or, for sleeping voxels,
+    // since they fell asleep (their previous positions are frozen then), so that repeated small nudges eventually wake them too.
+    Particle* const particles = buffers.particles.data() + object.particleOffset;
+    const float* const inverseMasses = buffers.inverseMasses.data() + object.particleOffset;
+    Particle* const oldParticles = buffers.oldParticles.data() + object.particleOffset;
+    const uint* const isDragging = buffers.isDragging.data() + object.particleOffset / 8;
+    const float restDisplacement = sleepThreshold * object.preVGSConstants.timeStep * buffers.timeStepScale;
+    const float restDisplacementSq = restDisplacement * restDisplacement;
+
+    std::vector<uint8_t> isVoxelMoving(numVoxels, 0);
+    parallelFor(static_cast<int>(numVoxels), particlesPerTask / 8, [&](int begin, int end) {
+        for (int voxel = begin; voxel < end; ++voxel) {
+            if (isDragging[voxel]) {
+                isVoxelMoving[voxel] = 1;
+                continue;
+            }
+
+            for (int i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+                if (inverseMasses[i] == 0.0f) continue;
+                MFloatVector displacement = position(particles[i]) - position(oldParticles[i]);
+                if (displacement * displacement > restDisplacementSq) {
+                    isVoxelMoving[voxel] = 1;
+                    break;
+                }
+            }
+        }
+    });
+
+    const uint numIslands = object.islands.numIslands();
+    std::vector<uint8_t> isIslandMoving(numIslands, 0);
+    for (uint voxel = 0; voxel < numVoxels; ++voxel) {
+        isIslandMoving[object.islands.islandOf(voxel)] |= isVoxelMoving[voxel];
+    }
+
+    // Islands that just fell asleep or woke up start from rest (a woken island's frozen displacement isn't a real velocity).
+    std::vector<uint8_t> isIslandResting(numIslands, 0);
+    for (uint island = 0; island < numIslands; ++island) {
+        CPUSimulationObject::IslandSleepState& state = object.islandSleepStates[island];
+        if (isIslandMoving[island]) {
+            isIslandResting[island] = state.asleep;
+            state = CPUSimulationObject::IslandSleepState();
+        } else if (!state.asleep && ++state.framesAtRest >= framesBeforeSleep) {
+            isIslandResting[island] = 1;
+            state.asleep = true;
+        }
+    }
+
+    for (uint voxel = 0; voxel < numVoxels; ++voxel) {
+        uint island = object.islands.islandOf(voxel);
+        isAsleep[voxel] = object.islandSleepStates[island].asleep;
+        if (!isIslandResting[island]) continue;
+
+        for (int i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+            oldParticles[i] = particles[i];
+        }
+    }
+
+    updateAwakeLists(object, buffers);
+}
+
+void CPUSolver::updateAwakeVoxels(CPUSimulationBuffers& buffers) {
+    buffers.hasSleepingVoxels = std::any_of(buffers.isAsleep.begin(), buffers.isAsleep.end(), [](uint8_t asleep) { return asleep != 0; });
+    if (!buffers.hasSleepingVoxels) return;
+
+    buffers.awakeVoxels.clear();
+    for (uint voxel = 0; voxel < static_cast<uint>(buffers.isAsleep.size()); ++voxel) {
+        if (!buffers.isAsleep[voxel]) buffers.awakeVoxels.push_back(voxel);
+    }
+}
+
+void CPUSolver::updateAwakeLists(CPUSimulationObject& object, const CPUSimulationBuffers& buffers) {
+    const uint numVoxels = object.numParticles / 8;
+    const uint8_t* const isAsleep = buffers.isAsleep.data() + object.particleOffset / 8;
+    object.hasSleepingVoxels = std::any_of(isAsleep, isAsleep + numVoxels, [](uint8_t asleep) { return asleep != 0; });
+    if (!object.hasSleepingVoxels) return;
+
+    object.awakeVoxels.clear();
+    for (uint voxel = 0; voxel < numVoxels; ++voxel) {
+        if (!isAsleep[voxel]) object.awakeVoxels.push_back(voxel);
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+        updateAwakeFaceConstraints(object, buffers, axis);
+    }
+
+    // A long-range constraint is awake if any of its particles are (same as the skip test in solveLongRangeConstraintLevel).
+    const std::array<uint, LONG_RANGE_LEVELS + 1>& levelOffsets = object.constraintTopology->longRangeConstraints.levelOffsets;
+    const std::vector<uint>& longRangeParticleIndices = object.longRangeConstraints.particleIndices;
+    for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+        std::vector<uint>& awakeConstraints = object.awakeLongRangeConstraints[level];
+        awakeConstraints.clear();
+        for (uint constraintIdx = levelOffsets[level]; constraintIdx < levelOffsets[level + 1]; ++constraintIdx) {
+            for (int i = 0; i < 8; ++i) {
+                uint particleIdx = longRangeParticleIndices[(static_cast<size_t>(constraintIdx) << 3) + i] >> 4;
+                if (isAsleep[particleIdx >> 3]) continue;
+                awakeConstraints.push_back(constraintIdx - levelOffsets[level]);
+                break;
+            }
+        }
+    }
+}
+
+// Called again whenever the flattened constraints are compacted, since that moves them.
+void CPUSolver::updateAwakeFaceConstraints(CPUSimulationObject& object, const CPUSimulationBuffers& buffers, int axis) {
+    const uint8_t* const isAsleep = buffers.isAsleep.data() + object.particleOffset / 8;
+    std::vector<uint>& awakeConstraints = object.awakeFaceConstraints[axis];
+    awakeConstraints.clear();
+
+    // Broken constraints are left out; an unbroken constraint's voxels are in the same island, so A's state is B's too.
+    if (flatFaceConstraints && object.flatFaceConstraintsValid) {
+        const FlatFaceConstraints& flatConstraints = object.flatFaceConstraints[axis];
+        const uint faceB0 = faceBParticles[axis][0];
+        for (uint flatIdx = 0; flatIdx < flatConstraints.size(); ++flatIdx) {
+            if (flatConstraints.isBroken[flatIdx]) continue;
+            if (isAsleep[flatConstraints.particleIndices[(static_cast<size_t>(flatIdx) << 3) + faceB0] >> 3]) continue;
+            awakeConstraints.push_back(flatIdx);
+        }
+        return;
+    }
+
+    const std::vector<int>& voxelIndices = object.faceConstraints[axis].voxelIndices;
+    for (uint constraintIdx = 0; constraintIdx < object.faceConstraints[axis].size(); ++constraintIdx) {
+        int voxelAIdx = voxelIndices[constraintIdx * 2];
+        if (voxelAIdx == -1 || voxelIndices[constraintIdx * 2 + 1] == -1 || isAsleep[voxelAIdx]) continue;
+        awakeConstraints.push_back(constraintIdx);
+    }
+}
+
+void CPUSolver::updateRigidClusters(CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    const uint numVoxels = object.numParticles / 8;
+    const uint numIslands = object.islands.numIslands();
+    if (rigidStrainThreshold <= 0.0f) {
+        std::fill(object.rigidClusters.begin(), object.rigidClusters.end(), CPUSimulationObject::RigidCluster());
+        std::fill(object.isRigid.begin(), object.isRigid.end(), uint8_t(0));
+        return;
+    }
+
+    const Particle* const particles = buffers.particles.data() + object.particleOffset;
+    const float* const inverseMasses = buffers.inverseMasses.data() + object.particleOffset;
+    const uint* const isDragging = buffers.isDragging.data() + object.particleOffset / 8;
+    const float particleDiameter = 2.0f * object.vgsConstants.particleRadius;
+    constexpr float unrigidStrain = std::numeric_limits<float>::max();
+
+    // Per voxel, the largest strain over the face constraints it's the A side of (one per axis, at most), measured the same way as the
+    // face constraint pass does. Pinned and dragged voxels can't be part of a rigid body at all. Already rigid voxels are checked every substep instead.
+    std::vector<float> voxelStrains(numVoxels, 0.0f);
+    parallelFor(static_cast<int>(numVoxels), particlesPerTask / 8, [&](int begin, int end) {
+        for (int voxel = begin; voxel < end; ++voxel) {
+            if (isDragging[voxel]) {
+                voxelStrains[voxel] = unrigidStrain;
+                continue;
+            }
+
+            for (int i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+                if (inverseMasses[i] != 0.0f) continue;
+                voxelStrains[voxel] = unrigidStrain;
+                break;
+            }
+        }
+    });
+
+    for (int axis = 0; axis < 3; ++axis) {
+        const std::vector<int>& voxelIndices = object.faceConstraints[axis].voxelIndices;
+        parallelFor(static_cast<int>(object.faceConstraints[axis].size()), constraintsPerTask, [&](int begin, int end) {
+            for (int constraintIdx = begin; constraintIdx < end; ++constraintIdx) {
+                int voxelAIdx = voxelIndices[constraintIdx * 2];
+                int voxelBIdx = voxelIndices[constraintIdx * 2 + 1];
+                if (voxelAIdx == -1 || voxelBIdx == -1 || object.isRigid[voxelAIdx]) continue;
+
+                float maxStrain = voxelStrains[voxelAIdx];
+                for (int i = 0; i < 4; ++i) {
+                    float edgeLength = (position(particles[(voxelAIdx << 3) + faceAParticles[axis][i]]) - position(particles[(voxelBIdx << 3) + faceBParticles[axis][i]])).length();
+                    maxStrain = std::max(maxStrain, std::abs(edgeLength - particleDiameter) / particleDiameter);
+                }
+                voxelStrains[voxelAIdx] = maxStrain;
+            }
+        });
+    }
+
+    std::vector<float> islandStrains(numIslands, 0.0f);
+    for (uint voxel = 0; voxel < numVoxels; ++voxel) {
+        float& islandStrain = islandStrains[object.islands.islandOf(voxel)];
+        islandStrain = std::max(islandStrain, voxelStrains[voxel]);
+    }
+
+    // Half the threshold to become rigid, so that pieces right at the threshold don't flip back and forth every frame.
+    std::vector<uint8_t> isBecomingRigid(numIslands, 0);
+    bool anyBecomingRigid = false;
+    for (uint island = 0; island < numIslands; ++island) {
+        CPUSimulationObject::RigidCluster& cluster = object.rigidClusters[island];
+        if (cluster.active) continue;
+
+        if (islandStrains[island] >= 0.5f * rigidStrainThreshold) {
+            cluster.framesUnstressed = 0;
+        } else if (++cluster.framesUnstressed >= framesBeforeRigid) {
+            isBecomingRigid[island] = 1;
+            anyBecomingRigid = true;
+        }
+    }
+    if (!anyBecomingRigid) return;
+
+    for (uint voxel = 0; voxel < numVoxels; ++voxel) {
+        uint island = object.islands.islandOf(voxel);
+        if (!isBecomingRigid[island]) continue;
+
+        object.rigidClusters[island].voxels.push_back(voxel);
+        object.isRigid[voxel] = 1;
+    }
+
+    // The rest shape is the piece as it is now (unstressed, by construction).
+    parallelFor(static_cast<int>(numIslands), 64, [&](int begin, int end) {
+        for (int island = begin; island < end; ++island) {
+            if (!isBecomingRigid[island]) continue;
+            CPUSimulationObject::RigidCluster& cluster = object.rigidClusters[island];
+
+            MFloatVector centerOfMass = MFloatVector::zero;
+            float totalMass = 0.0f;
+            for (uint voxel : cluster.voxels) {
+                for (uint i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+                    float mass = 1.0f / inverseMasses[i];
+                    centerOfMass += mass * position(particles[i]);
+                    totalMass += mass;
+                }
+            }
+            centerOfMass /= totalMass;
+
+            cluster.restOffsets.resize(cluster.voxels.size() * 8);
+            for (size_t v = 0; v < cluster.voxels.size(); ++v) {
+                for (uint i = 0; i < 8; ++i) {
+                    cluster.restOffsets[v * 8 + i] = position(particles[(cluster.voxels[v] << 3) + i]) - centerOfMass;
+                }
+            }
+            cluster.rotation = ShapeMatching::Quaternion();
+            cluster.active = true;
+        }
+    });
+}
+
+void CPUSolver::solveRigidClusters(CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    if (rigidStrainThreshold <= 0.0f) return;
+
+    Particle* const particles = buffers.particles.data() + object.particleOffset;
+    const float* const inverseMasses = buffers.inverseMasses.data() + object.particleOffset;
+    const uint* const isDragging = buffers.isDragging.data() + object.particleOffset / 8;
+    const uint8_t* const isAsleep = buffers.isAsleep.data() + object.particleOffset / 8;
+    const float maxDeviation = rigidStrainThreshold * 2.0f * object.vgsConstants.particleRadius;
+
+    // Each cluster owns its voxels, so clusters are solved concurrently.
+    parallelFor(static_cast<int>(object.rigidClusters.size()), 64, [&](int begin, int end) {
+        for (int island = begin; island < end; ++island) {
+            CPUSimulationObject::RigidCluster& cluster = object.rigidClusters[island];
+            if (!cluster.active || isAsleep[cluster.voxels[0]]) continue;
+
+            MFloatVector centerOfMass = MFloatVector::zero;
+            float totalMass = 0.0f;
+            for (uint voxel : cluster.voxels) {
+                for (uint i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+                    float mass = 1.0f / inverseMasses[i];
+                    centerOfMass += mass * position(particles[i]);
+                    totalMass += mass;
+                }
+            }
+            centerOfMass /= totalMass;
+
+            // Columns of the (mass-weighted) covariance between current and rest offsets; its rotation part is the best-fit rotation.
+            MFloatVector covariance[3] = { MFloatVector::zero, MFloatVector::zero, MFloatVector::zero };
+            for (size_t v = 0; v < cluster.voxels.size(); ++v) {
+                for (uint i = 0; i < 8; ++i) {
+                    const uint particleIdx = (cluster.voxels[v] << 3) + i;
+                    MFloatVector offset = (1.0f / inverseMasses[particleIdx]) * (position(particles[particleIdx]) - centerOfMass);
+                    const MFloatVector& restOffset = cluster.restOffsets[v * 8 + i];
+                    covariance[0] += offset * restOffset.x;
+                    covariance[1] += offset * restOffset.y;
+                    covariance[2] += offset * restOffset.z;
+                }
+            }
+            ShapeMatching::extractRotation(covariance, cluster.rotation);
+
+            // If anything pushed the piece too far out of shape (or it's being dragged), hand it back to the per-voxel passes, starting this substep.
+            bool outOfShape = false;
+            for (size_t v = 0; v < cluster.voxels.size() && !outOfShape; ++v) {
+                outOfShape = isDragging[cluster.voxels[v]];
+                for (uint i = 0; i < 8 && !outOfShape; ++i) {
+                    MFloatVector goal = centerOfMass + cluster.rotation.rotate(cluster.restOffsets[v * 8 + i]);
+                    outOfShape = (position(particles[(cluster.voxels[v] << 3) + i]) - goal).length() > maxDeviation;
+                }
+            }
+
+            if (outOfShape) {
+                for (uint voxel : cluster.voxels) {
+                    object.isRigid[voxel] = 0;
+                }
+                cluster = CPUSimulationObject::RigidCluster();
+                continue;
+            }
+
+            for (size_t v = 0; v < cluster.voxels.size(); ++v) {
+                for (uint i = 0; i < 8; ++i) {
+                    setPosition(particles[(cluster.voxels[v] << 3) + i], centerOfMass + cluster.rotation.rotate(cluster.restOffsets[v * 8 + i]));
+                }
+            }
+        }
+    });
+}
+
+void CPUSolver::preVGS(CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    Particle* const particles = buffers.particles.data() + object.particleOffset;
+    Particle* const oldParticles = buffers.oldParticles.data() + object.particleOffset;
+    const float* const inverseMasses = buffers.inverseMasses.data() + object.particleOffset;
+    const uint* const isDragging = buffers.isDragging.data() + object.particleOffset / 8;
+    const PreVGSConstants& constants = object.preVGSConstants;
+    const float timeStep = constants.timeStep * buffers.timeStepScale;
+    const float gravityDelta = constants.gravityStrength * timeStep * timeStep;
+    const PassItems voxels = passItems(object, object.awakeVoxels, object.numParticles / 8);
+
+    parallelFor(voxels.count, particlesPerTask / 8, [&](int begin, int end) {
+        for (int v = begin; v < end; ++v) {
+            const int voxel = voxels[v];
+            for (int i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+                if (inverseMasses[i] == 0.0f) continue;
+                Particle particle = particles[i];
+
+                Particle oldParticle = oldParticles[i];
+                oldParticles[i] = particle;
+
+                if (isDragging[voxel]) continue;
+
+                MFloatVector delta = position(particle) - position(oldParticle);
+                delta.y += gravityDelta;
+                setPosition(particle, position(particle) + delta);
+                particles[i] = particle;
+            }
+        }
+    });
+}
+
+void CPUSolver::solveVoxels(CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    Particle* const particles = buffers.particles.data() + object.particleOffset;
+    const float* const inverseMasses = buffers.inverseMasses.data() + object.particleOffset;
+    const uint8_t* const isRigid = object.isRigid.data();
+    const VGSConstants vgsConstants = scaledForTimeStep(object.vgsConstants, buffers);
+    const PassItems voxels = passItems(object, object.awakeVoxels, object.numParticles / 8);
+
+    parallelFor(voxels.count, particlesPerTask / 8, [&](int begin, int end) {
+        auto gather = [&](int v, Particle voxelParticles[8], float voxelInverseMasses[8]) {
+            const int voxel = voxels[v];
+            if (isRigid[voxel]) return false;
+
+            const Particle* const voxelStart = particles + (voxel << 3);
+            std::copy(voxelStart, voxelStart + 8, voxelParticles);
+            std::copy(inverseMasses + (voxel << 3), inverseMasses + (voxel << 3) + 8, voxelInverseMasses);
+            return true;
+        };
+
+        auto scatter = [&](int v, const Particle voxelParticles[8], const float voxelInverseMasses[8]) {
+            Particle* const voxelStart = particles + (voxels[v] << 3);
+            for (int j = 0; j < 8; ++j) {
+                if (voxelInverseMasses[j] == 0.0f) continue;
+                voxelStart[j] = voxelParticles[j];
+            }
+        };
+
+        solveVGSGroups(begin, end, vgsConstants, false, convergedCorrectionSq(vgsConstants), !deterministic, gather, scatter);
+    });
+}
+
+void CPUSolver::solveLongRangeConstraints(CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    // Levels share particles (a block's corner particles are also in finer blocks), so they're solved one after another - or, in Jacobi mode,
+    // all against the same positions, and then averaged.
+    for (int level = 0; level < object.numLongRangeLevels; ++level) {
+        solveLongRangeConstraintLevel(object, buffers, level, scaledForTimeStep(object.longRangeVGSConstants[level], buffers));
+    }
+    if (jacobiConstraints) {
+        applyJacobiCorrections(object, buffers);
+    }
+}
+
+void CPUSolver::solveLongRangeConstraintLevel(CPUSimulationObject& object, CPUSimulationBuffers& buffers, int level, const VGSConstants& vgsConstants) {
+    const std::array<uint, LONG_RANGE_LEVELS + 1>& levelOffsets = object.constraintTopology->longRangeConstraints.levelOffsets;
+    const uint firstConstraint = levelOffsets[level];
+    const uint endConstraint = levelOffsets[level + 1];
+    Particle* const particles = buffers.particles.data() + object.particleOffset;
+    const SolvedParticleWriter writer(particles, buffers, object.particleOffset, jacobiConstraints, level);
+    const float* const inverseMasses = buffers.inverseMasses.data() + object.particleOffset;
+    const uint8_t* const isAsleep = buffers.isAsleep.data() + object.particleOffset / 8;
+    const uint8_t* const isRigid = object.isRigid.data();
+    const uint* const longRangeParticleIndices = object.longRangeConstraints.particleIndices.data() + (static_cast<size_t>(firstConstraint) << 3);
+    const PassItems constraints = passItems(object, object.awakeLongRangeConstraints[level], endConstraint - firstConstraint);
+
+    parallelFor(constraints.count, constraintsPerTask, [&](int begin, int end) {
+        auto gather = [&](int c, Particle constraintParticles[8], float constraintInverseMasses[8]) {
+            const int constraintIdx = constraints[c];
+            // Lower 4 bits of the first entry count this constraint's broken face constraints (see longrangeconstraints.hlsl)
+            uint particleIdx0 = longRangeParticleIndices[constraintIdx << 3];
+            if ((particleIdx0 & 0xF) >= 3u) return false;
+
+            bool allSkipped = true;
+            for (int i = 0; i < 8; ++i) {
+                uint particleIdx = longRangeParticleIndices[(constraintIdx << 3) + i] >> 4;
+                allSkipped = allSkipped && (isAsleep[particleIdx >> 3] || isRigid[particleIdx >> 3]);
+                constraintParticles[i] = particles[particleIdx];
+                constraintInverseMasses[i] = inverseMasses[particleIdx];
+            }
+            return !allSkipped;
+        };
+
+        auto scatter = [&](int c, const Particle constraintParticles[8], const float*) {
+            const int constraintIdx = constraints[c];
+            for (int j = 0; j < 8; ++j) {
+                writer.write(longRangeParticleIndices[(constraintIdx << 3) + j] >> 4, constraintParticles[j]);
+            }
+        };
+
+        solveVGSGroups(begin, end, vgsConstants, true, convergedCorrectionSq(vgsConstants), !deterministic, gather, scatter);
+    });
+}
+
+uint CPUSolver::solveFaceConstraints(CPUSimulationObject& object, CPUSimulationBuffers& buffers, int axis) {
+    Particle* const particles = buffers.particles.data() + object.particleOffset;
+    const float* const inverseMasses = buffers.inverseMasses.data() + object.particleOffset;
+    const uint8_t* const isRigid = object.isRigid.data();
+    FaceConstraints& faceConstraints = object.faceConstraints[axis];
+    std::vector<int>& voxelIndices = faceConstraints.voxelIndices;
+    const std::vector<float>& limits = faceConstraints.limits;
+    FlatFaceConstraints& flatConstraints = object.flatFaceConstraints[axis];
+    const bool useFlatLayout = flatFaceConstraints && object.flatFaceConstraintsValid;
+    const VGSConstants vgsConstants = scaledForTimeStep(object.vgsConstants, buffers);
+    const uint* const faceA = faceAParticles[axis];
+    const uint* const faceB = faceBParticles[axis];
+    const PassItems constraints = passItems(object, object.awakeFaceConstraints[axis], useFlatLayout ? flatConstraints.size() : faceConstraints.size());
+    const SolvedParticleWriter writer(particles, buffers, object.particleOffset, jacobiConstraints, axis);
+
+    // Breaking a constraint also touches state shared with other constraints (surface flags, long-range counters), which the shader does atomically.
+    // Here each task records its broken constraints instead, and they're applied after the pass. (Only the long-range pass reads those, so it's equivalent.)
+    const int numTasks = Utils::divideRoundUp(constraints.count, constraintsPerTask);
+    std::vector<std::vector<FractureEvent>> brokenConstraintsPerTask(numTasks);
+    std::vector<float> peakStrainRatiosPerTask(numTasks, 0.0f);
+
+    parallelFor(constraints.count, constraintsPerTask, [&](int begin, int end) {
+        std::vector<FractureEvent>& brokenConstraints = brokenConstraintsPerTask[begin / constraintsPerTask];
+        float& peakStrainRatio = peakStrainRatiosPerTask[begin / constraintsPerTask];
+
+        // Whether a gathered constraint's 4 edges are all within its limits (otherwise it breaks, and brokenStrain is the strain of the edge that broke it)
+        auto isWithinLimits = [&](const Particle voxelParticles[8], float tensionLimit, float compressionLimit, float& brokenStrain) {
+            for (int i = 0; i < 4; ++i) {
+                float edgeLength = (position(voxelParticles[faceA[i]]) - position(voxelParticles[faceB[i]])).length();
+                float strain = (edgeLength - 2.0f * vgsConstants.particleRadius) / (2.0f * vgsConstants.particleRadius);
+                if (strain > tensionLimit || strain < compressionLimit) {
+                    brokenStrain = strain;
+                    return false;
+                }
+                peakStrainRatio = std::max(peakStrainRatio, (strain > 0.0f) ? strain / tensionLimit : strain / compressionLimit);
+            }
+            return true;
+        };
+
+        auto breakConstraint = [&](int constraintIdx, int voxelAIdx, int voxelBIdx, float strain) {
+            voxelIndices[constraintIdx * 2] = -1;
+            voxelIndices[constraintIdx * 2 + 1] = -1;
+            brokenConstraints.push_back({
+                static_cast<uint>(constraintIdx), static_cast<uint>(axis), static_cast<uint>(voxelAIdx), static_cast<uint>(voxelBIdx), strain, buffers.substep
+            });
+        };
+
+        if (useFlatLayout) {
+            auto gather = [&](int c, Particle voxelParticles[8], float voxelInverseMasses[8]) {
+                const int flatIdx = constraints[c];
+                if (flatConstraints.isBroken[flatIdx]) return false;
+                const uint* const indices = flatConstraints.particleIndices.data() + (static_cast<size_t>(flatIdx) << 3);
+                // An unbroken constraint's voxels are in the same island, so B is rigid too
+                uint voxelAIdx = indices[faceB[0]] >> 3;
+                if (isRigid[voxelAIdx]) return false;
+
+                for (int i = 0; i < 8; ++i) {
+                    voxelParticles[i] = particles[indices[i]];
+                    voxelInverseMasses[i] = inverseMasses[indices[i]];
+                }
+                float strain;
+                if (isWithinLimits(voxelParticles, flatConstraints.tensionLimits[flatIdx], flatConstraints.compressionLimits[flatIdx], strain)) return true;
+
+                flatConstraints.isBroken[flatIdx] = 1;
+                breakConstraint(static_cast<int>(flatConstraints.constraintIndices[flatIdx]), static_cast<int>(voxelAIdx), static_cast<int>(indices[faceA[0]] >> 3), strain);
+                return false;
+            };
+
+            auto scatter = [&](int c, const Particle voxelParticles[8], const float voxelInverseMasses[8]) {
+                const uint* const indices = flatConstraints.particleIndices.data() + (static_cast<size_t>(constraints[c]) << 3);
+                for (int j = 0; j < 4; ++j) {
+                    if (voxelInverseMasses[j] == 0.0f) continue;
+                    writer.write(indices[faceB[j]], voxelParticles[faceB[j]]);
+                    writer.write(indices[faceA[j]], voxelParticles[faceA[j]]);
+                }
+            };
+
+            solveVGSGroups(begin, end, vgsConstants, true, convergedCorrectionSq(vgsConstants), !deterministic, gather, scatter);
+            return;
+        }
+
+        auto gather = [&](int c, Particle voxelParticles[8], float voxelInverseMasses[8]) {
+            const int constraintIdx = constraints[c];
+            int voxelAIdx = voxelIndices[constraintIdx * 2];
+            int voxelBIdx = voxelIndices[constraintIdx * 2 + 1];
+            if (voxelAIdx == -1 || voxelBIdx == -1) return false;
+            // An unbroken constraint's voxels are in the same island, so B is rigid too
+            if (isRigid[voxelAIdx]) return false;
+
+            const Particle* const voxelAParticles = particles + (voxelAIdx << 3);
+            const Particle* const voxelBParticles = particles + (voxelBIdx << 3);
+            for (int i = 0; i < 4; ++i) {
+                // Same (intentional) A/B index swap as faceconstraints.hlsl
+                voxelParticles[faceB[i]] = voxelAParticles[faceA[i]];
+                voxelParticles[faceA[i]] = voxelBParticles[faceB[i]];
+                voxelInverseMasses[faceB[i]] = inverseMasses[(voxelAIdx << 3) + faceA[i]];
+                voxelInverseMasses[faceA[i]] = inverseMasses[(voxelBIdx << 3) + faceB[i]];
+            }
+            float strain;
+            if (isWithinLimits(voxelParticles, limits[constraintIdx * 2], limits[constraintIdx * 2 + 1], strain)) return true;
+
+            breakConstraint(constraintIdx, voxelAIdx, voxelBIdx, strain);
+            return false;
+        };
+
+        auto scatter = [&](int c, const Particle voxelParticles[8], const float voxelInverseMasses[8]) {
+            const int constraintIdx = constraints[c];
+            const uint voxelAStart = static_cast<uint>(voxelIndices[constraintIdx * 2]) << 3;
+            const uint voxelBStart = static_cast<uint>(voxelIndices[constraintIdx * 2 + 1]) << 3;
+            for (int j = 0; j < 4; ++j) {
+                if (voxelInverseMasses[j] == 0.0f) continue;
+                writer.write(voxelAStart + faceA[j], voxelParticles[faceB[j]]);
+                writer.write(voxelBStart + faceB[j], voxelParticles[faceA[j]]);
+            }
+        };
+
+        solveVGSGroups(begin, end, vgsConstants, true, convergedCorrectionSq(vgsConstants), !deterministic, gather, scatter);
+    });
+
+    uint* const isSurface = buffers.isSurface.data() + object.particleOffset / 8;
+    std::vector<uint>& longRangeCounters = object.longRangeConstraints.particleIndices;
+    const std::vector<uint>& faceIdxToLR = object.constraintTopology->longRangeConstraints.faceIdxToLRConstraintIndices[axis];
+    uint numBroken = 0;
+
+    for (float peakStrainRatio : peakStrainRatiosPerTask) {
+        buffers.peakStrainRatio = std::max(buffers.peakStrainRatio, peakStrainRatio);
+    }
+
+    for (const std::vector<FractureEvent>& brokenConstraints : brokenConstraintsPerTask) {
+        for (const FractureEvent& broken : brokenConstraints) {
+            uint constraintIdx = broken.constraintIdx;
+            isSurface[broken.voxelA] = 1;
+            isSurface[broken.voxelB] = 1;
+            object.brokenConnections.emplace_back(broken.voxelA, broken.voxelB);
+
+            if (buffers.recordFractureEvents) {
+                FractureEvent& event = buffers.fractureEvents.emplace_back(broken);
+                event.voxelA += object.particleOffset / 8;
+                event.voxelB += object.particleOffset / 8;
+            }
+
+            for (int i = 0; i < LONG_RANGE_SLOTS_PER_FACE; ++i) {
+                uint longRangeConstraintIdx = faceIdxToLR[constraintIdx * LONG_RANGE_SLOTS_PER_FACE + i];
+                if (longRangeConstraintIdx == 0xFFFFFFFF) continue;
+                // Saturates, same as faceconstraints.hlsl
+                uint& counter = longRangeCounters[longRangeConstraintIdx << 3];
+                if ((counter & 0xF) < 0xF) counter += 1;
+            }
+            ++numBroken;
+        }
+    }
+
+    if (useFlatLayout) {
+        flatConstraints.numBroken += numBroken;
+        if (flatConstraints.numBroken * flatCompactionDivisor > flatConstraints.size()) {
+            compactFlatFaceConstraints(flatConstraints);
+            if (object.hasSleepingVoxels) updateAwakeFaceConstraints(object, buffers, axis);
+        }
+    }
+
+    return numBroken;
+}
+
+/**
+ * Ends a Jacobi sweep: moves each particle by the average of the corrections the sweep's constraints stored for it, summed in slot order
+ * so the result doesn't depend on which thread solved which constraint, and clears the slots for the next sweep.
+ */
+void CPUSolver::applyJacobiCorrections(CPUSimulationObject& object, CPUSimulationBuffers& buffers) {
+    constexpr int numSlots = CPUSimulationBuffers::jacobiSlotsPerParticle;
+    Particle* const particles = buffers.particles.data() + object.particleOffset;
+    const MFloatVector* const corrections = buffers.jacobiCorrections.data() + static_cast<size_t>(object.particleOffset) * numSlots;
+    uint8_t* const slotMasks = buffers.jacobiSlotMasks.data() + object.particleOffset;
+
+    parallelFor(static_cast<int>(object.numParticles), particlesPerTask, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const uint8_t slotMask = slotMasks[i];
+            if (slotMask == 0) continue;
+
+            MFloatVector correction = MFloatVector::zero;
+            int numCorrections = 0;
+            for (int slot = 0; slot < numSlots; ++slot) {
+                if (!(slotMask & (1u << slot))) continue;
+                correction += corrections[static_cast<size_t>(i) * numSlots + slot];
+                ++numCorrections;
+            }
+
+            setPosition(particles[i], position(particles[i]) + correction / static_cast<float>(numCorrections));
+            slotMasks[i] = 0;
+        }
+    });
+}
+
+void CPUSolver::updateFlatFaceConstraints(CPUSimulationObject& object) {
+    if (!flatFaceConstraints) {
+        // Breaks aren't applied to the flattened copy while it's unused, so it has to be rebuilt if the layout is turned back on.
+        object.flatFaceConstraintsValid = false;
+        return;
+    }
+    if (object.flatFaceConstraintsValid) return;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        const FaceConstraints& faceConstraints = object.faceConstraints[axis];
+        const uint* const faceA = faceAParticles[axis];
+        const uint* const faceB = faceBParticles[axis];
+        FlatFaceConstraints& flatConstraints = object.flatFaceConstraints[axis];
+
+        // Unbroken constraints only, ordered by their A voxel (and so roughly by particle index)
+        std::vector<uint>& constraintIndices = flatConstraints.constraintIndices;
+        constraintIndices.clear();
+        for (uint constraintIdx = 0; constraintIdx < faceConstraints.size(); ++constraintIdx) {
+            if (faceConstraints.voxelIndices[constraintIdx * 2] == -1 || faceConstraints.voxelIndices[constraintIdx * 2 + 1] == -1) continue;
+            constraintIndices.push_back(constraintIdx);
+        }
+        std::stable_sort(constraintIndices.begin(), constraintIndices.end(), [&](uint a, uint b) {
+            return faceConstraints.voxelIndices[a * 2] < faceConstraints.voxelIndices[b * 2];
+        });
+
+        const int numConstraints = static_cast<int>(constraintIndices.size());
+        flatConstraints.particleIndices.resize(8 * static_cast<size_t>(numConstraints));
+        flatConstraints.tensionLimits.resize(numConstraints);
+        flatConstraints.compressionLimits.resize(numConstraints);
+        flatConstraints.isBroken.assign(numConstraints, 0);
+        flatConstraints.numBroken = 0;
+
+        parallelFor(numConstraints, constraintsPerTask, [&](int begin, int end) {
+            for (int flatIdx = begin; flatIdx < end; ++flatIdx) {
+                uint constraintIdx = constraintIndices[flatIdx];
+                uint voxelAIdx = static_cast<uint>(faceConstraints.voxelIndices[constraintIdx * 2]);
+                uint voxelBIdx = static_cast<uint>(faceConstraints.voxelIndices[constraintIdx * 2 + 1]);
+                uint* const indices = flatConstraints.particleIndices.data() + (static_cast<size_t>(flatIdx) << 3);
+                for (int i = 0; i < 4; ++i) {
+                    // Same A/B swap as the gather in solveFaceConstraints
+                    indices[faceB[i]] = (voxelAIdx << 3) + faceA[i];
+                    indices[faceA[i]] = (voxelBIdx << 3) + faceB[i];
+                }
+                flatConstraints.tensionLimits[flatIdx] = faceConstraints.limits[constraintIdx * 2];
+                flatConstraints.compressionLimits[flatIdx] = faceConstraints.limits[constraintIdx * 2 + 1];
+            }
+        });
+    }
+
+    object.flatFaceConstraintsValid = true;
+}
+
+void CPUSolver::compactFlatFaceConstraints(FlatFaceConstraints& flatConstraints) {
+    // In place and in order, so the locality ordering is kept.
+    uint numKept = 0;
+    for (uint flatIdx = 0; flatIdx < flatConstraints.size(); ++flatIdx) {
+        if (flatConstraints.isBroken[flatIdx]) continue;
+
+        if (numKept != flatIdx) {
+            std::copy_n(flatConstraints.particleIndices.begin() + (static_cast<size_t>(flatIdx) << 3), 8,
+                        flatConstraints.particleIndices.begin() + (static_cast<size_t>(numKept) << 3));
+            flatConstraints.tensionLimits[numKept] = flatConstraints.tensionLimits[flatIdx];
+            flatConstraints.compressionLimits[numKept] = flatConstraints.compressionLimits[flatIdx];
+            flatConstraints.constraintIndices[numKept] = flatConstraints.constraintIndices[flatIdx];
+        }
+        ++numKept;
+    }
+
+    flatConstraints.particleIndices.resize(8 * static_cast<size_t>(numKept));
+    flatConstraints.tensionLimits.resize(numKept);
+    flatConstraints.compressionLimits.resize(numKept);
+    flatConstraints.constraintIndices.resize(numKept);
+    flatConstraints.isBroken.assign(numKept, 0);
+    flatConstraints.numBroken = 0;
+}
+
+void CPUSolver::solveParticleCollisions(CPUSimulationBuffers& buffers, const ParticleCollisionCB& collisionConstants, CPUCollisionGrid& grid) {
+    const uint hashGridSize = collisionConstants.hashGridSize;
+    const float inverseCellSize = collisionConstants.inverseCellSize;
+    const float friction = collisionConstants.friction;
+    const int numParticles = static_cast<int>(buffers.particles.size());
+    if (hashGridSize == 0 || numParticles == 0) return;
+
+    Particle* const particles = buffers.particles.data();
+    const Particle* const frameStartParticles = buffers.oldParticles.data();
+    const float* const inverseMasses = buffers.inverseMasses.data();
+    const float* const radii = buffers.radii.data();
+    const uint* const isSurface = buffers.isSurface.data();
+    const uint8_t* const isAsleep = buffers.isAsleep.data();
+
+    // Sleeping particles only matter as obstacles for awake ones
+    const PassItems awakeVoxels = buffers.hasSleepingVoxels
+        ? PassItems{ &buffers.awakeVoxels, static_cast<int>(buffers.awakeVoxels.size()) }
+        : PassItems{ nullptr, numParticles / 8 };
+    if (awakeVoxels.count == 0) return;
+
+    if (grid.cellCursors.size() != hashGridSize) {
+        grid.cellCursors = std::vector<std::atomic<uint>>(hashGridSize);
+    }
+    grid.cellStarts.resize(hashGridSize + 1);
+    grid.particlesByCell.resize(8 * static_cast<size_t>(numParticles));
+
+    // Calls bin(particleIdx, cellHash) for each cell each surface particle goes into. Awake particles go into every cell they overlap, first;
+    // sleeping particles, afterwards, only into those cells that hasAwakeParticle. (Sleeping particles never make an empty cell non-empty,
+    // so the check doesn't depend on which of them were binned first.)
+    auto forEachBinnedCell = [&](auto&& hasAwakeParticle, auto&& bin) {
+        parallelFor(awakeVoxels.count, particlesPerTask / 8, [&](int begin, int end) {
+            for (int v = begin; v < end; ++v) {
+                const int voxel = awakeVoxels[v];
+                if (!isSurface[voxel]) continue;
+                for (int i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+                    forEachOverlappedCell(particles[i], radii[i], inverseCellSize, hashGridSize, [&](uint cellHash) { bin(i, cellHash); });
+                }
+            }
+        });
+
+        if (!buffers.hasSleepingVoxels) return;
+        parallelFor(numParticles / 8, particlesPerTask / 8, [&](int begin, int end) {
+            for (int voxel = begin; voxel < end; ++voxel) {
+                if (!isSurface[voxel] || !isAsleep[voxel]) continue;
+                for (int i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+                    forEachOverlappedCell(particles[i], radii[i], inverseCellSize, hashGridSize, [&](uint cellHash) {
+                        if (hasAwakeParticle(cellHash)) bin(i, cellHash);
+                    });
+                }
+            }
+        });
+    };
+
+    // Count particles per cell (build_collision_grid_buffer.hlsl)
+    for (std::atomic<uint>& count : grid.cellCursors) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    forEachBinnedCell(
+        [&](uint cellHash) { return grid.cellCursors[cellHash].load(std::memory_order_relaxed) != 0; },
+        [&](int, uint cellHash) { grid.cellCursors[cellHash].fetch_add(1, std::memory_order_relaxed); }
+    );
+
+    // Scan (prefixscan.hlsl). A serial pass over the cells is fast enough relative to the rest of the substep.
+    uint runningTotal = 0;
+    for (uint cell = 0; cell < hashGridSize; ++cell) {
+        grid.cellStarts[cell] = runningTotal;
+        runningTotal += grid.cellCursors[cell].load(std::memory_order_relaxed);
+        grid.cellCursors[cell].store(grid.cellStarts[cell], std::memory_order_relaxed);
+    }
+    grid.cellStarts[hashGridSize] = runningTotal;
+
+    // Scatter particle indices into their cells (build_collision_particle_buffer.hlsl)
+    forEachBinnedCell(
+        [&](uint cellHash) { return grid.cellStarts[cellHash + 1] != grid.cellStarts[cellHash]; },
+        [&](int i, uint cellHash) {
+            uint slot = grid.cellCursors[cellHash].fetch_add(1, std::memory_order_relaxed);
+            grid.particlesByCell[slot] = static_cast<uint>(i);
+        }
+    );
+
+    // A particle is binned into every cell it overlaps, and cells are solved concurrently, so each cell's corrections are staged and summed
+    // after the pass (no cell reads another's results mid-pass, and no two tasks write the same particle).
+    grid.correctionsByCell.resize(runningTotal);
+    grid.positionChangedByCell.assign(runningTotal, 0);
+
+    // The order particles land in a cell depends on thread timing, and the pairwise solve is order dependent - so sort each cell by particle index.
+    if (deterministic) {
+        parallelFor(static_cast<int>(hashGridSize), collisionCellsPerTask, [&](int begin, int end) {
+            for (int cell = begin; cell < end; ++cell) {
+                std::sort(grid.particlesByCell.begin() + grid.cellStarts[cell], grid.particlesByCell.begin() + grid.cellStarts[cell + 1]);
+            }
+        });
+    }
+
+    // Resolve collisions pairwise within each cell (solvecollisions.hlsl)
+    constexpr float jitterEpsilon = 1e-3f;
+    constexpr float relaxationFactor = 0.35f;
+
+    std::vector<ResidualStats> penetrationsPerTask(measureResiduals ? Utils::divideRoundUp(static_cast<int>(hashGridSize), collisionCellsPerTask) : 0);
+
+    parallelFor(static_cast<int>(hashGridSize), collisionCellsPerTask, [&](int begin, int end) {
+        ResidualStats* const penetrations = measureResiduals ? &penetrationsPerTask[begin / collisionCellsPerTask] : nullptr;
+        std::vector<Particle> cellParticles;
+        std::vector<uint> cellParticleIndices;
+        std::vector<bool> positionChanged;
+
+        for (int cell = begin; cell < end; ++cell) {
+            uint particleStartIdx = grid.cellStarts[cell];
+            uint numParticlesInCell = grid.cellStarts[cell + 1] - particleStartIdx;
+            if (numParticlesInCell < 2) continue;
+
+            cellParticles.resize(numParticlesInCell);
+            cellParticleIndices.resize(numParticlesInCell);
+            positionChanged.assign(numParticlesInCell, false);
+            for (uint u = 0; u < numParticlesInCell; ++u) {
+                cellParticleIndices[u] = grid.particlesByCell[particleStartIdx + u];
+                cellParticles[u] = particles[cellParticleIndices[u]];
+            }
+
+            for (uint i = 0; i < numParticlesInCell; ++i) {
+                for (uint j = i + 1; j < numParticlesInCell; ++j) {
+                    uint globalParticleIdx_i = cellParticleIndices[i];
+                    uint globalParticleIdx_j = cellParticleIndices[j];
+                    uint globalVoxelIdx_i = globalParticleIdx_i >> 3;
+                    uint globalVoxelIdx_j = globalParticleIdx_j >> 3;
+                    if (globalVoxelIdx_i == globalVoxelIdx_j) continue; // Skip particle pairs from the same voxel.
+                    if (isAsleep[globalVoxelIdx_i] && isAsleep[globalVoxelIdx_j]) continue;
+
+                    float radiusA = radii[globalParticleIdx_i];
+                    float radiusB = radii[globalParticleIdx_j];
+                    // (particles[] is untouched until the pass ends, so this matches the cells the pair was binned into)
+                    if (getPairHomeCellHash(particles[globalParticleIdx_i], radiusA, particles[globalParticleIdx_j], radiusB, inverseCellSize, hashGridSize) != static_cast<uint>(cell)) continue;
+
+                    const Particle particleA = cellParticles[i];
+                    const Particle particleB = cellParticles[j];
+                    float invMassA = inverseMasses[globalParticleIdx_i];
+                    float invMassB = inverseMasses[globalParticleIdx_j];
+                    float invMassSum = invMassA + invMassB;
+                    if (invMassSum <= 0.0f) continue; // Both particles are immovable.
+
+                    float distanceSquared;
+                    MFloatVector particleAToB;
+                    if (!doParticlesOverlap(position(particleA), position(particleB), radiusA, radiusB, distanceSquared, particleAToB)) continue;
+                    particleAToB.normalize();
+                    float delta = (radiusA + radiusB) - std::sqrt(distanceSquared);
+                    if (penetrations) penetrations->add(delta);
+
+                    float jitterThreshold = jitterEpsilon * std::min(radiusA, radiusB);
+                    if (delta <= jitterThreshold) continue;
+                    delta -= jitterThreshold;
+
+                    // Approximate each voxel's center by the midpoint of the particle and its diagonal, to augment the normal and avoid voxel interlock.
+                    uint diagonalIdx_i = (globalVoxelIdx_i << 3) + 7 - (globalParticleIdx_i - (globalVoxelIdx_i << 3));
+                    uint diagonalIdx_j = (globalVoxelIdx_j << 3) + 7 - (globalParticleIdx_j - (globalVoxelIdx_j << 3));
+                    MFloatVector voxelACenter = (position(particleA) + position(particles[diagonalIdx_i])) * 0.5f;
+                    MFloatVector voxelBCenter = (position(particleB) + position(particles[diagonalIdx_j])) * 0.5f;
+
+                    MFloatVector augmentedNormal = particleAToB;
+                    MFloatVector voxelAToB;
+                    if (doParticlesOverlap(voxelACenter, voxelBCenter, 1.5f * radiusA, 1.5f * radiusB, distanceSquared, voxelAToB)) {
+                        augmentedNormal = (voxelAToB.normal() + particleAToB).normal();
+                    }
+
+                    float invMassSumReciprocal = 1.0f / invMassSum;
+                    MFloatVector newPositionA = position(cellParticles[i]) - delta * relaxationFactor * (invMassSumReciprocal * invMassA) * augmentedNormal;
+                    MFloatVector newPositionB = position(cellParticles[j]) + delta * relaxationFactor * (invMassSumReciprocal * invMassB) * augmentedNormal;
+
+                    // Friction, relative to where the particles started the substep
+                    if (friction > 0.0f) {
+                        MFloatVector frameDeltaA = position(particleA) - position(frameStartParticles[globalParticleIdx_i]);
+                        MFloatVector frameDeltaB = position(particleB) - position(frameStartParticles[globalParticleIdx_j]);
+                        MFloatVector relFrameDelta = frameDeltaA - frameDeltaB;
+                        MFloatVector relTangent = relFrameDelta - (relFrameDelta * augmentedNormal) * augmentedNormal;
+
+                        float relTangentLenSq = relTangent * relTangent;
+                        if (relTangentLenSq >= 1e-8f) {
+                            float scale = std::min(1.0f, (friction * delta) / std::sqrt(relTangentLenSq));
+                            MFloatVector relTangentClamped = relTangent * scale;
+                            newPositionA -= (invMassA * invMassSumReciprocal) * relTangentClamped;
+                            newPositionB += (invMassB * invMassSumReciprocal) * relTangentClamped;
+                        }
+                    }
+
+                    setPosition(cellParticles[i], newPositionA);
+                    setPosition(cellParticles[j], newPositionB);
+                    positionChanged[i] = true;
+                    positionChanged[j] = true;
+                }
+            }
+
+            for (uint v = 0; v < numParticlesInCell; ++v) {
+                if (!positionChanged[v]) continue;
+                grid.correctionsByCell[particleStartIdx + v] = position(cellParticles[v]) - position(particles[cellParticleIndices[v]]);
+                grid.positionChangedByCell[particleStartIdx + v] = 1;
+            }
+        }
+    });
+
+    for (const ResidualStats& penetrations : penetrationsPerTask) {
+        buffers.residuals.penetration.merge(penetrations);
+    }
+
+    // Sum each particle's corrections from all its cells, in cell order so the result doesn't depend on thread timing.
+    for (uint slot = 0; slot < runningTotal; ++slot) {
+        if (!grid.positionChangedByCell[slot]) continue;
+        Particle& particle = particles[grid.particlesByCell[slot]];
+        setPosition(particle, position(particle) + grid.correctionsByCell[slot]);
+    }
+}
+
+void CPUSolver::solvePrimitiveCollisions(CPUSimulationBuffers& buffers, const ColliderBuffer& colliderBuffer) {
+    const int numColliders = colliderBuffer.numColliders;
+    if (numColliders == 0) return;
+
+    Particle* const particles = buffers.particles.data();
+    const Particle* const oldParticles = buffers.oldParticles.data();
+    const float* const inverseMasses = buffers.inverseMasses.data();
+    const float* const radii = buffers.radii.data();
+
+    // Sleeping voxels are left out here too, as in the per-object passes.
+    const PassItems voxels = buffers.hasSleepingVoxels
+        ? PassItems{ &buffers.awakeVoxels, static_cast<int>(buffers.awakeVoxels.size()) }
+        : PassItems{ nullptr, static_cast<int>(buffers.particles.size() / 8) };
+
+    parallelFor(voxels.count, particlesPerTask / 8, [&](int begin, int end) {
+        for (int v = begin; v < end; ++v) {
+            for (int p = (voxels[v] << 3); p < (voxels[v] << 3) + 8; ++p) {
+                if (inverseMasses[p] == 0.0f) continue;
+                Particle& particle = particles[p];
+
+                MFloatVector particlePosition = position(particle);
+                const MFloatVector oldPosition = position(oldParticles[p]);
+                const float radius = radii[p];
+
+                for (int i = 0; i < numColliders; ++i) {
+                    const float (&wMatrix)[4][4] = colliderBuffer.worldMatrix[i];
+                    const float (&invWMatrix)[4][4] = colliderBuffer.inverseWorldMatrix[i];
+                    const float friction = invWMatrix[3][3];
+                    const float type = wMatrix[3][3];
+
+                    MFloatVector colliderNormal = MFloatVector::zero;
+                    if (type == 0.0f) {
+                        colliderNormal = solveBoxCollision(wMatrix, invWMatrix, particlePosition, radius);
+                    } else if (type == 1.0f) {
+                        colliderNormal = solveSphereCollision(wMatrix, particlePosition, radius);
+                    } else if (type == 2.0f) {
+                        colliderNormal = solveCapsuleCollision(wMatrix, invWMatrix, particlePosition, radius);
+                    } else if (type == 3.0f) {
+                        colliderNormal = solveCylinderCollision(wMatrix, invWMatrix, particlePosition, radius);
+                    } else if (type == 4.0f) {
+                        colliderNormal = solvePlaneCollision(wMatrix, particlePosition, radius);
+                    }
+
+                    if (colliderNormal == MFloatVector::zero) continue;
+
+                    // Friction: remove a fraction of the tangential movement against the collider
+                    MFloatVector deltaPos = particlePosition - oldPosition;
+                    MFloatVector deltaTangent = deltaPos - (deltaPos * colliderNormal) * colliderNormal;
+                    particlePosition -= deltaTangent * friction;
+                }
+
+                setPosition(particle, particlePosition);
+            }
+        }
+    });
+}
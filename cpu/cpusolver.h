@@ -0,0 +1,337 @@
+#pragma once
+
+#include "shaders/constants.hlsli"
+#include "directx/compute/faceconstraintscompute.h"
+#include "directx/compute/longrangeconstraintscompute.h"
+#include "directx/compute/buildcollisiongridcompute.h"
+#include "directx/compute/solveprimitivecollisionscompute.h"
+#include "constrainttopology.h"
+#include "voxelislands.h"
+#include "shapematching.h"
+#include <maya/MThreadPool.h>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+/**
+ * Running max and mean of one kind of constraint error.
+ */
+struct ResidualStats {
+    float max = 0.0f;
+    double sum = 0.0;
+    uint64_t count = 0;
+
+    void add(float value) {
+        max = std::max(max, value);
+        sum += value;
+        ++count;
+    }
+
+    void merge(const ResidualStats& other) {
+        max = std::max(max, other.max);
+        sum += other.sum;
+        count += other.count;
+    }
+
+    float mean() const {
+        return (count > 0) ? static_cast<float>(sum / count) : 0.0f;
+    }
+};
+
+/**
+ * The constraint errors left by the solver, over every substep of a frame (see CPUSolver::setMeasureResiduals).
+ */
+struct SolverResiduals {
+    ResidualStats volumeError;  // Per voxel: |volume - rest volume| / rest volume, after the object's constraint passes
+    ResidualStats edgeStrain;   // Per unbroken face constraint edge: |length - particle diameter| / particle diameter, likewise
+    ResidualStats penetration;  // Per colliding particle pair: overlap depth (world units), as found by the particle collision pass
+};
+
+/**
+ * Host copies of the global simulation buffers (see GlobalSolver::BufferType), shared by every PBD object.
+ */
+struct CPUSimulationBuffers {
+    std::vector<Particle> particles;
+    std::vector<Particle> oldParticles;
+    // Per particle, unpacked from radiusAndInvMass once per frame (see CPUSolver::unpackParticleAttributes). Neither changes during a frame,
+    // so the passes read these streams instead of converting half floats every time they touch a particle.
+    std::vector<float> inverseMasses;
+    std::vector<float> radii;
+    std::vector<uint> isSurface;
+    std::vector<uint> isDragging;
+    std::vector<uint8_t> isAsleep; // Per voxel; filled in by each object at the start of the frame (see CPUSolver::updateSleepingIslands)
+    // Every object's awake voxels, by index into the buffers, for the collision passes. Only meaningful while hasSleepingVoxels (see CPUSolver::updateAwakeVoxels).
+    bool hasSleepingVoxels = false;
+    std::vector<uint> awakeVoxels;
+    SolverResiduals residuals;     // Accumulated over the frame, if measuring
+    // Substep length this frame, relative to the nominal one (numSubsteps / substeps actually taken). See CPUSolver::chooseSubsteps.
+    float timeStepScale = 1.0f;
+    // Largest face constraint strain seen over the frame, as a fraction of that constraint's breaking limit.
+    float peakStrainRatio = 0.0f;
+    // Bumped every time the buffers are re-synced from the GPU, so each object knows when its own host state is stale.
+    uint syncId = 0;
+    // Bumped whenever every object's constraint buffers may have changed on the GPU (a GPU-simulated frame, a cache restore). Between bumps,
+    // the objects' host copies of their constraints are authoritative, so they aren't read back every frame.
+    uint gpuConstraintsVersion = 0;
+    // Face constraint breaks over the frame, if recording (see FractureEventLog). Voxel indices are global, same as the GPU records them.
+    std::vector<FractureEvent> fractureEvents;
+    bool recordFractureEvents = false;
+    uint substep = 0; // Within the frame, to stamp fracture events with
+
+    // Jacobi mode scratch space (see CPUSolver::setJacobiConstraints): per particle, the correction from each constraint it's in during a sweep,
+    // one slot per face axis / long-range level, and a mask of the slots filled. Particles share at most one constraint per axis / level, so no two
+    // constraints ever write the same slot.
+    inline static constexpr int jacobiSlotsPerParticle = std::max(3, LONG_RANGE_LEVELS);
+    std::vector<MFloatVector> jacobiCorrections;
+    std::vector<uint8_t> jacobiSlotMasks;
+};
+
+/**
+ * One axis' face constraints, flattened for the CPU face constraint pass: per constraint, the 8 particle indices it gathers, in the order the
+ * VGS kernel sees them (so there's no remapping through faceAParticles / faceBParticles), both of its limits, and its index in FaceConstraints.
+ * Ordered by voxel, so that consecutive constraints touch nearby particles. Broken constraints are flagged, then compacted out once enough of them
+ * pile up, instead of being skipped over as -1 sentinels for the rest of the simulation.
+ */
+struct FlatFaceConstraints {
+    std::vector<uint> particleIndices;   // 8 per constraint
+    std::vector<float> tensionLimits;
+    std::vector<float> compressionLimits;
+    std::vector<uint> constraintIndices; // Into FaceConstraints, which the long-range counters and the GPU copy go by
+    std::vector<uint8_t> isBroken;
+    uint numBroken = 0;                  // Flagged since the last compaction
+
+    uint size() const {
+        return static_cast<uint>(constraintIndices.size());
+    }
+};
+
+/**
+ * Host copy of everything one PBD object's compute shaders own or are bound to: the constraint buffers, and the same constants.
+ * Voxel and particle indices are local to the object, exactly as on the GPU (where the object's views start at particleOffset).
+ */
+struct CPUSimulationObject {
+    uint particleOffset = 0;
+    uint numParticles = 0;
+    std::array<FaceConstraints, 3> faceConstraints;
+    LongRangeConstraints longRangeConstraints; // Only the particle indices (and their counters); the face mapping is in constraintTopology
+    std::shared_ptr<const ConstraintTopology> constraintTopology;
+    VGSConstants vgsConstants;
+    std::array<VGSConstants, LONG_RANGE_LEVELS> longRangeVGSConstants; // Per level (see LongRangeConstraints::blockSize)
+    int numLongRangeLevels = 1;                                        // Levels solved, finest first
+    PreVGSConstants preVGSConstants;
+
+    // Derived from faceConstraints (see CPUSolver::updateFlatFaceConstraints). Breaks are applied to both; the owner invalidates this
+    // when faceConstraints change any other way.
+    std::array<FlatFaceConstraints, 3> flatFaceConstraints;
+    bool flatFaceConstraintsValid = false;
+
+    // The object's pieces, and how long each has been at rest. Kept up to date as constraints break during the substeps;
+    // the owner invalidates them (waking everything) when the constraints change any other way.
+    struct IslandSleepState {
+        uint framesAtRest = 0;
+        bool asleep = false;
+    };
+    VoxelIslands islands;
+    std::vector<IslandSleepState> islandSleepStates;
+
+    // While any of the object's voxels sleep, compacted lists of what's awake, rebuilt each frame (see CPUSolver::updateSleepingIslands),
+    // so the passes only go over the pieces still moving instead of skipping sleeping ones item by item. Unused while everything is awake.
+    bool hasSleepingVoxels = false;
+    std::vector<uint> awakeVoxels;
+    std::array<std::vector<uint>, 3> awakeFaceConstraints;                     // Per axis: into flatFaceConstraints if that layout is in use, else faceConstraints
+    std::array<std::vector<uint>, LONG_RANGE_LEVELS> awakeLongRangeConstraints; // Per level: relative to the level's first constraint
+    std::vector<std::pair<uint, uint>> brokenConnections; // Voxel pairs whose face constraints broke this substep
+
+    // Per island: whether it's currently simulated as a single rigid body (see CPUSolver::updateRigidClusters), and its rest shape if so.
+    struct RigidCluster {
+        bool active = false;
+        uint framesUnstressed = 0;
+        std::vector<uint> voxels;
+        std::vector<MFloatVector> restOffsets; // Per particle of voxels, from the center of mass, in the orientation it had when it became rigid
+        ShapeMatching::Quaternion rotation;
+    };
+    std::vector<RigidCluster> rigidClusters;
+    std::vector<uint8_t> isRigid; // Per voxel
+};
+
+/**
+ * Scratch space for the particle collision broadphase, kept around between substeps to avoid reallocating.
+ */
+struct CPUCollisionGrid {
+    std::vector<std::atomic<uint>> cellCursors;   // Per-cell particle counts, then per-cell write cursors while scattering
+    std::vector<uint> cellStarts;                 // Exclusive scan of the counts, plus a guard entry holding the total
+    std::vector<uint> particlesByCell;
+    // Each cell's correction to each of its particles, per slot of particlesByCell, summed in slot order once every cell is solved.
+    std::vector<MFloatVector> correctionsByCell;
+    std::vector<uint8_t> positionChangedByCell;
+};
+
+/**
+ * CPU implementation of the simulation substep: the same passes, in the same order, as the compute shaders
+ * (pre-VGS integration, per-voxel VGS, long-range constraints, face constraints, then particle and primitive collisions),
+ * operating on host copies of the same buffers. Each pass is spread over Maya's thread pool.
+ *
+ * Within each constraint pass, no two voxels / constraints share a particle (see PBD::constructFaceToFaceConstraints), so they're solved concurrently
+ * without synchronization and still give the same result as a serial Gauss-Seidel sweep.
+ *
+ * In Jacobi mode (see setJacobiConstraints), the long-range and face constraint passes instead all solve against the positions from before the pass,
+ * and each particle then moves by the average of the corrections it got.
+ *
+ * Particle collisions are the exception: a particle is binned into every cell it overlaps, and those cells are solved concurrently against the
+ * positions from before the pass, each pair only in one of the cells it shares. Every cell's corrections to a particle are then summed. In deterministic mode, cell contents are also sorted, and the scalar VGS kernel is used,
+ * so that the same scene produces bit-identical results regardless of thread count (or SIMD support).
+ */
+class CPUSolver {
+public:
+    CPUSolver() = delete;
+    ~CPUSolver() = delete;
+
+    // Runs the per-object passes for one substep. Returns the number of face constraints that broke.
+    static uint simulateSubstep(CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+
+    static void solveParticleCollisions(CPUSimulationBuffers& buffers, const ParticleCollisionCB& collisionConstants, CPUCollisionGrid& grid);
+
+    static void solvePrimitiveCollisions(CPUSimulationBuffers& buffers, const ColliderBuffer& colliderBuffer);
+
+    // Calls body(begin, end) over [0, count) in chunks of grainSize, one thread pool task per chunk.
+    // Caller is responsible for holding a reference to the thread pool (MThreadPool::init / release) around calls.
+    static void parallelFor(int count, int grainSize, const std::function<void(int, int)>& body);
+
+    static void setDeterministic(bool deterministic) { CPUSolver::deterministic = deterministic; }
+    static bool isDeterministic() { return deterministic; }
+
+    // Rebuilds the object's islands if they've been invalidated. Call at the start of each frame, once its constraints are in sync.
+    static void updateIslands(CPUSimulationObject& object);
+
+    // Whether the face constraint pass uses the flattened layout (FlatFaceConstraints) rather than going through voxel index pairs.
+    // Same results either way; this is only about memory access patterns.
+    static void setFlatFaceConstraints(bool flatFaceConstraints) { CPUSolver::flatFaceConstraints = flatFaceConstraints; }
+
+    // Builds the object's flattened face constraints if the layout is enabled and they've been invalidated.
+    // Call at the start of each frame, once its constraints are in sync.
+    static void updateFlatFaceConstraints(CPUSimulationObject& object);
+
+    // Whether to accumulate constraint errors into CPUSimulationBuffers::residuals as the frame is simulated. Costs an extra pass over the voxels,
+    // face constraints, and collisions per substep.
+    static void setMeasureResiduals(bool measureResiduals) { CPUSolver::measureResiduals = measureResiduals; }
+
+    // Lets VGS solves stop iterating early, once no particle moves more than this fraction of the particle diameter in an iteration (0 disables).
+    // vgsIterations becomes a maximum, rather than a fixed count.
+    static void setConvergenceTolerance(float convergenceTolerance) { CPUSolver::convergenceTolerance = convergenceTolerance; }
+
+    // Whether the long-range and face constraint passes are solved Jacobi-style: every level / axis against the same positions, with corrections
+    // stored per particle and averaged afterwards, rather than Gauss-Seidel-style, one level / axis after another, in place. Order independent,
+    // so it needs no coloring, but it propagates corrections more slowly per substep.
+    static void setJacobiConstraints(bool jacobiConstraints) { CPUSolver::jacobiConstraints = jacobiConstraints; }
+
+    // Picks a substep count for the coming frame, within [minSubsteps, maxSubsteps]: enough that no particle moves more than half its radius
+    // per substep (at its current speed), and more still as face constraints get close to breaking (going by the last frame's peak strain).
+    // Expects the buffers as they were left by the last frame, i.e. previous positions one nominal substep back.
+    static int chooseSubsteps(const CPUSimulationBuffers& buffers, int nominalSubsteps, int minSubsteps, int maxSubsteps);
+
+    // Re-spaces previous positions so that the implied velocities stay the same when the substep length changes by the given factor.
+    static void rescaleVelocities(CPUSimulationBuffers& buffers, float factor);
+
+    // Fills in the buffers' inverse mass and radius streams from the particles. Call once the particles are downloaded, before any other pass.
+    static void unpackParticleAttributes(CPUSimulationBuffers& buffers);
+
+    // Particle speed below which a piece counts as at rest (0 disables sleeping).
+    static void setSleepThreshold(float sleepThreshold) { CPUSolver::sleepThreshold = sleepThreshold; }
+
+    // Puts pieces that have been at rest for a while to sleep, and wakes sleeping pieces that were moved (by a collision, say) or dragged.
+    // Sleeping voxels are left out of every pass except particle collisions, where they only act as obstacles for awake particles.
+    // Call at the start of each frame, before simulating the object, after updateIslands.
+    static void updateSleepingIslands(CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+
+    // Gathers the awake voxels of all objects, for the collision passes. Call once per frame, after every object's updateSleepingIslands.
+    static void updateAwakeVoxels(CPUSimulationBuffers& buffers);
+
+    // Face constraint strain below which an intact piece is simulated as a single rigid body (0 disables rigid clusters).
+    static void setRigidStrainThreshold(float rigidStrainThreshold) { CPUSolver::rigidStrainThreshold = rigidStrainThreshold; }
+
+    // Turns pieces whose face constraints have all been well below the threshold for a few frames into rigid clusters: from then on, each substep
+    // shape-matches the whole piece instead of running the per-voxel passes on it. It drops back to per-voxel simulation as soon as its particles are
+    // pushed (by a collision, say) further out of shape than the threshold allows, so that it can deform and break again.
+    // Call at the start of each frame, after updateSleepingIslands.
+    static void updateRigidClusters(CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+
+private:
+    struct ParallelForTaskData {
+        const std::function<void(int, int)>* body;
+        int count;
+        int grainSize;
+    };
+
+    struct ParallelForThreadData {
+        const ParallelForTaskData* taskData;
+        int begin;
+        int end;
+    };
+
+    static void createParallelForTasks(void* data, MThreadRootTask* rootTask);
+    static MThreadRetVal runParallelForRange(void* data);
+
+    static void preVGS(CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+    static void solveRigidClusters(CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+    static void solveVoxels(CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+    static void solveLongRangeConstraints(CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+    static void solveLongRangeConstraintLevel(CPUSimulationObject& object, CPUSimulationBuffers& buffers, int level, const VGSConstants& vgsConstants);
+    static uint solveFaceConstraints(CPUSimulationObject& object, CPUSimulationBuffers& buffers, int axis);
+    static void applyJacobiCorrections(CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+    static void accumulateResiduals(const CPUSimulationObject& object, CPUSimulationBuffers& buffers);
+    static void compactFlatFaceConstraints(FlatFaceConstraints& flatConstraints);
+    static void updateAwakeLists(CPUSimulationObject& object, const CPUSimulationBuffers& buffers);
+    static void updateAwakeFaceConstraints(CPUSimulationObject& object, const CPUSimulationBuffers& buffers, int axis);
+
+    // The items a pass goes over: all numItems of them, or only those in the awake list while part of the object sleeps.
+    struct PassItems {
+        const std::vector<uint>* awake;
+        int count;
+
+        int operator[](int i) const {
+            return awake ? static_cast<int>((*awake)[i]) : i;
+        }
+    };
+
+    static PassItems passItems(const CPUSimulationObject& object, const std::vector<uint>& awake, uint numItems) {
+        if (!object.hasSleepingVoxels) return { nullptr, static_cast<int>(numItems) };
+        return { &awake, static_cast<int>(awake.size()) };
+    }
+
+    // Compliance is normalized by the substep length (see PBD::updateSimulationParameters, where simParams.secondsPerFrame is really the nominal
+    // substep dt): the shaders get compliance / dt. With adaptive substepping the actual dt is dt * timeStepScale, so dividing by timeStepScale gives
+    // exactly compliance / actual dt, i.e. what the shaders would get at that substep count. The scaling is linear rather than quadratic (as in
+    // XPBD's compliance / dt^2) because that is the form the shaders use - scaling by timeStepScale^2 would make the CPU backend stiffer or softer
+    // than the GPU one at the same substep count.
+    static VGSConstants scaledForTimeStep(VGSConstants vgsConstants, const CPUSimulationBuffers& buffers) {
+        vgsConstants.compliance /= buffers.timeStepScale;
+        return vgsConstants;
+    }
+
+    static float convergedCorrectionSq(const VGSConstants& vgsConstants) {
+        float convergedCorrection = convergenceTolerance * 2.0f * vgsConstants.particleRadius;
+        return convergedCorrection * convergedCorrection;
+    }
+
+    inline static bool deterministic = false;
+    inline static bool flatFaceConstraints = true;
+    inline static constexpr uint flatCompactionDivisor = 16; // Compact once this fraction (1 / n) of the flattened constraints are broken
+    inline static bool measureResiduals = false;
+    inline static float convergenceTolerance = 0.0f;
+    inline static bool jacobiConstraints = false;
+    inline static float sleepThreshold = 0.0f;
+    inline static constexpr uint framesBeforeSleep = 10;
+    inline static float rigidStrainThreshold = 0.0f;
+    inline static constexpr uint framesBeforeRigid = 5;
+
+    inline static constexpr int particlesPerTask = 4096;
+    inline static constexpr int constraintsPerTask = 512;
+    inline static constexpr int collisionCellsPerTask = 2048;
+
+    // Same particle indices (within a voxel) as in FaceConstraintsCompute; see cube.h for the corner ordering.
+    inline static constexpr uint faceAParticles[3][4] = { {1, 3, 5, 7}, {2, 3, 6, 7}, {4, 5, 6, 7} };
+    inline static constexpr uint faceBParticles[3][4] = { {0, 2, 4, 6}, {0, 1, 4, 5}, {0, 1, 2, 3} };
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <maya/MFloatVector.h>
+#include <cmath>
+
+/**
+ * Rigid shape matching (Müller et al. 2005): the rotation and translation that best fit a set of particles to their rest shape.
+ * Used by the CPU backend to simulate intact pieces as single rigid bodies (see CPUSolver::solveRigidClusters).
+ */
+namespace ShapeMatching {
+
+struct Quaternion {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 1.0f;
+
+    MFloatVector rotate(const MFloatVector& v) const {
+        // v + 2w(u x v) + 2u x (u x v), with u the vector part
+        MFloatVector u(x, y, z);
+        MFloatVector t = 2.0f * (u ^ v);
+        return v + w * t + (u ^ t);
+    }
+
+    Quaternion operator*(const Quaternion& o) const {
+        return {
+            w * o.x + x * o.w + y * o.z - z * o.y,
+            w * o.y - x * o.z + y * o.w + z * o.x,
+            w * o.z + x * o.y - y * o.x + z * o.w,
+            w * o.w - x * o.x - y * o.y - z * o.z
+        };
+    }
+
+    void normalize() {
+        float length = std::sqrt(x * x + y * y + z * z + w * w);
+        x /= length;
+        y /= length;
+        z /= length;
+        w /= length;
+    }
+};
+
+/**
+ * Extracts the rotation part of the 3x3 matrix with the given columns (Müller et al. 2016, "A Robust Method to Extract the Rotational
+ * Part of Deformations"). The rotation is refined in place, so warm starting it with the previous substep's result takes only an iteration or two.
+ */
+inline void extractRotation(const MFloatVector columns[3], Quaternion& rotation, int maxIterations = 8) {
+    for (int iter = 0; iter < maxIterations; ++iter) {
+        MFloatVector r0 = rotation.rotate(MFloatVector::xAxis);
+        MFloatVector r1 = rotation.rotate(MFloatVector::yAxis);
+        MFloatVector r2 = rotation.rotate(MFloatVector::zAxis);
+
+        MFloatVector omega = ((r0 ^ columns[0]) + (r1 ^ columns[1]) + (r2 ^ columns[2]))
+                           / (std::abs(r0 * columns[0] + r1 * columns[1] + r2 * columns[2]) + 1e-9f);
+        float angle = omega.length();
+        if (angle < 1e-9f) break;
+
+        MFloatVector axis = omega / angle;
+        float s = std::sin(0.5f * angle);
+        rotation = Quaternion{ axis.x * s, axis.y * s, axis.z * s, std::cos(0.5f * angle) } * rotation;
+        rotation.normalize();
+    }
+}
+
+} // namespace ShapeMatching
@@ -0,0 +1,285 @@
+#pragma once
+
+#include "vgscore.h"
+#include "vgssimd.h"
+#include "cpusolver.h"
+#include <maya/MFloatVector.h>
+#include <maya/MMatrix.h>
+#include <maya/MVector.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Host-side version of shaders/deformvertices.hlsl: moves each vertex (and its normal) with the trilinear interpolation of its voxel's 8 particles.
+ * Used to deform the mesh for export without reading the GPU vertex buffers back. Same math as the shader, in the same order, so the two agree
+ * to within floating point tolerance; any change to one should be mirrored in the other.
+ *
+ * Also builds the per-vertex bindings both versions read: where each vertex sits in its voxel's rest frame, which never changes,
+ * so it's computed once rather than from the rest positions every frame.
+ */
+namespace VertexDeform {
+
+inline uint32_t quantizeBindingCoord(float coord) {
+    float t = std::clamp((coord - VERTEX_BINDING_COORD_MIN) / VERTEX_BINDING_COORD_RANGE, 0.0f, 1.0f);
+    return static_cast<uint32_t>(std::lround(t * 65535.0f));
+}
+
+inline float decodeBindingCoord(uint32_t quantized) {
+    return VERTEX_BINDING_COORD_MIN + static_cast<float>(quantized & 0xFFFFu) * (VERTEX_BINDING_COORD_RANGE / 65535.0f);
+}
+
+inline uint32_t encodeOctahedral(const MFloatVector& normal) {
+    float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (sum <= 0.0f) return 0; // Decodes to +z; degenerate normals have no meaningful direction anyway
+
+    float x = normal.x / sum;
+    float y = normal.y / sum;
+    if (normal.z < 0.0f) {
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    auto toSnorm16 = [](float value) {
+        return static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f))));
+    };
+    return toSnorm16(x) | (toSnorm16(y) << 16);
+}
+
+inline MFloatVector decodeOctahedral(uint32_t packed) {
+    float ex = static_cast<float>(static_cast<int16_t>(packed & 0xFFFFu)) / 32767.0f;
+    float ey = static_cast<float>(static_cast<int16_t>(packed >> 16)) / 32767.0f;
+    MFloatVector n(ex, ey, 1.0f - std::abs(ex) - std::abs(ey));
+    float t = std::clamp(-n.z, 0.0f, 1.0f);
+    n.x += (n.x >= 0.0f) ? -t : t;
+    n.y += (n.y >= 0.0f) ? -t : t;
+    return n.normal();
+}
+
+/**
+ * restPosition and restNormal are in world space; voxelReferenceParticle is the voxel's first particle at rest.
+ * The voxel's rest frame may be rotated if the voxel grid is, hence gridRotationInverse.
+ */
+inline VertexBinding bindVertex(
+    uint voxelId,
+    const MFloatVector& restPosition,
+    const MFloatVector& restNormal,
+    const Particle& voxelReferenceParticle,
+    const MMatrix& gridRotationInverse
+) {
+    VertexBinding binding{ voxelId, 0, 0, 0 };
+    if (voxelId == UINT_MAX) return binding;
+
+    float r = VGSCore::particleRadius(voxelReferenceParticle);
+    MFloatVector voxelMin = VGSCore::position(voxelReferenceParticle) - MFloatVector(r, r, r);
+    MVector restLocal = MVector(restPosition - voxelMin) * gridRotationInverse;
+    MVector uvw = restLocal / (4.0 * r);
+
+    binding.uv = quantizeBindingCoord(static_cast<float>(uvw.x)) | (quantizeBindingCoord(static_cast<float>(uvw.y)) << 16);
+    binding.w = quantizeBindingCoord(static_cast<float>(uvw.z));
+    binding.restNormal = encodeOctahedral(MFloatVector(MVector(restNormal) * gridRotationInverse));
+    return binding;
+}
+
+// Vertices not bound to any voxel (or to one past the end of particles) come out at the origin, with a zero normal.
+inline void deformVertex(const VertexBinding& binding, const std::vector<Particle>& particles, float* outPosition, float* outNormal) {
+    size_t particleStartIdx = static_cast<size_t>(binding.voxelId) << 3;
+    if (binding.voxelId == UINT_MAX || particleStartIdx + 8 > particles.size()) {
+        std::fill(outPosition, outPosition + 3, 0.0f);
+        std::fill(outNormal, outNormal + 3, 0.0f);
+        return;
+    }
+
+    MFloatVector v[8];
+    for (int i = 0; i < 8; ++i) {
+        v[i] = VGSCore::position(particles[particleStartIdx + i]);
+    }
+
+    float u = decodeBindingCoord(binding.uv);
+    float vv = decodeBindingCoord(binding.uv >> 16);
+    float w = decodeBindingCoord(binding.w);
+
+    MFloatVector deformedPos =
+        v[0] * ((1 - u) * (1 - vv) * (1 - w)) +
+        v[1] * (u * (1 - vv) * (1 - w)) +
+        v[2] * ((1 - u) * vv * (1 - w)) +
+        v[3] * (u * vv * (1 - w)) +
+        v[4] * ((1 - u) * (1 - vv) * w) +
+        v[5] * (u * (1 - vv) * w) +
+        v[6] * ((1 - u) * vv * w) +
+        v[7] * (u * vv * w);
+
+    MFloatVector dP_du = (v[1] - v[0]) * ((1 - vv) * (1 - w)) + (v[3] - v[2]) * (vv * (1 - w)) + (v[5] - v[4]) * ((1 - vv) * w) + (v[7] - v[6]) * (vv * w);
+    MFloatVector dP_dv = (v[2] - v[0]) * ((1 - u) * (1 - w)) + (v[3] - v[1]) * (u * (1 - w)) + (v[6] - v[4]) * ((1 - u) * w) + (v[7] - v[5]) * (u * w);
+    MFloatVector dP_dw = (v[4] - v[0]) * ((1 - u) * (1 - vv)) + (v[5] - v[1]) * (u * (1 - vv)) + (v[6] - v[2]) * ((1 - u) * vv) + (v[7] - v[3]) * (u * vv);
+
+    // Inverse-transpose of the Jacobian (rows dP_du, dP_dv, dP_dw) applied to the rest normal: the columns of the transpose are the cofactors.
+    MFloatVector normal = decodeOctahedral(binding.restNormal);
+    MFloatVector c0 = dP_dv ^ dP_dw;
+    MFloatVector c1 = dP_dw ^ dP_du;
+    MFloatVector c2 = dP_du ^ dP_dv;
+    float det = dP_du * c0;
+    if (std::abs(det) >= 1e-8f) {
+        float invDet = 1.0f / det;
+        normal = (c0 * invDet) * normal.x + (c1 * invDet) * normal.y + (c2 * invDet) * normal.z;
+    }
+    normal.normalize();
+
+    outPosition[0] = deformedPos.x; outPosition[1] = deformedPos.y; outPosition[2] = deformedPos.z;
+    outNormal[0] = normal.x; outNormal[1] = normal.y; outNormal[2] = normal.z;
+}
+
+namespace detail {
+
+using VGSSimd::detail::Vec3;
+using VGSSimd::detail::add;
+using VGSSimd::detail::sub;
+using VGSSimd::detail::mul;
+using VGSSimd::detail::dot;
+using VGSSimd::detail::cross;
+using VGSSimd::detail::select;
+using VGSSimd::detail::normalOrZero;
+
+inline __m256 decodeBindingCoords(__m256i quantized) {
+    __m256 q = _mm256_cvtepi32_ps(_mm256_and_si256(quantized, _mm256_set1_epi32(0xFFFF)));
+    return _mm256_add_ps(_mm256_set1_ps(VERTEX_BINDING_COORD_MIN), _mm256_mul_ps(q, _mm256_set1_ps(VERTEX_BINDING_COORD_RANGE / 65535.0f)));
+}
+
+inline Vec3 decodeOctahedral(__m256i packed) {
+    const __m256 scale = _mm256_set1_ps(1.0f / 32767.0f);
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 ex = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(packed, 16), 16)), scale);
+    __m256 ey = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(packed, 16)), scale);
+    __m256 absX = _mm256_andnot_ps(signBit, ex);
+    __m256 absY = _mm256_andnot_ps(signBit, ey);
+    __m256 nz = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), absX), absY);
+    __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_xor_ps(nz, signBit), zero), _mm256_set1_ps(1.0f));
+    __m256 negT = _mm256_xor_ps(t, signBit);
+    ex = _mm256_add_ps(ex, _mm256_blendv_ps(t, negT, _mm256_cmp_ps(ex, zero, _CMP_GE_OQ)));
+    ey = _mm256_add_ps(ey, _mm256_blendv_ps(t, negT, _mm256_cmp_ps(ey, zero, _CMP_GE_OQ)));
+    return normalOrZero({ ex, ey, nz });
+}
+
+// Positions of one corner of each lane's voxel. particleFloats is the particle buffer as floats (4 per particle).
+inline Vec3 gatherCorner(const float* particleFloats, __m256i voxelFloatOffsets, int corner) {
+    __m256i offsets = _mm256_add_epi32(voxelFloatOffsets, _mm256_set1_epi32(corner * 4));
+    return {
+        _mm256_i32gather_ps(particleFloats, offsets, 4),
+        _mm256_i32gather_ps(particleFloats + 1, offsets, 4),
+        _mm256_i32gather_ps(particleFloats + 2, offsets, 4)
+    };
+}
+
+// 8 consecutive vertices, with the same operation order as deformVertex.
+inline void deformBatch(const VertexBinding* bindings, const std::vector<Particle>& particles, float* outPositions, float* outNormals) {
+    alignas(32) uint32_t voxelIds[VGSSimd::laneCount], uv[VGSSimd::laneCount], w[VGSSimd::laneCount], restNormals[VGSSimd::laneCount];
+    alignas(32) uint32_t valid[VGSSimd::laneCount];
+    const size_t numVoxels = particles.size() / 8;
+    for (int lane = 0; lane < VGSSimd::laneCount; ++lane) {
+        const VertexBinding& binding = bindings[lane];
+        bool isValid = binding.voxelId < numVoxels;
+        voxelIds[lane] = isValid ? binding.voxelId : 0; // Gather from a valid address; the result is zeroed below
+        valid[lane] = isValid ? 0xFFFFFFFFu : 0u;
+        uv[lane] = binding.uv;
+        w[lane] = binding.w;
+        restNormals[lane] = binding.restNormal;
+    }
+
+    const float* particleFloats = reinterpret_cast<const float*>(particles.data());
+    __m256i voxelFloatOffsets = _mm256_slli_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(voxelIds)), 5); // 8 particles * 4 floats
+    Vec3 v[8];
+    for (int i = 0; i < 8; ++i) {
+        v[i] = gatherCorner(particleFloats, voxelFloatOffsets, i);
+    }
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256i uvBits = _mm256_load_si256(reinterpret_cast<const __m256i*>(uv));
+    __m256 u = decodeBindingCoords(uvBits);
+    __m256 vv = decodeBindingCoords(_mm256_srli_epi32(uvBits, 16));
+    __m256 ww = decodeBindingCoords(_mm256_load_si256(reinterpret_cast<const __m256i*>(w)));
+    __m256 iu = _mm256_sub_ps(one, u);
+    __m256 iv = _mm256_sub_ps(one, vv);
+    __m256 iw = _mm256_sub_ps(one, ww);
+
+    Vec3 deformedPos = mul(v[0], _mm256_mul_ps(_mm256_mul_ps(iu, iv), iw));
+    deformedPos = add(deformedPos, mul(v[1], _mm256_mul_ps(_mm256_mul_ps(u, iv), iw)));
+    deformedPos = add(deformedPos, mul(v[2], _mm256_mul_ps(_mm256_mul_ps(iu, vv), iw)));
+    deformedPos = add(deformedPos, mul(v[3], _mm256_mul_ps(_mm256_mul_ps(u, vv), iw)));
+    deformedPos = add(deformedPos, mul(v[4], _mm256_mul_ps(_mm256_mul_ps(iu, iv), ww)));
+    deformedPos = add(deformedPos, mul(v[5], _mm256_mul_ps(_mm256_mul_ps(u, iv), ww)));
+    deformedPos = add(deformedPos, mul(v[6], _mm256_mul_ps(_mm256_mul_ps(iu, vv), ww)));
+    deformedPos = add(deformedPos, mul(v[7], _mm256_mul_ps(_mm256_mul_ps(u, vv), ww)));
+
+    auto weightedEdges = [](const Vec3 edges[4], __m256 weights[4]) {
+        Vec3 sum = mul(edges[0], weights[0]);
+        for (int i = 1; i < 4; ++i) {
+            sum = add(sum, mul(edges[i], weights[i]));
+        }
+        return sum;
+    };
+
+    Vec3 uEdges[4] = { sub(v[1], v[0]), sub(v[3], v[2]), sub(v[5], v[4]), sub(v[7], v[6]) };
+    __m256 uWeights[4] = { _mm256_mul_ps(iv, iw), _mm256_mul_ps(vv, iw), _mm256_mul_ps(iv, ww), _mm256_mul_ps(vv, ww) };
+    Vec3 vEdges[4] = { sub(v[2], v[0]), sub(v[3], v[1]), sub(v[6], v[4]), sub(v[7], v[5]) };
+    __m256 vWeights[4] = { _mm256_mul_ps(iu, iw), _mm256_mul_ps(u, iw), _mm256_mul_ps(iu, ww), _mm256_mul_ps(u, ww) };
+    Vec3 wEdges[4] = { sub(v[4], v[0]), sub(v[5], v[1]), sub(v[6], v[2]), sub(v[7], v[3]) };
+    __m256 wWeights[4] = { _mm256_mul_ps(iu, iv), _mm256_mul_ps(u, iv), _mm256_mul_ps(iu, vv), _mm256_mul_ps(u, vv) };
+    Vec3 dP_du = weightedEdges(uEdges, uWeights);
+    Vec3 dP_dv = weightedEdges(vEdges, vWeights);
+    Vec3 dP_dw = weightedEdges(wEdges, wWeights);
+
+    Vec3 restNormal = decodeOctahedral(_mm256_load_si256(reinterpret_cast<const __m256i*>(restNormals)));
+    Vec3 c0 = cross(dP_dv, dP_dw);
+    Vec3 c1 = cross(dP_dw, dP_du);
+    Vec3 c2 = cross(dP_du, dP_dv);
+    __m256 det = dot(dP_du, c0);
+    __m256 invDet = _mm256_div_ps(one, det);
+    Vec3 deformedNormal = add(add(mul(mul(c0, invDet), restNormal.x), mul(mul(c1, invDet), restNormal.y)), mul(mul(c2, invDet), restNormal.z));
+    __m256 degenerate = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), det), _mm256_set1_ps(1e-8f), _CMP_LT_OQ);
+    Vec3 normal = normalOrZero(select(deformedNormal, restNormal, degenerate));
+
+    __m256 validMask = _mm256_castsi256_ps(_mm256_load_si256(reinterpret_cast<const __m256i*>(valid)));
+    const Vec3 zero = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+    deformedPos = select(zero, deformedPos, validMask);
+    normal = select(zero, normal, validMask);
+
+    alignas(32) float px[VGSSimd::laneCount], py[VGSSimd::laneCount], pz[VGSSimd::laneCount];
+    alignas(32) float nx[VGSSimd::laneCount], ny[VGSSimd::laneCount], nz[VGSSimd::laneCount];
+    _mm256_store_ps(px, deformedPos.x); _mm256_store_ps(py, deformedPos.y); _mm256_store_ps(pz, deformedPos.z);
+    _mm256_store_ps(nx, normal.x); _mm256_store_ps(ny, normal.y); _mm256_store_ps(nz, normal.z);
+    for (int lane = 0; lane < VGSSimd::laneCount; ++lane) {
+        outPositions[lane * 3] = px[lane]; outPositions[lane * 3 + 1] = py[lane]; outPositions[lane * 3 + 2] = pz[lane];
+        outNormals[lane * 3] = nx[lane]; outNormals[lane * 3 + 1] = ny[lane]; outNormals[lane * 3 + 2] = nz[lane];
+    }
+}
+
+} // namespace detail
+
+/**
+ * Deforms every bound vertex, writing 3 floats per vertex to outPositions and outNormals (the same layout as the GPU vertex buffers).
+ * Uses AVX2 (8 vertices at a time) when supported, otherwise the scalar version, and splits the vertices across Maya's thread pool.
+ * Caller is responsible for holding a reference to the thread pool (MThreadPool::init / release) around calls.
+ */
+inline void deform(const std::vector<VertexBinding>& bindings, const std::vector<Particle>& particles, float* outPositions, float* outNormals) {
+    constexpr int verticesPerTask = 16384;
+    const bool useSimd = VGSSimd::isSupported();
+    CPUSolver::parallelFor(static_cast<int>(bindings.size()), verticesPerTask, [&](int begin, int end) {
+        int i = begin;
+        if (useSimd) {
+            for (; i + VGSSimd::laneCount <= end; i += VGSSimd::laneCount) {
+                detail::deformBatch(&bindings[i], particles, outPositions + i * 3, outNormals + i * 3);
+            }
+        }
+        for (; i < end; ++i) {
+            deformVertex(bindings[i], particles, outPositions + i * 3, outNormals + i * 3);
+        }
+    });
+}
+
+} // namespace VertexDeform
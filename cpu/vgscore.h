@@ -0,0 +1,215 @@
+#pragma once
+
+#include "shaders/constants.hlsli"
+#include "utils.h"
+#include <maya/MFloatVector.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+/**
+ * Host-side port of shaders/common.hlsl and shaders/vgs_core.hlsl, used by the CPU simulation backend.
+ * The operations are kept in the same order as the HLSL so that both backends agree to within floating point tolerance;
+ * any change to the shader versions should be mirrored here.
+ */
+namespace VGSCore {
+
+inline constexpr float eps = 1e-8f;
+inline constexpr float oneThird = 1.0f / 3.0f;
+
+inline float particleRadius(const Particle& particle) {
+    return Utils::halfToFloat(static_cast<uint16_t>(particle.radiusAndInvMass & 0xFFFF));
+}
+
+inline float particleInverseMass(const Particle& particle) {
+    return Utils::halfToFloat(static_cast<uint16_t>(particle.radiusAndInvMass >> 16));
+}
+
+inline bool massIsInfinite(const Particle& particle) {
+    return particleInverseMass(particle) == 0.0f;
+}
+
+inline MFloatVector position(const Particle& particle) {
+    return MFloatVector(particle.x, particle.y, particle.z);
+}
+
+inline void setPosition(Particle& particle, const MFloatVector& newPosition) {
+    particle.x = newPosition.x;
+    particle.y = newPosition.y;
+    particle.z = newPosition.z;
+}
+
+inline MFloatVector lerp(const MFloatVector& a, const MFloatVector& b, float t) {
+    return a + (b - a) * t;
+}
+
+inline MFloatVector safeProject(const MFloatVector& v, const MFloatVector& onto) {
+    float denom = onto * onto;
+    if (denom < eps) return MFloatVector::zero;
+    return onto * ((v * onto) / denom);
+}
+
+// Normalizes u0 but, if its length is 0, instead returns the normalized
+// cross product of u1 and u2. This only works if both u1 and u2 are non-zero.
+inline MFloatVector safeNormal(const MFloatVector& u0, const MFloatVector& u1, const MFloatVector& u2) {
+    float len = u0.length();
+    if (len < eps) {
+        return (u1 ^ u2).normal();
+    }
+
+    return u0 / len;
+}
+
+inline float safeLength(const MFloatVector& v) {
+    float len = v.length();
+    if (len < eps) return eps;
+    return len;
+}
+
+// Chebyshev semi-iterative weights (Wang 2015, "A Chebyshev Semi-Iterative Approach for Accelerating Projective and Position-based Dynamics"):
+// 1 for the first iteration, then increasing towards 2 / (1 + sqrt(1 - rho^2)). Each iteration's result is extrapolated from the one before last
+// by this weight. previousOmega is the weight of the iteration before.
+inline float chebyshevOmega(uint iter, float rhoSq, float previousOmega) {
+    if (iter == 0) return 1.0f;
+    if (iter == 1) return 2.0f / (2.0f - rhoSq);
+    return 4.0f / (4.0f - rhoSq * previousOmega);
+}
+
+// If convergedCorrectionSq is positive, stops iterating once no particle moves further than its square root in an iteration.
+inline void doVGSIterations(
+    Particle particles[8],
+    const VGSConstants& vgsConstants,
+    bool bailOnInverted,
+    float convergedCorrectionSq = 0.0f
+) {
+    const float relaxation = vgsConstants.relaxation;
+    const float edgeUniformity = vgsConstants.edgeUniformity;
+    const float voxelRestVolume = vgsConstants.voxelRestVolume;
+    const float particleRadius = vgsConstants.particleRadius;
+
+    // Unpack once up front - the masses don't change over the iterations.
+    float lerpWeights[8];
+    float maxInvMass = 0.0f;
+    for (int i = 0; i < 8; ++i) {
+        lerpWeights[i] = particleInverseMass(particles[i]);
+        maxInvMass = std::max(maxInvMass, lerpWeights[i]);
+    }
+    const float massNormalization = 1.0f / (std::max(maxInvMass, eps) + vgsConstants.compliance);
+    for (int i = 0; i < 8; ++i) {
+        lerpWeights[i] *= massNormalization;
+    }
+
+    MFloatVector p[8];
+    for (int i = 0; i < 8; ++i) {
+        p[i] = position(particles[i]);
+    }
+
+    // Chebyshev acceleration, if enabled: drops back to plain projection for the rest of the solve as soon as a plain step
+    // comes out longer than the one before it (i.e. rho was overestimated for this group, and extrapolating would diverge).
+    bool accelerate = (vgsConstants.chebyshevRho > 0.0f);
+    const float rhoSq = vgsConstants.chebyshevRho * vgsConstants.chebyshevRho;
+    float omega = 1.0f;
+    float lastStepSq = FLT_MAX;
+    MFloatVector older[8]; // Positions as of the iteration before last
+
+    for (uint iter = 0; iter < vgsConstants.iterCount; ++iter)
+    {
+        // Calculate basis vectors (average of edges for each axis)
+        MFloatVector v0 = 0.25f * ((p[1] - p[0]) + (p[3] - p[2]) + (p[5] - p[4]) + (p[7] - p[6]));
+        MFloatVector v1 = 0.25f * ((p[2] - p[0]) + (p[3] - p[1]) + (p[6] - p[4]) + (p[7] - p[5]));
+        MFloatVector v2 = 0.25f * ((p[4] - p[0]) + (p[5] - p[1]) + (p[6] - p[2]) + (p[7] - p[3]));
+        if (((v0 ^ v1) * v2) == 0.0f) {
+            v2 = (v0 ^ v1).normal() * particleRadius;
+        }
+
+        // Apply relaxed Gram-Schmidt orthonormalization
+        MFloatVector u0 = v0 - relaxation * (safeProject(v0, v1) + safeProject(v0, v2));
+        MFloatVector u1 = v1 - relaxation * (safeProject(v1, v0) + safeProject(v1, v2));
+        MFloatVector u2 = v2 - relaxation * (safeProject(v2, v0) + safeProject(v2, v1));
+
+        // Normalize and scale
+        u0 = safeNormal(u0, u1, u2) * (edgeUniformity * particleRadius + ((1.0f - edgeUniformity) * safeLength(v0) * 0.5f));
+        u1 = safeNormal(u1, u2, u0) * (edgeUniformity * particleRadius + ((1.0f - edgeUniformity) * safeLength(v1) * 0.5f));
+        u2 = safeNormal(u2, u0, u1) * (edgeUniformity * particleRadius + ((1.0f - edgeUniformity) * safeLength(v2) * 0.5f));
+
+        // Check for flipping
+        float volume = (u0 ^ u1) * u2;
+        if (volume < 0.0f) {
+            if (bailOnInverted) break;
+            volume = -volume;
+
+            // Flip the shortest edge (ties resolved in the same order as the shader's step() masks)
+            float len0sq = u0 * u0;
+            float len1sq = u1 * u1;
+            float len2sq = u2 * u2;
+            if (len0sq <= len1sq && len0sq <= len2sq) {
+                u0 = -u0;
+            } else if (len1sq <= len0sq && len1sq <= len2sq) {
+                u1 = -u1;
+            } else {
+                u2 = -u2;
+            }
+        }
+
+        // Bail if volume is too small (voxel is degenerate, there's no way to know how to restore it.
+        // Other constraints may restore it later).
+        if (volume < eps) break;
+
+        // Volume preservation
+        float mult = 0.5f * std::pow(std::abs(voxelRestVolume / volume), oneThird);
+        u0 *= mult;
+        u1 *= mult;
+        u2 *= mult;
+
+        MFloatVector center = 0.125f * (p[0] + p[1] + p[2] + p[3] + p[4] + p[5] + p[6] + p[7]);
+
+        MFloatVector previous[8];
+        if (convergedCorrectionSq > 0.0f || accelerate) {
+            std::copy(p, p + 8, previous);
+        }
+
+        // Lerp between current positions and goal positions weighted by inverse mass (relative to max inverse mass)
+        p[0] = lerp(p[0], center - u0 - u1 - u2, lerpWeights[0]);
+        p[1] = lerp(p[1], center + u0 - u1 - u2, lerpWeights[1]);
+        p[2] = lerp(p[2], center - u0 + u1 - u2, lerpWeights[2]);
+        p[3] = lerp(p[3], center + u0 + u1 - u2, lerpWeights[3]);
+        p[4] = lerp(p[4], center - u0 - u1 + u2, lerpWeights[4]);
+        p[5] = lerp(p[5], center + u0 - u1 + u2, lerpWeights[5]);
+        p[6] = lerp(p[6], center - u0 + u1 + u2, lerpWeights[6]);
+        p[7] = lerp(p[7], center + u0 + u1 + u2, lerpWeights[7]);
+
+        if (accelerate) {
+            omega = chebyshevOmega(iter, rhoSq, omega);
+
+            float stepSq = 0.0f;
+            for (int i = 0; i < 8; ++i) {
+                MFloatVector step = p[i] - previous[i];
+                stepSq = std::max(stepSq, step * step);
+            }
+            if (stepSq > lastStepSq) accelerate = false;
+            lastStepSq = stepSq;
+
+            if (accelerate && omega != 1.0f) {
+                for (int i = 0; i < 8; ++i) {
+                    p[i] = older[i] + (p[i] - older[i]) * omega;
+                }
+            }
+            std::copy(previous, previous + 8, older);
+        }
+
+        if (convergedCorrectionSq > 0.0f) {
+            float maxCorrectionSq = 0.0f;
+            for (int i = 0; i < 8; ++i) {
+                MFloatVector correction = p[i] - previous[i];
+                maxCorrectionSq = std::max(maxCorrectionSq, correction * correction);
+            }
+            if (maxCorrectionSq < convergedCorrectionSq) break;
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        setPosition(particles[i], p[i]);
+    }
+}
+
+} // namespace VGSCore
@@ -0,0 +1,442 @@
+#pragma once
+
+#include "vgscore.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <intrin.h>
+
+// The AVX2 kernels here (and in vertexdeform.h) rely on MSVC letting intrinsics be used without enabling the instruction set for the whole
+// translation unit, so they can be picked at runtime (see isSupported). Other compilers would need per-function target attributes; the plugin
+// only builds with MSVC, so those aren't provided.
+#ifndef _MSC_VER
+#error "cpu/vgssimd.h requires MSVC"
+#endif
+
+/**
+ * AVX2 version of VGSCore::doVGSIterations that solves 8 independent particle groups (voxels, face constraint pairs, or long-range blocks) at once.
+ * Groups are laid out structure-of-arrays - one SIMD lane per group, one register per corner and component - so every lane runs the exact same
+ * instruction stream as the scalar reference. The early-outs of the scalar version become a per-lane active mask; the batch only stops
+ * iterating once every lane has bailed.
+ *
+ * Results agree with VGSCore::doVGSIterations to within floating point tolerance (the cube root is computed with Newton iterations rather than pow),
+ * see maxDeviationFromScalar.
+ */
+namespace VGSSimd {
+
+inline constexpr int laneCount = 8;
+
+// True if both the CPU and the OS support AVX2 (the OS has to save the upper halves of the YMM registers on context switches).
+inline bool isSupported() {
+    static const bool supported = []() {
+        int cpuInfo[4];
+        __cpuid(cpuInfo, 0);
+        if (cpuInfo[0] < 7) return false;
+
+        __cpuid(cpuInfo, 1);
+        bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+        bool avx = (cpuInfo[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx) return false;
+        if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+        __cpuidex(cpuInfo, 7, 0);
+        return (cpuInfo[1] & (1 << 5)) != 0;
+    }();
+    return supported;
+}
+
+/**
+ * 8 particle groups in SoA form. Fill lanes with load(), run doVGSIterations, then read the results back with store().
+ * Lanes that aren't loaded are inactive and left untouched by the kernel.
+ */
+struct VoxelBatch {
+    alignas(32) float x[8][laneCount];           // [corner][lane]
+    alignas(32) float y[8][laneCount];
+    alignas(32) float z[8][laneCount];
+    alignas(32) float lerpWeights[8][laneCount];
+    alignas(32) uint activeLanes[laneCount];
+
+    VoxelBatch() {
+        clear();
+    }
+
+    // Deactivates every lane (and zeroes them, so unused lanes don't compute on uninitialized memory).
+    void clear() {
+        std::memset(this, 0, sizeof(VoxelBatch));
+    }
+
+    // Copies a group's positions into a lane and precomputes its lerp weights (the same normalization as the scalar version).
+    void load(int lane, const Particle particles[8], float compliance) {
+        float inverseMasses[8];
+        for (int i = 0; i < 8; ++i) {
+            inverseMasses[i] = VGSCore::particleInverseMass(particles[i]);
+        }
+        load(lane, particles, inverseMasses, compliance);
+    }
+
+    // Same, with the group's inverse masses already unpacked (see CPUSimulationBuffers::inverseMasses).
+    void load(int lane, const Particle particles[8], const float inverseMasses[8], float compliance) {
+        float maxInvMass = 0.0f;
+        for (int i = 0; i < 8; ++i) {
+            x[i][lane] = particles[i].x;
+            y[i][lane] = particles[i].y;
+            z[i][lane] = particles[i].z;
+            lerpWeights[i][lane] = inverseMasses[i];
+            maxInvMass = std::max(maxInvMass, lerpWeights[i][lane]);
+        }
+
+        const float massNormalization = 1.0f / (std::max(maxInvMass, VGSCore::eps) + compliance);
+        for (int i = 0; i < 8; ++i) {
+            lerpWeights[i][lane] *= massNormalization;
+        }
+        activeLanes[lane] = 0xFFFFFFFFu;
+    }
+
+    // Writes a lane's solved positions back (only the positions; radius and mass are left alone).
+    void store(int lane, Particle particles[8]) const {
+        for (int i = 0; i < 8; ++i) {
+            particles[i].x = x[i][lane];
+            particles[i].y = y[i][lane];
+            particles[i].z = z[i][lane];
+        }
+    }
+};
+
+namespace detail {
+
+struct Vec3 {
+    __m256 x, y, z;
+};
+
+inline Vec3 add(const Vec3& a, const Vec3& b) {
+    return { _mm256_add_ps(a.x, b.x), _mm256_add_ps(a.y, b.y), _mm256_add_ps(a.z, b.z) };
+}
+
+inline Vec3 sub(const Vec3& a, const Vec3& b) {
+    return { _mm256_sub_ps(a.x, b.x), _mm256_sub_ps(a.y, b.y), _mm256_sub_ps(a.z, b.z) };
+}
+
+inline Vec3 mul(const Vec3& a, __m256 s) {
+    return { _mm256_mul_ps(a.x, s), _mm256_mul_ps(a.y, s), _mm256_mul_ps(a.z, s) };
+}
+
+// Divides rather than multiplying by the reciprocal, so edge lengths round the same way as the scalar version.
+// (That matters: with full edge uniformity, which edge counts as "shortest" when un-inverting a voxel comes down to rounding.)
+inline Vec3 div(const Vec3& a, __m256 s) {
+    return { _mm256_div_ps(a.x, s), _mm256_div_ps(a.y, s), _mm256_div_ps(a.z, s) };
+}
+
+inline Vec3 neg(const Vec3& a) {
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    return { _mm256_xor_ps(a.x, signBit), _mm256_xor_ps(a.y, signBit), _mm256_xor_ps(a.z, signBit) };
+}
+
+inline __m256 dot(const Vec3& a, const Vec3& b) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y)), _mm256_mul_ps(a.z, b.z));
+}
+
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+    return {
+        _mm256_sub_ps(_mm256_mul_ps(a.y, b.z), _mm256_mul_ps(a.z, b.y)),
+        _mm256_sub_ps(_mm256_mul_ps(a.z, b.x), _mm256_mul_ps(a.x, b.z)),
+        _mm256_sub_ps(_mm256_mul_ps(a.x, b.y), _mm256_mul_ps(a.y, b.x))
+    };
+}
+
+// mask ? b : a, per lane
+inline Vec3 select(const Vec3& a, const Vec3& b, __m256 mask) {
+    return { _mm256_blendv_ps(a.x, b.x, mask), _mm256_blendv_ps(a.y, b.y, mask), _mm256_blendv_ps(a.z, b.z, mask) };
+}
+
+inline Vec3 lerp(const Vec3& a, const Vec3& b, __m256 t) {
+    return add(a, mul(sub(b, a), t));
+}
+
+// Like MFloatVector::normal(): zero-length vectors stay zero.
+inline Vec3 normalOrZero(const Vec3& v) {
+    __m256 len = _mm256_sqrt_ps(dot(v, v));
+    __m256 isZero = _mm256_cmp_ps(len, _mm256_setzero_ps(), _CMP_EQ_OQ);
+    return select(div(v, len), v, isZero);
+}
+
+inline Vec3 safeProject(const Vec3& v, const Vec3& onto) {
+    __m256 denom = dot(onto, onto);
+    __m256 tooSmall = _mm256_cmp_ps(denom, _mm256_set1_ps(VGSCore::eps), _CMP_LT_OQ);
+    __m256 scale = _mm256_blendv_ps(_mm256_div_ps(dot(v, onto), denom), _mm256_setzero_ps(), tooSmall);
+    return mul(onto, scale);
+}
+
+inline Vec3 safeNormal(const Vec3& u0, const Vec3& u1, const Vec3& u2) {
+    __m256 len = _mm256_sqrt_ps(dot(u0, u0));
+    __m256 tooSmall = _mm256_cmp_ps(len, _mm256_set1_ps(VGSCore::eps), _CMP_LT_OQ);
+    Vec3 normalized = div(u0, len);
+    if (_mm256_movemask_ps(tooSmall) == 0) return normalized; // Fallback is rarely needed, skip it when no lane does
+    return select(normalized, normalOrZero(cross(u1, u2)), tooSmall);
+}
+
+inline __m256 safeLength(const Vec3& v) {
+    __m256 len = _mm256_sqrt_ps(dot(v, v));
+    __m256 epsV = _mm256_set1_ps(VGSCore::eps);
+    return _mm256_blendv_ps(len, epsV, _mm256_cmp_ps(len, epsV, _CMP_LT_OQ));
+}
+
+// Cube root of positive, finite values: a bit-trick estimate (divide the exponent by 3), refined by three Newton steps to full float precision.
+inline __m256 cbrtPositive(__m256 x) {
+    const __m256 third = _mm256_set1_ps(VGSCore::oneThird);
+    __m256 bitsAsFloat = _mm256_cvtepi32_ps(_mm256_castps_si256(x));
+    __m256i estimateBits = _mm256_add_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(bitsAsFloat, third)), _mm256_set1_epi32(709921077));
+    __m256 y = _mm256_castsi256_ps(estimateBits);
+
+    for (int i = 0; i < 3; ++i) {
+        // y = (2y + x / y^2) / 3
+        y = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(y, y), _mm256_div_ps(x, _mm256_mul_ps(y, y))), third);
+    }
+    return y;
+}
+
+struct IterationConstants {
+    __m256 relaxation;
+    __m256 edgeUniformity;
+    __m256 particleRadius;
+    __m256 voxelRestVolume;
+    __m256 edgeScaleBase;       // edgeUniformity * particleRadius
+    __m256 edgeScaleLength;     // 1 - edgeUniformity
+    __m256 convergedCorrectionSq;
+    bool bailOnInverted;
+    bool checkConvergence;
+};
+
+// Per-lane Chebyshev acceleration state (see VGSCore::doVGSIterations). The weight schedule is the same for every lane;
+// whether a lane is still accelerating is not.
+struct ChebyshevState {
+    Vec3 older[8];         // Positions as of the iteration before last
+    __m256 lastStepSq;
+    __m256 accelerating;
+    float rhoSq;
+    float omega;
+};
+
+/**
+ * One VGS iteration on every active lane (see VGSCore::doVGSIterations for the scalar version, step for step).
+ * Lanes that hit an early-out (or converged) are cleared from the active mask. Returns false once no lanes are active.
+ * chebyshev is null unless accelerating.
+ */
+inline bool iterate(Vec3 p[8], const __m256 lerpWeights[8], __m256& active, const IterationConstants& k, uint iter, ChebyshevState* chebyshev) {
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 epsV = _mm256_set1_ps(VGSCore::eps);
+
+    // Calculate basis vectors (average of edges for each axis)
+    // (Sums are accumulated left to right like the scalar version, so both round identically.)
+    Vec3 v0 = mul(add(add(add(sub(p[1], p[0]), sub(p[3], p[2])), sub(p[5], p[4])), sub(p[7], p[6])), quarter);
+    Vec3 v1 = mul(add(add(add(sub(p[2], p[0]), sub(p[3], p[1])), sub(p[6], p[4])), sub(p[7], p[5])), quarter);
+    Vec3 v2 = mul(add(add(add(sub(p[4], p[0]), sub(p[5], p[1])), sub(p[6], p[2])), sub(p[7], p[3])), quarter);
+    Vec3 v0CrossV1 = cross(v0, v1);
+    __m256 isFlat = _mm256_cmp_ps(dot(v0CrossV1, v2), _mm256_setzero_ps(), _CMP_EQ_OQ);
+    v2 = select(v2, mul(normalOrZero(v0CrossV1), k.particleRadius), isFlat);
+
+    // Apply relaxed Gram-Schmidt orthonormalization
+    Vec3 u0 = sub(v0, mul(add(safeProject(v0, v1), safeProject(v0, v2)), k.relaxation));
+    Vec3 u1 = sub(v1, mul(add(safeProject(v1, v0), safeProject(v1, v2)), k.relaxation));
+    Vec3 u2 = sub(v2, mul(add(safeProject(v2, v0), safeProject(v2, v1)), k.relaxation));
+
+    // Normalize and scale (in order - each uses the already updated previous vectors, like the scalar version)
+    u0 = mul(safeNormal(u0, u1, u2), _mm256_add_ps(k.edgeScaleBase, _mm256_mul_ps(_mm256_mul_ps(k.edgeScaleLength, safeLength(v0)), half)));
+    u1 = mul(safeNormal(u1, u2, u0), _mm256_add_ps(k.edgeScaleBase, _mm256_mul_ps(_mm256_mul_ps(k.edgeScaleLength, safeLength(v1)), half)));
+    u2 = mul(safeNormal(u2, u0, u1), _mm256_add_ps(k.edgeScaleBase, _mm256_mul_ps(_mm256_mul_ps(k.edgeScaleLength, safeLength(v2)), half)));
+
+    // Check for flipping
+    __m256 volume = dot(cross(u0, u1), u2);
+    __m256 inverted = _mm256_cmp_ps(volume, _mm256_setzero_ps(), _CMP_LT_OQ);
+    if (k.bailOnInverted) {
+        active = _mm256_andnot_ps(inverted, active);
+    } else {
+        volume = _mm256_blendv_ps(volume, _mm256_sub_ps(_mm256_setzero_ps(), volume), inverted);
+
+        // Flip the shortest edge (same tie-breaking order as the scalar version)
+        __m256 len0sq = dot(u0, u0);
+        __m256 len1sq = dot(u1, u1);
+        __m256 len2sq = dot(u2, u2);
+        __m256 flip0 = _mm256_and_ps(inverted, _mm256_and_ps(_mm256_cmp_ps(len0sq, len1sq, _CMP_LE_OQ), _mm256_cmp_ps(len0sq, len2sq, _CMP_LE_OQ)));
+        __m256 flip1 = _mm256_andnot_ps(flip0, _mm256_and_ps(inverted, _mm256_and_ps(_mm256_cmp_ps(len1sq, len0sq, _CMP_LE_OQ), _mm256_cmp_ps(len1sq, len2sq, _CMP_LE_OQ))));
+        __m256 flip2 = _mm256_andnot_ps(_mm256_or_ps(flip0, flip1), inverted);
+        u0 = select(u0, neg(u0), flip0);
+        u1 = select(u1, neg(u1), flip1);
+        u2 = select(u2, neg(u2), flip2);
+    }
+
+    // Bail if volume is too small (voxel is degenerate, there's no way to know how to restore it.
+    // Other constraints may restore it later).
+    active = _mm256_andnot_ps(_mm256_cmp_ps(volume, epsV, _CMP_LT_OQ), active);
+    if (_mm256_movemask_ps(active) == 0) return false;
+
+    // Volume preservation. (Inactive lanes may compute garbage here, but their results are discarded below.)
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 mult = _mm256_mul_ps(half, cbrtPositive(_mm256_and_ps(_mm256_div_ps(k.voxelRestVolume, volume), absMask)));
+    u0 = mul(u0, mult);
+    u1 = mul(u1, mult);
+    u2 = mul(u2, mult);
+
+    Vec3 center = p[0];
+    for (int i = 1; i < 8; ++i) {
+        center = add(center, p[i]);
+    }
+    center = mul(center, _mm256_set1_ps(0.125f));
+
+    // Lerp between current positions and goal positions weighted by inverse mass (relative to max inverse mass)
+    Vec3 minusU0 = neg(u0);
+    Vec3 minusU1 = neg(u1);
+    Vec3 minusU2 = neg(u2);
+    const Vec3* const e0[8] = { &minusU0, &u0, &minusU0, &u0, &minusU0, &u0, &minusU0, &u0 };
+    const Vec3* const e1[8] = { &minusU1, &minusU1, &u1, &u1, &minusU1, &minusU1, &u1, &u1 };
+    const Vec3* const e2[8] = { &minusU2, &minusU2, &minusU2, &minusU2, &u2, &u2, &u2, &u2 };
+    Vec3 newPositions[8];
+    for (int i = 0; i < 8; ++i) {
+        Vec3 goal = add(add(add(center, *e0[i]), *e1[i]), *e2[i]);
+        newPositions[i] = select(p[i], lerp(p[i], goal, lerpWeights[i]), active);
+    }
+
+    if (chebyshev) {
+        chebyshev->omega = VGSCore::chebyshevOmega(iter, chebyshev->rhoSq, chebyshev->omega);
+
+        __m256 stepSq = _mm256_setzero_ps();
+        for (int i = 0; i < 8; ++i) {
+            Vec3 step = sub(newPositions[i], p[i]);
+            stepSq = _mm256_max_ps(stepSq, dot(step, step));
+        }
+        chebyshev->accelerating = _mm256_andnot_ps(_mm256_cmp_ps(stepSq, chebyshev->lastStepSq, _CMP_GT_OQ), chebyshev->accelerating);
+        chebyshev->lastStepSq = stepSq;
+
+        __m256 extrapolate = _mm256_and_ps(chebyshev->accelerating, active);
+        if (chebyshev->omega != 1.0f && _mm256_movemask_ps(extrapolate) != 0) {
+            const __m256 omega = _mm256_set1_ps(chebyshev->omega);
+            for (int i = 0; i < 8; ++i) {
+                Vec3 extrapolated = add(chebyshev->older[i], mul(sub(newPositions[i], chebyshev->older[i]), omega));
+                newPositions[i] = select(newPositions[i], extrapolated, extrapolate);
+            }
+        }
+        for (int i = 0; i < 8; ++i) {
+            chebyshev->older[i] = p[i];
+        }
+    }
+
+    __m256 maxCorrectionSq = _mm256_setzero_ps();
+    for (int i = 0; i < 8; ++i) {
+        if (k.checkConvergence) {
+            Vec3 correction = sub(newPositions[i], p[i]);
+            maxCorrectionSq = _mm256_max_ps(maxCorrectionSq, dot(correction, correction));
+        }
+        p[i] = newPositions[i];
+    }
+
+    if (!k.checkConvergence) return true;
+    active = _mm256_andnot_ps(_mm256_cmp_ps(maxCorrectionSq, k.convergedCorrectionSq, _CMP_LT_OQ), active);
+    return _mm256_movemask_ps(active) != 0;
+}
+
+} // namespace detail
+
+// Iteration count is a template parameter so the loop can be fully unrolled; 0 means "use vgsConstants.iterCount".
+// See VGSCore::doVGSIterations for convergedCorrectionSq.
+template<uint IterCount>
+void doVGSIterations(VoxelBatch& batch, const VGSConstants& vgsConstants, bool bailOnInverted, float convergedCorrectionSq = 0.0f) {
+    detail::IterationConstants k;
+    k.relaxation = _mm256_set1_ps(vgsConstants.relaxation);
+    k.edgeUniformity = _mm256_set1_ps(vgsConstants.edgeUniformity);
+    k.particleRadius = _mm256_set1_ps(vgsConstants.particleRadius);
+    k.voxelRestVolume = _mm256_set1_ps(vgsConstants.voxelRestVolume);
+    k.edgeScaleBase = _mm256_set1_ps(vgsConstants.edgeUniformity * vgsConstants.particleRadius);
+    k.edgeScaleLength = _mm256_set1_ps(1.0f - vgsConstants.edgeUniformity);
+    k.convergedCorrectionSq = _mm256_set1_ps(convergedCorrectionSq);
+    k.bailOnInverted = bailOnInverted;
+    k.checkConvergence = (convergedCorrectionSq > 0.0f);
+
+    detail::Vec3 p[8];
+    __m256 lerpWeights[8];
+    for (int i = 0; i < 8; ++i) {
+        p[i] = { _mm256_load_ps(batch.x[i]), _mm256_load_ps(batch.y[i]), _mm256_load_ps(batch.z[i]) };
+        lerpWeights[i] = _mm256_load_ps(batch.lerpWeights[i]);
+    }
+    __m256 active = _mm256_load_ps(reinterpret_cast<const float*>(batch.activeLanes));
+
+    detail::ChebyshevState chebyshev;
+    const bool accelerate = (vgsConstants.chebyshevRho > 0.0f);
+    if (accelerate) {
+        chebyshev.lastStepSq = _mm256_set1_ps(FLT_MAX);
+        chebyshev.accelerating = active;
+        chebyshev.rhoSq = vgsConstants.chebyshevRho * vgsConstants.chebyshevRho;
+        chebyshev.omega = 1.0f;
+    }
+
+    const uint iterCount = (IterCount > 0) ? IterCount : vgsConstants.iterCount;
+    for (uint iter = 0; iter < iterCount; ++iter) {
+        if (!detail::iterate(p, lerpWeights, active, k, iter, accelerate ? &chebyshev : nullptr)) break;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        _mm256_store_ps(batch.x[i], p[i].x);
+        _mm256_store_ps(batch.y[i], p[i].y);
+        _mm256_store_ps(batch.z[i], p[i].z);
+    }
+}
+
+
+// Dispatches to an unrolled kernel for the iteration counts the PBD node allows (1 - 10).
+inline void doVGSIterations(VoxelBatch& batch, const VGSConstants& vgsConstants, bool bailOnInverted, float convergedCorrectionSq = 0.0f) {
+    switch (vgsConstants.iterCount) {
+        case 1: return doVGSIterations<1>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 2: return doVGSIterations<2>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 3: return doVGSIterations<3>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 4: return doVGSIterations<4>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 5: return doVGSIterations<5>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 6: return doVGSIterations<6>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 7: return doVGSIterations<7>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 8: return doVGSIterations<8>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 9: return doVGSIterations<9>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        case 10: return doVGSIterations<10>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+        default: return doVGSIterations<0>(batch, vgsConstants, bailOnInverted, convergedCorrectionSq);
+    }
+}
+
+/**
+ * Runs both this kernel and the scalar reference on copies of the given voxels (8 consecutive particles each),
+ * and returns the largest difference in any particle coordinate. Used to check the two stay in sync.
+ */
+inline float maxDeviationFromScalar(const Particle* particles, int numVoxels, const VGSConstants& vgsConstants, bool bailOnInverted) {
+    float maxDeviation = 0.0f;
+    VoxelBatch batch;
+    Particle scalarParticles[8];
+    Particle simdParticles[8];
+
+    for (int first = 0; first < numVoxels; first += laneCount) {
+        int lanes = std::min(laneCount, numVoxels - first);
+        batch.clear();
+        for (int lane = 0; lane < lanes; ++lane) {
+            batch.load(lane, particles + ((first + lane) << 3), vgsConstants.compliance);
+        }
+
+        doVGSIterations(batch, vgsConstants, bailOnInverted);
+
+        for (int lane = 0; lane < lanes; ++lane) {
+            const Particle* voxelStart = particles + ((first + lane) << 3);
+            std::copy(voxelStart, voxelStart + 8, scalarParticles);
+            std::copy(voxelStart, voxelStart + 8, simdParticles);
+            VGSCore::doVGSIterations(scalarParticles, vgsConstants, bailOnInverted);
+            batch.store(lane, simdParticles);
+
+            for (int i = 0; i < 8; ++i) {
+                maxDeviation = std::max({
+                    maxDeviation,
+                    std::abs(scalarParticles[i].x - simdParticles[i].x),
+                    std::abs(scalarParticles[i].y - simdParticles[i].y),
+                    std::abs(scalarParticles[i].z - simdParticles[i].z)
+                });
+            }
+        }
+    }
+
+    return maxDeviation;
+}
+
+} // namespace VGSSimd
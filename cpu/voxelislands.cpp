@@ -0,0 +1,143 @@
+#include "voxelislands.h"
+#include "cpusolver.h"
+#include "vgscore.h"
+#include <algorithm>
+
+void VoxelIslands::rebuild(const std::array<FaceConstraints, 3>& faceConstraints, uint numVoxels) {
+    if (parents.size() != numVoxels) {
+        parents = std::vector<std::atomic<uint>>(numVoxels);
+    }
+    neighbours.assign(numVoxels, { -1, -1, -1, -1, -1, -1 });
+    voxelIslands.resize(numVoxels);
+
+    CPUSolver::parallelFor(static_cast<int>(numVoxels), 4096, [&](int begin, int end) {
+        for (int voxel = begin; voxel < end; ++voxel) {
+            parents[voxel].store(static_cast<uint>(voxel), std::memory_order_relaxed);
+        }
+    });
+
+    // Each constraint joins a voxel to its neighbour in the positive direction, and a voxel appears in at most one constraint per side,
+    // so the neighbour slots can be written concurrently.
+    for (int axis = 0; axis < 3; ++axis) {
+        const std::vector<int>& voxelIndices = faceConstraints[axis].voxelIndices;
+        CPUSolver::parallelFor(static_cast<int>(faceConstraints[axis].size()), 4096, [&](int begin, int end) {
+            for (int constraintIdx = begin; constraintIdx < end; ++constraintIdx) {
+                int voxelA = voxelIndices[constraintIdx * 2];
+                int voxelB = voxelIndices[constraintIdx * 2 + 1];
+                if (voxelA == -1 || voxelB == -1) continue; // Broken
+
+                neighbours[voxelA][axis * 2 + 1] = voxelB;
+                neighbours[voxelB][axis * 2] = voxelA;
+                unite(static_cast<uint>(voxelA), static_cast<uint>(voxelB));
+            }
+        });
+    }
+
+    // Since roots are the smallest voxel in their set, numbering them in voxel order means each voxel's root is numbered before the voxel itself.
+    // This also keeps island indices stable for a given set of constraints, regardless of how the unions were interleaved.
+    islandCount = 0;
+    for (uint voxel = 0; voxel < numVoxels; ++voxel) {
+        uint root = find(voxel);
+        voxelIslands[voxel] = (root == voxel) ? islandCount++ : voxelIslands[root];
+    }
+
+    visitedBy.assign(numVoxels, 0);
+    searchId = 0;
+    needsRebuild = false;
+}
+
+uint VoxelIslands::find(uint voxel) {
+    uint parent = parents[voxel].load(std::memory_order_relaxed);
+    while (parent != voxel) {
+        // Path halving. If another thread re-linked in the meantime, the CAS just fails - any ancestor is still a valid parent.
+        uint grandparent = parents[parent].load(std::memory_order_relaxed);
+        parents[voxel].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+        voxel = grandparent;
+        parent = parents[voxel].load(std::memory_order_relaxed);
+    }
+    return voxel;
+}
+
+void VoxelIslands::unite(uint voxelA, uint voxelB) {
+    while (true) {
+        uint rootA = find(voxelA);
+        uint rootB = find(voxelB);
+        if (rootA == rootB) return;
+        if (rootA < rootB) std::swap(rootA, rootB);
+
+        // Link the larger root under the smaller one, unless another thread got to it first (then it's no longer a root; try again).
+        uint expected = rootA;
+        if (parents[rootA].compare_exchange_strong(expected, rootB, std::memory_order_relaxed)) return;
+    }
+}
+
+void VoxelIslands::splitAt(const std::vector<std::pair<uint, uint>>& brokenConnections) {
+    // One connection at a time, so that the islands are always exact for the connections cut so far.
+    for (const auto& [voxelA, voxelB] : brokenConnections) {
+        for (int& neighbour : neighbours[voxelA]) {
+            if (neighbour == static_cast<int>(voxelB)) neighbour = -1;
+        }
+        for (int& neighbour : neighbours[voxelB]) {
+            if (neighbour == static_cast<int>(voxelA)) neighbour = -1;
+        }
+
+        splitIfDisconnected(voxelA, voxelB);
+    }
+}
+
+void VoxelIslands::splitIfDisconnected(uint voxelA, uint voxelB) {
+    // Flood fill from both voxels at once, one voxel at a time from each side: either the fills meet (still connected),
+    // or one of them runs out first - and then it has visited exactly the smaller piece. So the cost is proportional to the piece cut off,
+    // not to the size of the island.
+    const uint searchIds[2] = { searchId + 1, searchId + 2 };
+    searchId += 2;
+    if (searchId < 2) { // Wrapped around - stale ids in visitedBy could collide
+        std::fill(visitedBy.begin(), visitedBy.end(), 0u);
+        return splitIfDisconnected(voxelA, voxelB);
+    }
+
+    size_t frontierHeads[2] = { 0, 0 };
+    for (int side = 0; side < 2; ++side) {
+        uint start = (side == 0) ? voxelA : voxelB;
+        searchFrontiers[side].clear();
+        searchFrontiers[side].push_back(start);
+        visitedBy[start] = searchIds[side];
+    }
+
+    while (true) {
+        for (int side = 0; side < 2; ++side) {
+            std::vector<uint>& frontier = searchFrontiers[side];
+            if (frontierHeads[side] == frontier.size()) {
+                // This side's piece is complete, and the other side never reached it
+                uint newIsland = islandCount++;
+                for (uint voxel : frontier) {
+                    voxelIslands[voxel] = newIsland;
+                }
+                return;
+            }
+
+            uint voxel = frontier[frontierHeads[side]++];
+            for (int neighbour : neighbours[voxel]) {
+                if (neighbour == -1) continue;
+                if (visitedBy[neighbour] == searchIds[1 - side]) return; // Met the other side
+                if (visitedBy[neighbour] == searchIds[side]) continue;
+
+                visitedBy[neighbour] = searchIds[side];
+                frontier.push_back(static_cast<uint>(neighbour));
+            }
+        }
+    }
+}
+
+void VoxelIslands::computeBounds(const Particle* particles, std::vector<MBoundingBox>& bounds) const {
+    bounds.assign(islandCount, MBoundingBox());
+    for (uint voxel = 0; voxel < voxelIslands.size(); ++voxel) {
+        MBoundingBox& islandBounds = bounds[voxelIslands[voxel]];
+        for (uint i = (voxel << 3); i < (voxel << 3) + 8; ++i) {
+            const Particle& particle = particles[i];
+            double radius = VGSCore::particleRadius(particle);
+            islandBounds.expand(MPoint(particle.x - radius, particle.y - radius, particle.z - radius));
+            islandBounds.expand(MPoint(particle.x + radius, particle.y + radius, particle.z + radius));
+        }
+    }
+}
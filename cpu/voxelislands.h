@@ -0,0 +1,57 @@
+#pragma once
+
+#include "directx/compute/faceconstraintscompute.h"
+#include <maya/MBoundingBox.h>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <utility>
+
+/**
+ * Connected components ("islands") of an object's voxels over its unbroken face constraints. Each island is a separate piece of the object:
+ * nothing but collisions links it to the others.
+ *
+ * Islands are built once, with a concurrent union-find over all constraints, and then kept up to date as constraints break by splitting
+ * off only the affected pieces (see splitAt). A full rebuild is only needed when the constraints change some other way (cache restore, paint),
+ * in which case the owner calls invalidate() and the next rebuild() redoes them.
+ */
+class VoxelIslands {
+public:
+    VoxelIslands() = default;
+    ~VoxelIslands() = default;
+
+    // Multithreaded: the caller must hold a reference to the thread pool (see CPUSolver::parallelFor).
+    void rebuild(const std::array<FaceConstraints, 3>& faceConstraints, uint numVoxels);
+    void invalidate() { needsRebuild = true; }
+    bool isValid() const { return !needsRebuild; }
+
+    // Updates the islands for face constraints that just broke, given as (voxelA, voxelB) pairs.
+    // A piece that gets cut off becomes a new island (appended at the end); the rest of the old island keeps its index.
+    void splitAt(const std::vector<std::pair<uint, uint>>& brokenConnections);
+
+    uint numIslands() const { return islandCount; }
+    uint islandOf(uint voxel) const { return voxelIslands[voxel]; }
+
+    // Per island, the bounds of its particles (including their radii). particles are the object's own, i.e. indexed by local voxel.
+    void computeBounds(const Particle* particles, std::vector<MBoundingBox>& bounds) const;
+
+private:
+    // Concurrent union-find: roots are always the smallest voxel in their set, so links only ever point downwards and can't form cycles.
+    uint find(uint voxel);
+    void unite(uint voxelA, uint voxelB);
+
+    // Whether the two voxels are still connected. If not, the smaller of the two pieces is moved to a new island.
+    void splitIfDisconnected(uint voxelA, uint voxelB);
+
+    std::vector<std::atomic<uint>> parents;
+    // Per voxel, its neighbour across each of its 6 faces (-X, +X, -Y, +Y, -Z, +Z) over an unbroken constraint, or -1.
+    std::vector<std::array<int, 6>> neighbours;
+    std::vector<uint> voxelIslands;
+    uint islandCount = 0;
+    bool needsRebuild = true;
+
+    // Scratch space for splitIfDisconnected's searches
+    std::vector<uint> visitedBy;
+    uint searchId = 0;
+    std::vector<uint> searchFrontiers[2];
+};
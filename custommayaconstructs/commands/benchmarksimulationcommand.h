@@ -0,0 +1,132 @@
+#pragma once
+#include <maya/MGlobal.h>
+#include <maya/MPxCommand.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MSyntax.h>
+#include <maya/MPlug.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include "../../globalsolver.h"
+#include "../../pbd.h"
+#include "../usernodes/pbdnode.h"
+#include "../../directx/directx.h"
+#include "../../directx/compute/computeshader.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Headless simulation benchmark: re-simulates the scene from the start frame for a given number of frames and reports the simulation frames per second.
+ * Works without a viewport (e.g. from mayabatch / mayapy), so the GPU and CPU backends can be compared on the same scene:
+ *     benchmarkSimulation -frames 200 -cpu true;
+ * Also reports the compute shader dispatches per frame, e.g. to compare batched and per-object GPU dispatch as the number of objects grows:
+ *     benchmarkSimulation -frames 200 -batched true;
+ * With -setup, first times building each object's constraints from scratch (the work done when a mesh is voxelized), reported per voxel count:
+ *     benchmarkSimulation -frames 1 -setup true;
+ * Note: this clears the simulation cache.
+ */
+class BenchmarkSimulationCommand : public MPxCommand {
+public:
+    inline static const MString commandName = MString("benchmarkSimulation");
+
+	static void* creator() {
+        return new BenchmarkSimulationCommand();
+    }
+    
+    static MSyntax syntax() {
+        MSyntax syntax;
+        syntax.addFlag("-f", "-frames", MSyntax::kLong);
+        syntax.addFlag("-c", "-cpu", MSyntax::kBoolean);
+        syntax.addFlag("-b", "-batched", MSyntax::kBoolean);
+        syntax.addFlag("-s", "-setup", MSyntax::kBoolean);
+        return syntax;
+    }
+
+    bool isUndoable() const override {
+        return false;
+    }
+
+	MStatus doIt(const MArgList& args) override {
+        MStatus status;
+        MArgDatabase argData(syntax(), args, &status);
+        if (!status) return status;
+
+        if (GlobalSolver::globalSolverNodeObject.isNull()) {
+            MGlobal::displayError("No simulated objects in the scene to benchmark.");
+            return MS::kFailure;
+        }
+
+        int numFrames = 100;
+        if (argData.isFlagSet("-f")) argData.getFlagArgument("-f", 0, numFrames);
+        if (numFrames <= 0) {
+            MGlobal::displayError("Number of frames must be positive.");
+            return MS::kInvalidParameter;
+        }
+
+        bool benchmarkSetup = false;
+        if (argData.isFlagSet("-s")) argData.getFlagArgument("-s", 0, benchmarkSetup);
+        if (benchmarkSetup) benchmarkConstraintConstruction();
+
+        MPlug cpuSimulationPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aCPUSimulation);
+        bool wasCPUSimulation = cpuSimulationPlug.asBool();
+        bool useCPU = wasCPUSimulation;
+        if (argData.isFlagSet("-c")) argData.getFlagArgument("-c", 0, useCPU);
+        cpuSimulationPlug.setBool(useCPU);
+
+        MPlug batchedDispatchPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aBatchedDispatch);
+        bool wasBatchedDispatch = batchedDispatchPlug.asBool();
+        bool useBatchedDispatch = wasBatchedDispatch;
+        if (argData.isFlagSet("-b")) argData.getFlagArgument("-b", 0, useBatchedDispatch);
+        batchedDispatchPlug.setBool(useBatchedDispatch);
+
+        // Time from the start frame on, so the cache reset isn't counted.
+        std::chrono::steady_clock::time_point begin;
+        uint64_t firstDispatch = 0;
+        GlobalSolver::resimulateFromStart(numFrames, [&](int frame) {
+            if (frame != 0) return;
+            begin = std::chrono::steady_clock::now();
+            firstDispatch = ComputeShader::getNumDispatches();
+        });
+        uint64_t numDispatches = ComputeShader::getNumDispatches() - firstDispatch;
+
+        // Dispatches are asynchronous - reading the particles back waits for all the queued GPU work to finish.
+        std::vector<Particle> particles;
+        DirectX::copyBufferToVector(GlobalSolver::getBuffer(GlobalSolver::BufferType::PARTICLE), particles);
+        auto end = std::chrono::steady_clock::now();
+
+        cpuSimulationPlug.setBool(wasCPUSimulation);
+        batchedDispatchPlug.setBool(wasBatchedDispatch);
+
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        double fps = (seconds > 0.0) ? numFrames / seconds : 0.0;
+        int numObjects = Utils::arrayPlugNumElements(GlobalSolver::globalSolverNodeObject, GlobalSolver::aParticleData);
+        MString backend = useCPU ? "CPU" : (useBatchedDispatch ? "GPU (batched)" : "GPU");
+        MGlobal::displayInfo(MString("Simulated ") + numFrames + " frames of " + numObjects + " objects on the " + backend + " in " + seconds + "s (" + fps + " fps, "
+            + static_cast<double>(numDispatches) / numFrames + " dispatches per frame).");
+        setResult(fps);
+
+        return MS::kSuccess;
+    }
+
+private:
+    // Rebuilds each simulated object's constraints (without touching the ones in use) and reports how long that took for its voxel count.
+    static void benchmarkConstraintConstruction() {
+        MPlug particleDataArrayPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aParticleData);
+        for (uint i = 0; i < particleDataArrayPlug.numElements(); ++i) {
+            MPlug pbdParticleDataPlug = particleDataArrayPlug.elementByPhysicalIndex(i).source();
+            if (pbdParticleDataPlug.isNull()) continue;
+
+            Utils::PluginData<VoxelData> voxelData(pbdParticleDataPlug.node(), PBDNode::aVoxelDataIn);
+            MSharedPtr<Voxels> voxels = voxelData.get()->getVoxels();
+
+            std::array<FaceConstraints, 3> faceConstraints;
+            LongRangeConstraints longRangeConstraints;
+            auto begin = std::chrono::steady_clock::now();
+            PBD::constructConstraints(voxels, faceConstraints, longRangeConstraints);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            MGlobal::displayInfo(MString("Built constraints for ") + voxels->numOccupied + " voxels in " + seconds + "s.");
+        }
+    }
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <maya/MGlobal.h>
+#include <maya/MPxCommand.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MSyntax.h>
+#include <maya/MPlug.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include <maya/MFnDependencyNode.h>
+#include <climits>
+#include "../../globalsolver.h"
+
+/**
+ * Queries the face constraint breaks logged while recordFractureEvents is on (see FractureEventLog), as 8 values per event:
+ *     frame, object (PBD node logical index on the global solver), substep, axis, constraint index, voxel A, voxel B, strain
+ * Voxel indices are local to the object. Filter by frame with -frame, or -startFrame / -endFrame, and by object with -object <pbd node>:
+ *     fractureEvents -startFrame 10 -endFrame 20 -object pbdNode1;
+ * -count returns just the number of matching events. -export writes the whole log to a CSV file (objects by name), and -clear empties it.
+ */
+class FractureEventsCommand : public MPxCommand {
+public:
+    inline static const MString commandName = MString("fractureEvents");
+
+	static void* creator() {
+        return new FractureEventsCommand();
+    }
+
+    static MSyntax syntax() {
+        MSyntax syntax;
+        syntax.addFlag("-f", "-frame", MSyntax::kLong);
+        syntax.addFlag("-sf", "-startFrame", MSyntax::kLong);
+        syntax.addFlag("-ef", "-endFrame", MSyntax::kLong);
+        syntax.addFlag("-o", "-object", MSyntax::kString);
+        syntax.addFlag("-c", "-count");
+        syntax.addFlag("-e", "-export", MSyntax::kString);
+        syntax.addFlag("-cl", "-clear");
+        return syntax;
+    }
+
+    bool isUndoable() const override {
+        return false;
+    }
+
+	MStatus doIt(const MArgList& args) override {
+        MStatus status;
+        MArgDatabase argData(syntax(), args, &status);
+        if (!status) return status;
+
+        if (GlobalSolver::globalSolverNodeObject.isNull()) {
+            MGlobal::displayError("No simulated objects in the scene.");
+            return MS::kFailure;
+        }
+
+        FractureEventLog& fractureEventLog = GlobalSolver::getFractureEventLog();
+        clearResult();
+
+        if (argData.isFlagSet("-cl")) {
+            fractureEventLog.clear();
+            return MS::kSuccess;
+        }
+
+        if (argData.isFlagSet("-e")) {
+            MString filePath;
+            argData.getFlagArgument("-e", 0, filePath);
+            status = fractureEventLog.exportToFile(filePath, objectName);
+            if (!status) {
+                MGlobal::displayError("Could not write fracture events to " + filePath);
+                return status;
+            }
+
+            MGlobal::displayInfo(MString("Exported ") + static_cast<int>(fractureEventLog.size()) + " fracture events to " + filePath);
+            return MS::kSuccess;
+        }
+
+        int startFrame = INT_MIN;
+        int endFrame = INT_MAX;
+        if (argData.isFlagSet("-f")) {
+            argData.getFlagArgument("-f", 0, startFrame);
+            endFrame = startFrame;
+        }
+        if (argData.isFlagSet("-sf")) argData.getFlagArgument("-sf", 0, startFrame);
+        if (argData.isFlagSet("-ef")) argData.getFlagArgument("-ef", 0, endFrame);
+
+        int objectIndex = -1;
+        if (argData.isFlagSet("-o")) {
+            MString objectNodeName;
+            argData.getFlagArgument("-o", 0, objectNodeName);
+            objectIndex = findObjectIndex(objectNodeName);
+            if (objectIndex == -1) {
+                MGlobal::displayError(objectNodeName + " is not a simulated object.");
+                return MS::kInvalidParameter;
+            }
+        }
+
+        if (fractureEventLog.getNumDropped() > 0) {
+            MGlobal::displayWarning(MString("") + static_cast<double>(fractureEventLog.getNumDropped()) + " fracture events were dropped (more than "
+                + FRACTURE_EVENT_CAPACITY + " in a single frame).");
+        }
+
+        bool countOnly = argData.isFlagSet("-c");
+        int count = 0;
+        auto [begin, end] = fractureEventLog.findFrames(startFrame, endFrame);
+        for (size_t i = begin; i < end; ++i) {
+            const FractureEventLog::Record& record = fractureEventLog[i];
+            if (objectIndex != -1 && record.objectIndex != objectIndex) continue;
+
+            ++count;
+            if (countOnly) continue;
+
+            const FractureEvent& event = record.event;
+            appendToResult(static_cast<double>(record.frame));
+            appendToResult(static_cast<double>(record.objectIndex));
+            appendToResult(static_cast<double>(event.substep));
+            appendToResult(static_cast<double>(event.axis));
+            appendToResult(static_cast<double>(event.constraintIdx));
+            appendToResult(static_cast<double>(event.voxelA));
+            appendToResult(static_cast<double>(event.voxelB));
+            appendToResult(static_cast<double>(event.strain));
+        }
+
+        if (countOnly) {
+            setResult(count);
+        }
+        return MS::kSuccess;
+    }
+
+private:
+    // Objects are identified by which element of the global solver's particle data array they're connected to.
+    static MString objectName(int objectIndex) {
+        if (objectIndex < 0) return MString("");
+
+        MPlug particleDataPlug = MPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aParticleData).elementByLogicalIndex(objectIndex);
+        MPlug sourcePlug = particleDataPlug.source();
+        if (sourcePlug.isNull()) return MString("");
+        return MFnDependencyNode(sourcePlug.node()).name();
+    }
+
+    static int findObjectIndex(const MString& nodeName) {
+        MPlug particleDataArrayPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aParticleData);
+        for (uint i = 0; i < particleDataArrayPlug.numElements(); ++i) {
+            MPlug particleDataPlug = particleDataArrayPlug.elementByPhysicalIndex(i);
+            MPlug sourcePlug = particleDataPlug.source();
+            if (sourcePlug.isNull()) continue;
+            if (MFnDependencyNode(sourcePlug.node()).name() == nodeName) return static_cast<int>(particleDataPlug.logicalIndex());
+        }
+        return -1;
+    }
+};
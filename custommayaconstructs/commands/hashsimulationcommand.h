@@ -0,0 +1,103 @@
+#pragma once
+#include <maya/MGlobal.h>
+#include <maya/MPxCommand.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MSyntax.h>
+#include <maya/MPlug.h>
+#include <maya/MThreadUtils.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include "../../globalsolver.h"
+#include "../../directx/directx.h"
+#include "../../utils.h"
+#include <cstdio>
+#include <vector>
+
+/**
+ * Simulation regression harness: re-simulates the scene from the start frame and returns a hash of the whole particle buffer for every frame
+ * (start frame included), as a string array. Runs from different builds, machines, or thread counts can then be diffed frame by frame:
+ *     hashSimulation -frames 100 -cpu true -deterministic true -threads 4;
+ * Bit-identical results are only expected with the deterministic CPU backend. Note: this clears the simulation cache.
+ */
+class HashSimulationCommand : public MPxCommand {
+public:
+    inline static const MString commandName = MString("hashSimulation");
+
+	static void* creator() {
+        return new HashSimulationCommand();
+    }
+
+    static MSyntax syntax() {
+        MSyntax syntax;
+        syntax.addFlag("-f", "-frames", MSyntax::kLong);
+        syntax.addFlag("-c", "-cpu", MSyntax::kBoolean);
+        syntax.addFlag("-d", "-deterministic", MSyntax::kBoolean);
+        syntax.addFlag("-t", "-threads", MSyntax::kLong);
+        return syntax;
+    }
+
+    bool isUndoable() const override {
+        return false;
+    }
+
+	MStatus doIt(const MArgList& args) override {
+        MStatus status;
+        MArgDatabase argData(syntax(), args, &status);
+        if (!status) return status;
+
+        if (GlobalSolver::globalSolverNodeObject.isNull()) {
+            MGlobal::displayError("No simulated objects in the scene to hash.");
+            return MS::kFailure;
+        }
+
+        int numFrames = 100;
+        if (argData.isFlagSet("-f")) argData.getFlagArgument("-f", 0, numFrames);
+        if (numFrames <= 0) {
+            MGlobal::displayError("Number of frames must be positive.");
+            return MS::kInvalidParameter;
+        }
+
+        // Temporarily override the solver settings (restored at the end)
+        MPlug cpuSimulationPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aCPUSimulation);
+        MPlug deterministicPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aDeterministic);
+        bool wasCPUSimulation = cpuSimulationPlug.asBool();
+        bool wasDeterministic = deterministicPlug.asBool();
+        bool useCPU = wasCPUSimulation;
+        bool deterministic = wasDeterministic;
+        if (argData.isFlagSet("-c")) argData.getFlagArgument("-c", 0, useCPU);
+        if (argData.isFlagSet("-d")) argData.getFlagArgument("-d", 0, deterministic);
+        cpuSimulationPlug.setBool(useCPU);
+        deterministicPlug.setBool(deterministic);
+
+        // The thread pool picks up the new count the next time it's created (the CPU backend releases it at the end of every frame).
+        int previousNumThreads = MThreadUtils::getNumThreads();
+        int numThreads = previousNumThreads;
+        if (argData.isFlagSet("-t")) argData.getFlagArgument("-t", 0, numThreads);
+        if (numThreads > 0) MThreadUtils::setNumThreads(numThreads);
+
+        std::vector<Particle> particles;
+        uint64_t combinedHash = Utils::hashBytes(nullptr, 0);
+        clearResult();
+        GlobalSolver::resimulateFromStart(numFrames, [&](int frame) {
+            DirectX::copyBufferToVector(GlobalSolver::getBuffer(GlobalSolver::BufferType::PARTICLE), particles);
+            uint64_t frameHash = Utils::hashBytes(particles.data(), particles.size() * sizeof(Particle));
+            combinedHash = Utils::hashBytes(&frameHash, sizeof(frameHash), combinedHash);
+            appendToResult(toHexString(frameHash));
+        });
+
+        MThreadUtils::setNumThreads(previousNumThreads);
+        cpuSimulationPlug.setBool(wasCPUSimulation);
+        deterministicPlug.setBool(wasDeterministic);
+
+        MGlobal::displayInfo(MString("Hashed ") + (numFrames + 1) + " frames, combined hash: " + toHexString(combinedHash));
+        return MS::kSuccess;
+    }
+
+private:
+    static MString toHexString(uint64_t value) {
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+        return MString(buffer);
+    }
+};
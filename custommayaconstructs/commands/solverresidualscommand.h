@@ -0,0 +1,106 @@
+#pragma once
+#include <maya/MGlobal.h>
+#include <maya/MPxCommand.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MSyntax.h>
+#include <maya/MPlug.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include "../../globalsolver.h"
+
+/**
+ * Returns the constraint errors the CPU solver left behind (see SolverResiduals), as 6 floats per frame:
+ *     max volume error, mean volume error, max edge strain, mean edge strain, max penetration, mean penetration
+ * Without flags, returns those of the last simulated frame (requires measureResiduals on the global solver).
+ * With -frames, re-simulates the scene from the start frame on the CPU, measuring every frame, and returns them all - e.g. to compare
+ * vgsIterations / numSubsteps / convergenceTolerance settings on a shot:
+ *     solverResiduals -frames 100;
+ * Note: -frames clears the simulation cache.
+ */
+class SolverResidualsCommand : public MPxCommand {
+public:
+    inline static const MString commandName = MString("solverResiduals");
+
+	static void* creator() {
+        return new SolverResidualsCommand();
+    }
+
+    static MSyntax syntax() {
+        MSyntax syntax;
+        syntax.addFlag("-f", "-frames", MSyntax::kLong);
+        return syntax;
+    }
+
+    bool isUndoable() const override {
+        return false;
+    }
+
+	MStatus doIt(const MArgList& args) override {
+        MStatus status;
+        MArgDatabase argData(syntax(), args, &status);
+        if (!status) return status;
+
+        if (GlobalSolver::globalSolverNodeObject.isNull()) {
+            MGlobal::displayError("No simulated objects in the scene.");
+            return MS::kFailure;
+        }
+
+        MPlug measureResidualsPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aMeasureResiduals);
+        clearResult();
+
+        if (!argData.isFlagSet("-f")) {
+            if (!measureResidualsPlug.asBool()) {
+                MGlobal::displayError("Residuals aren't being measured. Turn on measureResiduals on the global solver, or use -frames.");
+                return MS::kFailure;
+            }
+
+            appendResiduals(GlobalSolver::getCPUSimulationBuffers().residuals);
+            return MS::kSuccess;
+        }
+
+        int numFrames = 0;
+        argData.getFlagArgument("-f", 0, numFrames);
+        if (numFrames <= 0) {
+            MGlobal::displayError("Number of frames must be positive.");
+            return MS::kInvalidParameter;
+        }
+
+        // Temporarily override the solver settings (restored at the end)
+        MPlug cpuSimulationPlug(GlobalSolver::globalSolverNodeObject, GlobalSolver::aCPUSimulation);
+        bool wasCPUSimulation = cpuSimulationPlug.asBool();
+        bool wasMeasuringResiduals = measureResidualsPlug.asBool();
+        cpuSimulationPlug.setBool(true);
+        measureResidualsPlug.setBool(true);
+
+        SolverResiduals frameResiduals;
+        SolverResiduals allResiduals;
+        GlobalSolver::resimulateFromStart(numFrames, [&](int frame) {
+            if (frame == 0) return; // Start frame isn't simulated
+
+            frameResiduals = GlobalSolver::getCPUSimulationBuffers().residuals;
+            appendResiduals(frameResiduals);
+            allResiduals.volumeError.merge(frameResiduals.volumeError);
+            allResiduals.edgeStrain.merge(frameResiduals.edgeStrain);
+            allResiduals.penetration.merge(frameResiduals.penetration);
+        });
+
+        cpuSimulationPlug.setBool(wasCPUSimulation);
+        measureResidualsPlug.setBool(wasMeasuringResiduals);
+
+        MGlobal::displayInfo(MString("Over ") + numFrames + " frames - volume error: max " + allResiduals.volumeError.max + ", mean " + allResiduals.volumeError.mean()
+            + "; edge strain: max " + allResiduals.edgeStrain.max + ", mean " + allResiduals.edgeStrain.mean()
+            + "; penetration: max " + allResiduals.penetration.max + ", mean " + allResiduals.penetration.mean());
+        return MS::kSuccess;
+    }
+
+private:
+    void appendResiduals(const SolverResiduals& residuals) {
+        appendToResult(static_cast<double>(residuals.volumeError.max));
+        appendToResult(static_cast<double>(residuals.volumeError.mean()));
+        appendToResult(static_cast<double>(residuals.edgeStrain.max));
+        appendToResult(static_cast<double>(residuals.edgeStrain.mean()));
+        appendToResult(static_cast<double>(residuals.penetration.max));
+        appendToResult(static_cast<double>(residuals.penetration.mean()));
+    }
+};
@@ -33,6 +33,8 @@ public:
     inline static MObject aVgsRelaxation;
     inline static MObject aVgsEdgeUniformity;
     inline static MObject aVgsIterations;
+    inline static MObject aLongRangeLevels;
+    inline static MObject aVgsChebyshevRho;
     inline static MObject aGravityStrength;
     inline static MObject aFaceConstraintLow;
     inline static MObject aFaceConstraintHigh;
@@ -99,6 +101,20 @@ public:
         addAttribute(aVgsIterations);
         CHECK_MSTATUS_AND_RETURN_IT(status);
 
+        aLongRangeLevels = nAttr.create("longRangeLevels", "lrl", MFnNumericData::kInt, 1, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        nAttr.setMin(1);
+        nAttr.setMax(LONG_RANGE_LEVELS);
+        addAttribute(aLongRangeLevels);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+
+        aVgsChebyshevRho = nAttr.create("vgsChebyshevRho", "vgscr", MFnNumericData::kFloat, 0.0f, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        nAttr.setMin(0.0f);
+        nAttr.setMax(0.99f);
+        addAttribute(aVgsChebyshevRho);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+
         aGravityStrength = nAttr.create("gravityStrength", "gs", MFnNumericData::kFloat, -9.81f, &status);
         CHECK_MSTATUS_AND_RETURN_IT(status);
         nAttr.setMin(-100.0f);
@@ -287,13 +303,7 @@ public:
             }
         );
         
-        std::array<std::vector<int>, 3> voxelToFaceConstraintIndices; // per-axis arrays of mappings from voxel index to face constraint index
-        voxelToFaceConstraintIndices.fill( std::vector<int>(voxels->numOccupied, -1) );
-
-        std::array<FaceConstraints, 3> faceConstraints = pbd.constructFaceToFaceConstraints(voxels, voxelToFaceConstraintIndices);
-        LongRangeConstraints longRangeConstraints = pbd.constructLongRangeConstraints(voxels, voxelToFaceConstraintIndices, { faceConstraints[0].size(), faceConstraints[1].size(), faceConstraints[2].size()});
-
-        pbd.createComputeShaders(voxels, faceConstraints, longRangeConstraints);
+        pbd.createComputeShaders(voxels, PBD::acquireConstraintTopology(voxels));
 
         Utils::createPluginData<FunctionalData>(
             pbdNode->thisMObject(),
@@ -322,7 +332,9 @@ public:
             dataBlock.inputValue(aVgsEdgeUniformity).asFloat(),
             static_cast<uint>(dataBlock.inputValue(aVgsIterations).asInt()),
             dataBlock.inputValue(aGravityStrength).asFloat(),
-            static_cast<float>(secondsPerFrame) / numSubsteps
+            static_cast<float>(secondsPerFrame) / numSubsteps,
+            static_cast<uint>(dataBlock.inputValue(aLongRangeLevels).asInt()),
+            dataBlock.inputValue(aVgsChebyshevRho).asFloat()
         });
     }
 
@@ -358,6 +370,7 @@ private:
         ComPtr<ID3D11ShaderResourceView> isDraggingSRV = DirectX::createSRV(GlobalSolver::getBuffer(GlobalSolver::BufferType::DRAGGING), numVoxels, voxelOffset);
 
         pbd.setGPUResourceHandles(particleUAV, oldParticlesUAV, isSurfaceUAV, isDraggingSRV);
+        pbd.setParticleBufferOffset(particleBufferOffset);
         pbd.setInitialized(true);
     }
 
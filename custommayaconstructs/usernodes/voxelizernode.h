@@ -41,6 +41,10 @@ public:
         bool voxelizeInterior,
         bool doBoolean,
         bool clipTriangles,
+        bool computeDistances,
+        bool refineDistanceField,
+        bool useWindingNumber,
+        bool thinSurface,
         MDagPath& outDagPath,
         MStatus& status
     ) {
@@ -56,6 +60,10 @@ public:
                 voxelizeInterior,
                 doBoolean,
                 clipTriangles,
+                computeDistances,
+                refineDistanceField,
+                useWindingNumber,
+                thinSurface,
                 status
             )
         );
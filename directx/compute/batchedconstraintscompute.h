@@ -0,0 +1,392 @@
+#pragma once
+
+#include "directx/compute/computeshader.h"
+#include "shaders/constants.hlsli"
+#include <array>
+#include <vector>
+#include <algorithm>
+
+struct BatchedPassCB {
+    std::array<uint, 4> faceAParticles;
+    std::array<uint, 4> faceBParticles;
+    uint numThreads;
+    uint numObjects;
+    uint axis;
+    uint level;
+    uint substep;
+    uint recordFractureEvents;
+    uint padding0;
+    uint padding1;
+};
+
+// What the batched passes need from one object for a frame: where its state lives, and the parameters it's simulated with.
+struct BatchedObjectSource {
+    uint particleOffset;
+    uint numParticles;
+    std::array<ComPtr<ID3D11Buffer>, 3> faceConstraintIndexBuffers;
+    std::array<ComPtr<ID3D11Buffer>, 3> faceConstraintLimitsBuffers;
+    std::array<ComPtr<ID3D11Buffer>, 3> faceIdxToLRConstraintBuffers;
+    std::array<uint, 3> numFaceConstraints;
+    ComPtr<ID3D11Buffer> longRangeParticleIndicesBuffer;
+    std::array<uint, LONG_RANGE_LEVELS + 1> longRangeLevelOffsets;
+    int numLongRangeLevels;
+    BatchedObjectParams params;
+};
+
+/**
+ * Runs each PBD pass once per substep over every object, instead of once per object - so the number of dispatches per substep
+ * stays the same (prevgs, vgs, one per long-range level, and one per face axis) no matter how many objects are in the scene.
+ *
+ * Objects keep owning their constraint state (it's what gets cached, painted, rendered, and simulated by the CPU backend), so at the start of a frame
+ * gather() copies every object's constraint buffers, GPU-side, into concatenated batch buffers, and scatter() copies the parts the simulation changes
+ * (the face constraint indices, and the long-range counters) back at the end. Indices stay local to each object; the shaders find the object an item
+ * belongs to with a binary search over a table of per-object offsets (see BATCH_OFFSET_* in constants.hlsli), and look up its parameters alongside.
+ */
+class BatchedConstraintsCompute : public ComputeShader
+{
+public:
+    BatchedConstraintsCompute() = default;
+
+    BatchedConstraintsCompute(
+        const ComPtr<ID3D11UnorderedAccessView>& particlesUAV,
+        const ComPtr<ID3D11UnorderedAccessView>& oldParticlesUAV,
+        const ComPtr<ID3D11UnorderedAccessView>& isSurfaceUAV,
+        const ComPtr<ID3D11ShaderResourceView>& isDraggingSRV
+    ) : ComputeShader(IDR_SHADER20),
+        particlesUAV(particlesUAV),
+        oldParticlesUAV(oldParticlesUAV),
+        isSurfaceUAV(isSurfaceUAV),
+        isDraggingSRV(isDraggingSRV)
+    {
+        loadShaderObject(preVGSEntryPoint);
+        loadShaderObject(vgsEntryPoint);
+        loadShaderObject(longRangeConstraintsEntryPoint);
+
+        // Order of vertex indices corresponds to definitions in cube.h (same as FaceConstraintsCompute)
+        for (BatchedPassCB& cbData : passCBData) {
+            cbData = BatchedPassCB{ {0, 0, 0, 0}, {0, 0, 0, 0}, 0, 0, 0, 0, 0, 0, 0, 0 };
+        }
+        passCBData[facePass(0)].faceAParticles = { 1, 3, 5, 7 };
+        passCBData[facePass(0)].faceBParticles = { 0, 2, 4, 6 };
+        passCBData[facePass(1)].faceAParticles = { 2, 3, 6, 7 };
+        passCBData[facePass(1)].faceBParticles = { 0, 1, 4, 5 };
+        passCBData[facePass(2)].faceAParticles = { 4, 5, 6, 7 };
+        passCBData[facePass(2)].faceBParticles = { 0, 1, 2, 3 };
+        for (int pass = 0; pass < numPasses; ++pass) {
+            if (pass >= facePass(0)) passCBData[pass].axis = pass - facePass(0);
+            if (pass >= longRangePass(0) && pass < facePass(0)) passCBData[pass].level = pass - longRangePass(0);
+            passCBs[pass] = DirectX::createConstantBuffer<BatchedPassCB>(passCBData[pass]);
+        }
+    }
+
+    void reset() override {
+        for (const ComPtr<ID3D11Buffer>& buffer : passCBs) {
+            if (buffer) DirectX::notifyMayaOfMemoryUsage(buffer);
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            releaseBuffer(faceConstraintIndexBuffers[axis]);
+            releaseBuffer(faceConstraintLimitsBuffers[axis]);
+            releaseBuffer(faceIdxToLRConstraintBuffers[axis]);
+        }
+        releaseBuffer(longRangeParticleIndicesBuffer);
+        releaseBuffer(objectOffsetsBuffer);
+        releaseBuffer(objectParamsBuffer);
+    }
+
+    /**
+     * Copies the objects' constraint state into the batch buffers, and updates the per-object tables, for the frame about to be simulated.
+     * The objects must tile the first totalParticles particles of the global buffer, since the particle passes run over all of them;
+     * returns false (and batches nothing) if they don't, e.g. while an object is still being set up.
+     */
+    bool gather(std::vector<BatchedObjectSource>& sources, uint totalParticles) {
+        numObjects = 0;
+        sources.erase(std::remove_if(sources.begin(), sources.end(), [](const BatchedObjectSource& source) {
+            return source.numParticles == 0;
+        }), sources.end());
+        if (sources.empty()) return false;
+
+        // The shaders' binary search needs every kind of offset to be non-decreasing over the objects, which holds when they're in particle order.
+        std::sort(sources.begin(), sources.end(), [](const BatchedObjectSource& a, const BatchedObjectSource& b) {
+            return a.particleOffset < b.particleOffset;
+        });
+
+        uint nextParticle = 0;
+        for (const BatchedObjectSource& source : sources) {
+            if (source.particleOffset != nextParticle) return false;
+            nextParticle += source.numParticles;
+        }
+        if (nextParticle != totalParticles) return false;
+
+        const uint n = static_cast<uint>(sources.size());
+        objectOffsets.assign(BATCH_OFFSET_KINDS * n, 0);
+        objectParams.resize(n);
+
+        std::array<uint, 3> numFaceThreads = { 0, 0, 0 };
+        std::array<uint, LONG_RANGE_LEVELS> numLongRangeThreads{};
+        uint numLongRangeConstraints = 0;
+        for (uint i = 0; i < n; ++i) {
+            const BatchedObjectSource& source = sources[i];
+            objectOffsets[BATCH_OFFSET_PARTICLES * n + i] = source.particleOffset;
+
+            for (int axis = 0; axis < 3; ++axis) {
+                objectOffsets[(BATCH_OFFSET_FACE_CONSTRAINTS + axis) * n + i] = numFaceThreads[axis];
+                numFaceThreads[axis] += source.numFaceConstraints[axis];
+            }
+
+            // Levels past the object's active ones get no threads (but their constraints are still copied, to keep the counters together).
+            for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+                objectOffsets[(BATCH_OFFSET_LONG_RANGE_THREADS + level) * n + i] = numLongRangeThreads[level];
+                objectOffsets[(BATCH_OFFSET_LONG_RANGE_CONSTRAINTS + level) * n + i] = numLongRangeConstraints + source.longRangeLevelOffsets[level];
+                if (level < source.numLongRangeLevels) {
+                    numLongRangeThreads[level] += source.longRangeLevelOffsets[level + 1] - source.longRangeLevelOffsets[level];
+                }
+            }
+            numLongRangeConstraints += source.longRangeLevelOffsets[LONG_RANGE_LEVELS];
+
+            objectParams[i] = source.params;
+        }
+
+        for (int axis = 0; axis < 3; ++axis) {
+            ensureCapacity<int>(faceConstraintIndexBuffers[axis], 2 * numFaceThreads[axis], &faceConstraintIndicesUAVs[axis], nullptr);
+            ensureCapacity<float>(faceConstraintLimitsBuffers[axis], 2 * numFaceThreads[axis], nullptr, &faceConstraintLimitsSRVs[axis]);
+            ensureCapacity<uint>(faceIdxToLRConstraintBuffers[axis], LONG_RANGE_SLOTS_PER_FACE * numFaceThreads[axis], nullptr, &faceIdxToLRConstraintSRVs[axis]);
+        }
+        ensureCapacity<uint>(longRangeParticleIndicesBuffer, 8 * numLongRangeConstraints, &longRangeParticleIndicesUAV, &longRangeParticleIndicesSRV);
+        uploadTable(objectOffsets, objectOffsetsBuffer, objectOffsetsSRV);
+        uploadTable(objectParams, objectParamsBuffer, objectParamsSRV);
+
+        uint firstLongRangeConstraint = 0;
+        for (uint i = 0; i < n; ++i) {
+            const BatchedObjectSource& source = sources[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                uint numConstraints = source.numFaceConstraints[axis];
+                if (numConstraints == 0) continue;
+
+                uint firstConstraint = objectOffsets[(BATCH_OFFSET_FACE_CONSTRAINTS + axis) * n + i];
+                DirectX::copyBufferSubregion<int>(source.faceConstraintIndexBuffers[axis], faceConstraintIndexBuffers[axis], 0, 2 * firstConstraint, 2 * numConstraints);
+                DirectX::copyBufferSubregion<float>(source.faceConstraintLimitsBuffers[axis], faceConstraintLimitsBuffers[axis], 0, 2 * firstConstraint, 2 * numConstraints);
+                DirectX::copyBufferSubregion<uint>(source.faceIdxToLRConstraintBuffers[axis], faceIdxToLRConstraintBuffers[axis], 0,
+                    LONG_RANGE_SLOTS_PER_FACE * firstConstraint, LONG_RANGE_SLOTS_PER_FACE * numConstraints);
+            }
+
+            uint numConstraints = source.longRangeLevelOffsets[LONG_RANGE_LEVELS];
+            if (numConstraints > 0) {
+                DirectX::copyBufferSubregion<uint>(source.longRangeParticleIndicesBuffer, longRangeParticleIndicesBuffer, 0, 8 * firstLongRangeConstraint, 8 * numConstraints);
+            }
+            firstLongRangeConstraint += numConstraints;
+        }
+
+        setPassSize(preVGSPass, totalParticles, n);
+        setPassSize(vgsPass, totalParticles / 8, n);
+        for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+            setPassSize(longRangePass(level), numLongRangeThreads[level], n);
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            setPassSize(facePass(axis), numFaceThreads[axis], n);
+        }
+
+        numObjects = n;
+        return true;
+    }
+
+    // Copies the state the simulation changed over the frame back to the objects gathered from (in the same, sorted, order).
+    void scatter(const std::vector<BatchedObjectSource>& sources) {
+        if (numObjects == 0 || sources.size() != numObjects) return;
+
+        uint firstLongRangeConstraint = 0;
+        for (uint i = 0; i < numObjects; ++i) {
+            const BatchedObjectSource& source = sources[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                uint numConstraints = source.numFaceConstraints[axis];
+                if (numConstraints == 0) continue;
+
+                uint firstConstraint = objectOffsets[(BATCH_OFFSET_FACE_CONSTRAINTS + axis) * numObjects + i];
+                DirectX::copyBufferSubregion<int>(faceConstraintIndexBuffers[axis], source.faceConstraintIndexBuffers[axis], 2 * firstConstraint, 0, 2 * numConstraints);
+            }
+
+            uint numConstraints = source.longRangeLevelOffsets[LONG_RANGE_LEVELS];
+            if (numConstraints > 0) {
+                DirectX::copyBufferSubregion<uint>(longRangeParticleIndicesBuffer, source.longRangeParticleIndicesBuffer, 8 * firstLongRangeConstraint, 0, 8 * numConstraints);
+            }
+            firstLongRangeConstraint += numConstraints;
+        }
+        numObjects = 0;
+    }
+
+    // Same as FaceConstraintsCompute::setFractureEventRecording, except voxel indices are global already.
+    void setFractureEventRecording(
+        bool record,
+        uint substep,
+        const ComPtr<ID3D11UnorderedAccessView>& fractureEventsUAV,
+        const ComPtr<ID3D11UnorderedAccessView>& fractureEventCountUAV
+    ) {
+        this->fractureEventsUAV = fractureEventsUAV;
+        this->fractureEventCountUAV = fractureEventCountUAV;
+        if (!record) substep = 0;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            BatchedPassCB& cbData = passCBData[facePass(axis)];
+            if (cbData.recordFractureEvents == static_cast<uint>(record) && cbData.substep == substep) continue;
+
+            cbData.recordFractureEvents = record;
+            cbData.substep = substep;
+            DirectX::updateConstantBuffer(passCBs[facePass(axis)], cbData);
+        }
+    }
+
+    // One substep of every gathered object
+    void dispatch() override {
+        if (numObjects == 0) return;
+
+        activePass = preVGSPass;
+        ComputeShader::dispatch(numWorkgroups[preVGSPass], preVGSEntryPoint);
+
+        activePass = vgsPass;
+        ComputeShader::dispatch(numWorkgroups[vgsPass], vgsEntryPoint);
+
+        // Levels share particles, and axes are colors of constraints that share none, so each still needs its own dispatch (see the unbatched shaders).
+        for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+            activePass = longRangePass(level);
+            ComputeShader::dispatch(numWorkgroups[activePass], longRangeConstraintsEntryPoint);
+        }
+
+        for (int axis = 0; axis < 3; ++axis) {
+            activePass = facePass(axis);
+            ComputeShader::dispatch(numWorkgroups[activePass]);
+        }
+        activePass = preVGSPass;
+    }
+
+    uint getNumObjects() const {
+        return numObjects;
+    }
+
+private:
+    inline static constexpr int preVGSEntryPoint = IDR_SHADER21;
+    inline static constexpr int vgsEntryPoint = IDR_SHADER22;
+    inline static constexpr int longRangeConstraintsEntryPoint = IDR_SHADER23;
+    inline static constexpr int preVGSPass = 0;
+    inline static constexpr int vgsPass = 1;
+    inline static constexpr int numPasses = 2 + LONG_RANGE_LEVELS + 3;
+    static constexpr int longRangePass(int level) { return 2 + level; }
+    static constexpr int facePass(int axis) { return 2 + LONG_RANGE_LEVELS + axis; }
+
+    int activePass = preVGSPass;
+    uint numObjects = 0; // Gathered for the current frame; 0 outside of one
+    std::array<int, numPasses> numWorkgroups{};
+    std::array<BatchedPassCB, numPasses> passCBData;
+    std::array<ComPtr<ID3D11Buffer>, numPasses> passCBs;
+    std::vector<uint> objectOffsets;
+    std::vector<BatchedObjectParams> objectParams;
+    // Owned resources
+    std::array<ComPtr<ID3D11Buffer>, 3> faceConstraintIndexBuffers;
+    std::array<ComPtr<ID3D11Buffer>, 3> faceConstraintLimitsBuffers;
+    std::array<ComPtr<ID3D11Buffer>, 3> faceIdxToLRConstraintBuffers;
+    std::array<ComPtr<ID3D11UnorderedAccessView>, 3> faceConstraintIndicesUAVs;
+    std::array<ComPtr<ID3D11ShaderResourceView>, 3> faceConstraintLimitsSRVs;
+    std::array<ComPtr<ID3D11ShaderResourceView>, 3> faceIdxToLRConstraintSRVs;
+    ComPtr<ID3D11Buffer> longRangeParticleIndicesBuffer;
+    ComPtr<ID3D11UnorderedAccessView> longRangeParticleIndicesUAV;
+    ComPtr<ID3D11ShaderResourceView> longRangeParticleIndicesSRV;
+    ComPtr<ID3D11Buffer> objectOffsetsBuffer;
+    ComPtr<ID3D11ShaderResourceView> objectOffsetsSRV;
+    ComPtr<ID3D11Buffer> objectParamsBuffer;
+    ComPtr<ID3D11ShaderResourceView> objectParamsSRV;
+    // Passed-in resources (views of the whole global buffers)
+    ComPtr<ID3D11UnorderedAccessView> particlesUAV;
+    ComPtr<ID3D11UnorderedAccessView> oldParticlesUAV;
+    ComPtr<ID3D11UnorderedAccessView> isSurfaceUAV;
+    ComPtr<ID3D11ShaderResourceView> isDraggingSRV;
+    ComPtr<ID3D11UnorderedAccessView> fractureEventsUAV;     // Owned by the FractureEventLog
+    ComPtr<ID3D11UnorderedAccessView> fractureEventCountUAV;
+
+    void bind() override
+    {
+        ID3D11ShaderResourceView* passSRVs[2] = { nullptr, nullptr };
+        ID3D11UnorderedAccessView* passUAVs[7] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+        if (activePass == preVGSPass) {
+            passSRVs[0] = isDraggingSRV.Get();
+            passUAVs[0] = oldParticlesUAV.Get();
+        } else if (activePass >= facePass(0)) {
+            int axis = activePass - facePass(0);
+            passSRVs[0] = faceIdxToLRConstraintSRVs[axis].Get();
+            passSRVs[1] = faceConstraintLimitsSRVs[axis].Get();
+            passUAVs[0] = faceConstraintIndicesUAVs[axis].Get();
+            passUAVs[1] = isSurfaceUAV.Get();
+            passUAVs[2] = longRangeParticleIndicesUAV.Get();
+            passUAVs[5] = fractureEventsUAV.Get();
+            passUAVs[6] = fractureEventCountUAV.Get();
+        } else if (activePass >= longRangePass(0)) {
+            passSRVs[0] = longRangeParticleIndicesSRV.Get();
+        }
+
+        ID3D11ShaderResourceView* srvs[] = { objectOffsetsSRV.Get(), objectParamsSRV.Get(), passSRVs[0], passSRVs[1] };
+        DirectX::getContext()->CSSetShaderResources(0, ARRAYSIZE(srvs), srvs);
+
+        ID3D11UnorderedAccessView* uavs[] = {
+            particlesUAV.Get(), passUAVs[0], passUAVs[1], passUAVs[2], passUAVs[3], passUAVs[4], passUAVs[5], passUAVs[6]
+        };
+        DirectX::getContext()->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
+
+        ID3D11Buffer* cbvs[] = { passCBs[activePass].Get() };
+        DirectX::getContext()->CSSetConstantBuffers(0, ARRAYSIZE(cbvs), cbvs);
+    };
+
+    void unbind() override
+    {
+        ID3D11ShaderResourceView* srvs[] = { nullptr, nullptr, nullptr, nullptr };
+        DirectX::getContext()->CSSetShaderResources(0, ARRAYSIZE(srvs), srvs);
+
+        ID3D11UnorderedAccessView* uavs[] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+        DirectX::getContext()->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
+
+        ID3D11Buffer* cbvs[] = { nullptr };
+        DirectX::getContext()->CSSetConstantBuffers(0, ARRAYSIZE(cbvs), cbvs);
+    };
+
+    void setPassSize(int pass, uint numThreads, uint objectCount) {
+        numWorkgroups[pass] = Utils::divideRoundUp(numThreads, VGS_THREADS);
+
+        BatchedPassCB& cbData = passCBData[pass];
+        if (cbData.numThreads == numThreads && cbData.numObjects == objectCount) return;
+        cbData.numThreads = numThreads;
+        cbData.numObjects = objectCount;
+        DirectX::updateConstantBuffer(passCBs[pass], cbData);
+    }
+
+    // Batch buffers only ever grow (to at least one element, since D3D buffers can't be empty), so a steady scene doesn't reallocate every frame.
+    template<typename T>
+    void ensureCapacity(
+        ComPtr<ID3D11Buffer>& buffer,
+        uint numElements,
+        ComPtr<ID3D11UnorderedAccessView>* uav,
+        ComPtr<ID3D11ShaderResourceView>* srv
+    ) {
+        numElements = std::max(numElements, 1u);
+        if (buffer && static_cast<uint>(DirectX::getNumElementsInBuffer(buffer)) >= numElements) return;
+
+        releaseBuffer(buffer);
+        buffer = DirectX::createReadWriteBuffer(std::vector<T>(numElements));
+        if (uav) *uav = DirectX::createUAV(buffer);
+        if (srv) *srv = DirectX::createSRV(buffer);
+    }
+
+    // The per-object tables are tiny, so they're just re-uploaded every frame (and only reallocated when the number of objects changes).
+    template<typename T>
+    void uploadTable(const std::vector<T>& data, ComPtr<ID3D11Buffer>& buffer, ComPtr<ID3D11ShaderResourceView>& srv) {
+        if (buffer && static_cast<size_t>(DirectX::getNumElementsInBuffer(buffer)) == data.size()) {
+            DirectX::copyVectorToBuffer(data, buffer);
+            return;
+        }
+
+        releaseBuffer(buffer);
+        buffer = DirectX::createReadWriteBuffer(data);
+        srv = DirectX::createSRV(buffer);
+    }
+
+    static void releaseBuffer(ComPtr<ID3D11Buffer>& buffer) {
+        if (!buffer) return;
+        DirectX::notifyMayaOfMemoryUsage(buffer);
+        buffer.Reset();
+    }
+};
@@ -43,6 +43,10 @@ public:
         return particleCollisionCBData.hashGridSize;
     }
 
+    const ParticleCollisionCB& getParticleCollisionConstants() const {
+        return particleCollisionCBData;
+    }
+
     void setParticlesSRV(const ComPtr<ID3D11ShaderResourceView>& particlesSRV) {
         this->particlesSRV = particlesSRV;
     }
@@ -5,6 +5,7 @@
 #include "../../resource.h"
 #include "../directx.h"
 #include <unordered_map>
+#include <cstdint>
 #include "../../utils.h"
 #include "simulationcache.h"
 using Microsoft::WRL::ComPtr;
@@ -32,8 +33,14 @@ public:
         bind();
         DirectX::getContext()->Dispatch(threadGroupCount, 1, 1); 
         unbind();
+        ++numDispatches;
     };
 
+    // Dispatches issued by all compute shaders so far, for profiling (e.g. per-frame overhead in BenchmarkSimulationCommand).
+    static uint64_t getNumDispatches() {
+        return numDispatches;
+    }
+
     static void clearShaderCache() {
         shaderCache.clear();
     }
@@ -80,6 +87,7 @@ private:
     // Cache of created shaders to avoid loading the same shader multiple times,
     // as multiple instances of the same shader may be used across different nodes.
     inline static std::unordered_map<int, ComPtr<ID3D11ComputeShader>> shaderCache;
+    inline static uint64_t numDispatches = 0;
     // The registrations are tied to the lifetime of this compute shader instance.
     // When the compute shader is destroyed, these registrations are destroyed,
     // and the buffers are automatically unregistered from the simulation cache.
@@ -1,13 +1,14 @@
 #pragma once
 
 #include "directx/compute/computeshader.h"
+#include "cpu/vertexdeform.h"
 #include <maya/MFnMesh.h>
 #include <maya/MDagPath.h>
 #include <maya/MFloatPointArray.h>
 #include <maya/MFloatVectorArray.h>
+#include <maya/MThreadPool.h>
 
 struct DeformVerticesConstantBuffer {
-    float gridRotationInverse[4][4];
     int vertexCount;
     int padding[3]; // Padding to align to 16 bytes
 };
@@ -20,24 +21,22 @@ public:
         int numParticles,
         int vertexCount,
         const MMatrix& gridRotationInverse,
-        const std::vector<Particle>& originalParticles,             // Will be uploaded to GPU
-        const std::vector<uint>& vertexVoxelIds,                    // Will be uploaded to GPU
+        const std::vector<Particle>& originalParticles,
+        const std::vector<uint>& vertexVoxelIds,
         const ComPtr<ID3D11UnorderedAccessView>& positionsUAV,
         const ComPtr<ID3D11UnorderedAccessView>& normalsUAV,
-        const ComPtr<ID3D11ShaderResourceView>& originalVertPositionsSRV,
-        const ComPtr<ID3D11ShaderResourceView>& originalNormalsSRV,
+        const ComPtr<ID3D11ShaderResourceView>& originalVertPositionsSRV, // Only read once, to bind the vertices to their voxels
+        const ComPtr<ID3D11ShaderResourceView>& originalNormalsSRV,       // Same
         const ComPtr<ID3D11ShaderResourceView>& particlesSRV,
         const std::vector<uint>& exportVertexIdMap
     ) : ComputeShader(IDR_SHADER1), positionsUAV(positionsUAV), normalsUAV(normalsUAV), 
-                                    originalVertPositionsSRV(originalVertPositionsSRV), originalNormalsSRV(originalNormalsSRV), 
                                     particlesSRV(particlesSRV), exportVertexIdMap(invertExportVertexIdMap(exportVertexIdMap))
     {
-        initializeBuffers(numParticles, vertexCount, gridRotationInverse, originalParticles, vertexVoxelIds);
+        initializeBuffers(numParticles, vertexCount, gridRotationInverse, originalParticles, vertexVoxelIds, originalVertPositionsSRV, originalNormalsSRV);
     }
 
     void reset() override {
-        DirectX::notifyMayaOfMemoryUsage(originalParticlesBuffer);
-        DirectX::notifyMayaOfMemoryUsage(vertexVoxelIdsBuffer);
+        DirectX::notifyMayaOfMemoryUsage(vertexBindingsBuffer);
     }
 
     void dispatch() override
@@ -54,18 +53,23 @@ public:
      * Copies the deformed vertex positions and normals to the given mesh. 
      * The mesh must have the same number of verts/normals as used to create this compute shader.
      * This is primarily intended for exporting the deformed geometry to Alembic, which doesn't support custom shapes.
+     *
+     * Rather than reading back the deformed vertex buffers, this reads back the particles (8 per voxel, typically far fewer than the vertices)
+     * and deforms the vertices on the CPU (see VertexDeform).
      */
     void copyGeometryDataToMesh(const MDagPath& meshDagPath) {
         MFnMesh meshFn(meshDagPath);
         MStatus status;
 
-        const ComPtr<ID3D11Buffer>& positionsBuffer = DirectX::getBufferFromView(positionsUAV);
-        const ComPtr<ID3D11Buffer>& normalsBuffer = DirectX::getBufferFromView(normalsUAV);
+        std::vector<Particle> particles;
+        DirectX::copyBufferToVector(DirectX::getBufferFromView(particlesSRV), particles);
 
         // Need a vector for positions (see note below about logical vs. extracted vertices)
-        std::vector<float> positionData;
-        DirectX::copyBufferToVector(positionsBuffer, positionData);
-        DirectX::copyBufferToPointer(normalsBuffer, (void*)meshFn.getRawNormals(&status));
+        std::vector<float> positionData(vertexBindings.size() * 3);
+        float* rawNormals = const_cast<float*>(meshFn.getRawNormals(&status));
+        MThreadPool::init();
+        VertexDeform::deform(vertexBindings, particles, positionData.data(), rawNormals);
+        MThreadPool::release(); // reduce reference count incurred by init()
 
         // The extracted vertex data has redundant vertices, split by normals and UVs, etc. The MFnMesh only wants logical vertices.
         // So we need to use the exportVertexIdMap to map from one scheme to the other. The positions of the redundant vertices are identical.
@@ -85,20 +89,16 @@ public:
 private:
     int numWorkgroups = 0;
     std::vector<uint> exportVertexIdMap;
+    std::vector<VertexBinding> vertexBindings; // Host copy, for deforming on the CPU when exporting
 
     // Inputs
     ComPtr<ID3D11UnorderedAccessView> positionsUAV;
     ComPtr<ID3D11UnorderedAccessView> normalsUAV;
-    ComPtr<ID3D11ShaderResourceView> originalVertPositionsSRV;
-    ComPtr<ID3D11ShaderResourceView> originalNormalsSRV;
     ComPtr<ID3D11ShaderResourceView> particlesSRV;
 
     // Created and owned by this class
-    ComPtr<ID3D11Buffer> originalParticlesBuffer;
-    ComPtr<ID3D11ShaderResourceView> originalParticlesSRV;
-
-    ComPtr<ID3D11Buffer> vertexVoxelIdsBuffer;
-    ComPtr<ID3D11ShaderResourceView> vertexVoxelIdsSRV;
+    ComPtr<ID3D11Buffer> vertexBindingsBuffer;
+    ComPtr<ID3D11ShaderResourceView> vertexBindingsSRV;
 
     ComPtr<ID3D11Buffer> constantsBuffer;
     
@@ -110,7 +110,7 @@ private:
         UINT zeroOffsets[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT] = {};
         DirectX::getContext()->IASetVertexBuffers(0, D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT, nullVBs, zeroStrides, zeroOffsets);
 
-        ID3D11ShaderResourceView* srvs[] = { originalVertPositionsSRV.Get(), originalNormalsSRV.Get(), originalParticlesSRV.Get(), particlesSRV.Get(), vertexVoxelIdsSRV.Get() };
+        ID3D11ShaderResourceView* srvs[] = { particlesSRV.Get(), vertexBindingsSRV.Get() };
         DirectX::getContext()->CSSetShaderResources(0, ARRAYSIZE(srvs), srvs);
 
         ID3D11UnorderedAccessView* uavs[] = { positionsUAV.Get(), normalsUAV.Get() };
@@ -122,7 +122,7 @@ private:
 
     void unbind() override
     {
-        ID3D11ShaderResourceView* nullSRVs[] = { nullptr, nullptr, nullptr, nullptr, nullptr };
+        ID3D11ShaderResourceView* nullSRVs[] = { nullptr, nullptr };
         DirectX::getContext()->CSSetShaderResources(0, ARRAYSIZE(nullSRVs), nullSRVs);
 
         ID3D11UnorderedAccessView* nullUAVs[] = { nullptr, nullptr };
@@ -132,25 +132,43 @@ private:
         DirectX::getContext()->CSSetConstantBuffers(0, ARRAYSIZE(nullConstBuffers), nullConstBuffers);
     };
 
-    void initializeBuffers(int numParticles, int vertexCount, const MMatrix& gridRotationInverse, const std::vector<Particle>& originalParticles, const std::vector<uint>& vertexVoxelIds)
-    {
+    /**
+     * Binds each vertex to its voxel once, up front: its trilinear coordinates and normal in the voxel's rest frame never change,
+     * so the deform pass (and VertexDeform on the CPU) only has to read them, instead of the rest positions, rest normals, and rest particles.
+     */
+    void initializeBuffers(
+        int numParticles,
+        int vertexCount,
+        const MMatrix& gridRotationInverse,
+        const std::vector<Particle>& originalParticles,
+        const std::vector<uint>& vertexVoxelIds,
+        const ComPtr<ID3D11ShaderResourceView>& originalVertPositionsSRV,
+        const ComPtr<ID3D11ShaderResourceView>& originalNormalsSRV
+    ) {
         numWorkgroups = Utils::divideRoundUp(vertexCount, DEFORM_VERTICES_THREADS);
 
-        // We only need one reference particle per voxel, not the whole shebang
-        std::vector<Particle> reducedOriginalParticles;
-        reducedOriginalParticles.reserve(numParticles / 8);
-        for (int i = 0; i < numParticles; i += 8) {
-            reducedOriginalParticles.push_back(originalParticles[i]);
+        std::vector<float> originalVertPositions;
+        std::vector<float> originalNormals;
+        DirectX::copyBufferToVector(DirectX::getBufferFromView(originalVertPositionsSRV), originalVertPositions);
+        DirectX::copyBufferToVector(DirectX::getBufferFromView(originalNormalsSRV), originalNormals);
+
+        vertexBindings.resize(vertexCount);
+        for (int i = 0; i < vertexCount; ++i) {
+            uint voxelId = vertexVoxelIds[i];
+            if (voxelId == UINT_MAX || static_cast<int>(voxelId) >= numParticles / 8) {
+                vertexBindings[i] = { UINT_MAX, 0, 0, 0 };
+                continue;
+            }
+
+            MFloatVector restPosition(originalVertPositions[i * 3], originalVertPositions[i * 3 + 1], originalVertPositions[i * 3 + 2]);
+            MFloatVector restNormal(originalNormals[i * 3], originalNormals[i * 3 + 1], originalNormals[i * 3 + 2]);
+            vertexBindings[i] = VertexDeform::bindVertex(voxelId, restPosition, restNormal, originalParticles[voxelId << 3], gridRotationInverse);
         }
 
-        originalParticlesBuffer = DirectX::createReadOnlyBuffer<Particle>(reducedOriginalParticles);
-        originalParticlesSRV = DirectX::createSRV(originalParticlesBuffer);
-
-        vertexVoxelIdsBuffer = DirectX::createReadOnlyBuffer<uint>(vertexVoxelIds);
-        vertexVoxelIdsSRV = DirectX::createSRV(vertexVoxelIdsBuffer);
+        vertexBindingsBuffer = DirectX::createReadOnlyBuffer<VertexBinding>(vertexBindings);
+        vertexBindingsSRV = DirectX::createSRV(vertexBindingsBuffer);
        
         DeformVerticesConstantBuffer constants = {};
-        gridRotationInverse.get(constants.gridRotationInverse);
         constants.vertexCount = vertexCount;
         constantsBuffer = DirectX::createConstantBuffer<DeformVerticesConstantBuffer>(constants);
     }
@@ -11,9 +11,9 @@ struct FaceConstraintsCB {
     int faceTwoId;
     float constraintLow;
     float constraintHigh;
-    int padding0;
-    int padding1;
-    int padding2;
+    uint substep;
+    uint voxelOffset;
+    uint recordFractureEvents;
 };
 
 struct FaceConstraints {
@@ -32,7 +32,7 @@ public:
 
     FaceConstraintsCompute(
         const std::array<FaceConstraints, 3>& faceConstraints,
-        const std::array<std::vector<uint>, 3>& faceIdxToLongRangeConstraintIndices,
+        const std::array<ComPtr<ID3D11UnorderedAccessView>, 3>& longRangeConstraintIndicesUAVs, // Read only, so may be shared with other objects (see ConstraintTopology)
         uint numParticles,
         float particleRadius,
         float voxelRestVolume
@@ -42,7 +42,8 @@ public:
         loadShaderObject(updateFaceConstraintsEntryPoint);
         loadShaderObject(mergeRenderParticlesEntryPoint);
         loadShaderObject(expandRenderParticlesEntryPoint);
-        initializeBuffers(faceConstraints, faceIdxToLongRangeConstraintIndices, numParticles, particleRadius, voxelRestVolume);
+        this->longRangeConstraintIndicesUAVs = longRangeConstraintIndicesUAVs;
+        initializeBuffers(faceConstraints, numParticles, particleRadius, voxelRestVolume);
         numExpandParticlesWorkgroups = Utils::divideRoundUp(numParticles / 8, VGS_THREADS);
     };
 
@@ -50,7 +51,6 @@ public:
         for (int i = 0; i < 3; i++) {
             DirectX::notifyMayaOfMemoryUsage(faceConstraintIndexBuffers[i]);
             DirectX::notifyMayaOfMemoryUsage(faceConstraintLimitsBuffers[i]);
-            DirectX::notifyMayaOfMemoryUsage(longRangeConstraintIndicesBuffers[i]);
             DirectX::notifyMayaOfMemoryUsage(faceConstraintsCBs[i]);
         }
     }
@@ -59,6 +59,7 @@ public:
     {
         extraUAVs[0] = longRangeConstraintCountersUAV;
 
+        // Each axis is one color of constraints that share no particles, so each dispatch is free of races and the next one sees its results.
         for (activeConstraintAxis = 0; activeConstraintAxis < 3; activeConstraintAxis++) {
             extraUAVs[1] = longRangeConstraintIndicesUAVs[activeConstraintAxis];
             ComputeShader::dispatch(numWorkgroups[activeConstraintAxis]);
@@ -100,12 +101,14 @@ public:
         float relaxation,
         float edgeUniformity,
         uint iterCount,
-        float compliance
+        float compliance,
+        float chebyshevRho
     ) {
         vgsConstants.relaxation = relaxation;
         vgsConstants.edgeUniformity = edgeUniformity;
         vgsConstants.iterCount = iterCount;
         vgsConstants.compliance = compliance;
+        vgsConstants.chebyshevRho = chebyshevRho;
         DirectX::updateConstantBuffer(vgsConstantBuffer, vgsConstants);
     }
 
@@ -121,10 +124,58 @@ public:
         this->renderParticlesUAV = renderParticlesUAV;
     }
 
+    // Where (and whether) the face constraint pass appends an event for each constraint it breaks (see FractureEventLog).
+    // The constant buffers are only touched when something changed, so this costs nothing per substep unless recording.
+    void setFractureEventRecording(
+        bool record,
+        uint substep,
+        uint voxelOffset,
+        const ComPtr<ID3D11UnorderedAccessView>& fractureEventsUAV,
+        const ComPtr<ID3D11UnorderedAccessView>& fractureEventCountUAV
+    ) {
+        this->fractureEventsUAV = fractureEventsUAV;
+        this->fractureEventCountUAV = fractureEventCountUAV;
+        if (!record) substep = 0;
+
+        for (int i = 0; i < 3; i++) {
+            FaceConstraintsCB& cbData = faceConstraintsCBData[i];
+            if (cbData.recordFractureEvents == static_cast<uint>(record) && cbData.substep == substep && cbData.voxelOffset == voxelOffset) continue;
+
+            cbData.recordFractureEvents = record;
+            cbData.substep = substep;
+            cbData.voxelOffset = voxelOffset;
+            DirectX::updateConstantBuffer(faceConstraintsCBs[i], cbData);
+        }
+    }
+
+    // The object's own copies, for the batched passes to gather from and scatter back to (see BatchedConstraintsCompute).
+    const std::array<ComPtr<ID3D11Buffer>, 3>& getFaceConstraintIndexBuffers() const {
+        return faceConstraintIndexBuffers;
+    }
+
+    const std::array<ComPtr<ID3D11Buffer>, 3>& getFaceConstraintLimitsBuffers() const {
+        return faceConstraintLimitsBuffers;
+    }
+
     void setLongRangeConstraintCountersUAV(const ComPtr<ID3D11UnorderedAccessView>& longRangeConstraintCountersUAV) {
         this->longRangeConstraintCountersUAV = longRangeConstraintCountersUAV;
     }
 
+    // Round trip of the constraint state for the CPU backend. Limits only ever change from paint (on the GPU), so they're only copied down.
+    void copyConstraintsToHost(std::array<FaceConstraints, 3>& faceConstraints) const {
+        for (int i = 0; i < 3; i++) {
+            if (!faceConstraintIndexBuffers[i]) continue;
+            DirectX::copyBufferToVector(faceConstraintIndexBuffers[i], faceConstraints[i].voxelIndices);
+            DirectX::copyBufferToVector(faceConstraintLimitsBuffers[i], faceConstraints[i].limits);
+        }
+    }
+
+    void copyConstraintIndicesFromHost(const std::array<FaceConstraints, 3>& faceConstraints) {
+        for (int i = 0; i < 3; i++) {
+            DirectX::copyVectorToBuffer(faceConstraints[i].voxelIndices, faceConstraintIndexBuffers[i]);
+        }
+    }
+
 private:
     inline static constexpr int updateFaceConstraintsEntryPoint = IDR_SHADER5;
     inline static constexpr int mergeRenderParticlesEntryPoint = IDR_SHADER16;
@@ -133,7 +184,7 @@ private:
     std::array<int, 3> numWorkgroups = { 0, 0, 0 };
     int numExpandParticlesWorkgroups = 0;
     // UAVs that get bound depending on which entry point is being dispatched
-    // There are 4 shared UAVs, and up to 2 extra UAVs that may get set. Note that Maya's version of DX11 only supports up to 8 UAVs bound at once.
+    // There are 4 shared UAVs, up to 2 extra UAVs that may get set, and the 2 fracture event UAVs. Note that Maya's version of DX11 only supports up to 8 UAVs bound at once.
     std::array<ComPtr<ID3D11UnorderedAccessView>, 2> extraUAVs;
     std::array<FaceConstraintsCB, 3> faceConstraintsCBData;
     std::array<ComPtr<ID3D11UnorderedAccessView>, 3> faceConstraintIndicesUAVs;
@@ -142,7 +193,6 @@ private:
     std::array<ComPtr<ID3D11Buffer>, 3> faceConstraintsCBs;
     std::array<ComPtr<ID3D11Buffer>, 3> faceConstraintIndexBuffers;
     std::array<ComPtr<ID3D11Buffer>, 3> faceConstraintLimitsBuffers;
-    std::array<ComPtr<ID3D11Buffer>, 3> longRangeConstraintIndicesBuffers;
     VGSConstants vgsConstants;
     ComPtr<ID3D11Buffer> vgsConstantBuffer;
     ComPtr<ID3D11UnorderedAccessView> isSurfaceUAV;
@@ -151,12 +201,14 @@ private:
     ComPtr<ID3D11UnorderedAccessView> paintValueUAV;  // Only used during update from paint values
     ComPtr<ID3D11UnorderedAccessView> renderParticlesUAV; // A copy of the particles that can be adjusted (i.e. close particle gaps) for rendering (without affecting simulation).
     ComPtr<ID3D11UnorderedAccessView> longRangeConstraintCountersUAV;
+    ComPtr<ID3D11UnorderedAccessView> fractureEventsUAV;     // Owned by the FractureEventLog
+    ComPtr<ID3D11UnorderedAccessView> fractureEventCountUAV;
 
     void bind() override
     {
         ID3D11UnorderedAccessView* uavs[] = { 
             particlesUAV.Get(), faceConstraintIndicesUAVs[activeConstraintAxis].Get(),  faceConstraintLimitsUAVs[activeConstraintAxis].Get(), isSurfaceUAV.Get(),
-            extraUAVs[0].Get(), extraUAVs[1].Get()
+            extraUAVs[0].Get(), extraUAVs[1].Get(), fractureEventsUAV.Get(), fractureEventCountUAV.Get()
         };
         DirectX::getContext()->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
 
@@ -166,7 +218,7 @@ private:
 
     void unbind() override
     {
-        ID3D11UnorderedAccessView* uavs[] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+        ID3D11UnorderedAccessView* uavs[] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
         DirectX::getContext()->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
 
         ID3D11Buffer* cbvs[] = { nullptr, nullptr };
@@ -181,7 +233,7 @@ private:
         }
     };
     
-    void initializeBuffers(const std::array<FaceConstraints, 3>& faceConstraints, const std::array<std::vector<uint>, 3>& faceIdxToLongRangeConstraintIndices, uint numParticles, float particleRadius, float voxelRestVolume) {
+    void initializeBuffers(const std::array<FaceConstraints, 3>& faceConstraints, uint numParticles, float particleRadius, float voxelRestVolume) {
 
         vgsConstants.relaxation = 0.5f;
         vgsConstants.edgeUniformity = 1.0f;
@@ -190,6 +242,7 @@ private:
         vgsConstants.particleRadius = particleRadius;
         vgsConstants.voxelRestVolume = voxelRestVolume;
         vgsConstants.compliance = 0;
+        vgsConstants.chebyshevRho = 0;
         vgsConstantBuffer = DirectX::createConstantBuffer<VGSConstants>(vgsConstants);
 
         // Order of vertex indices and face IDs corresponds to definitions in cube.h
@@ -206,8 +259,6 @@ private:
             faceConstraintIndicesUAVs[i] = DirectX::createUAV(faceConstraintIndexBuffers[i]);
             faceConstraintLimitsUAVs[i] = DirectX::createUAV(faceConstraintLimitsBuffers[i]);
             faceConstraintsCBs[i] = DirectX::createConstantBuffer<FaceConstraintsCB>(faceConstraintsCBData[i]);
-            longRangeConstraintIndicesBuffers[i] = DirectX::createReadWriteBuffer(faceIdxToLongRangeConstraintIndices[i]);
-            longRangeConstraintIndicesUAVs[i] = DirectX::createUAV(longRangeConstraintIndicesBuffers[i]);
             // The indices get cached because they can change when face constraints are broken (set to -1)
             registerBufferForCaching(faceConstraintIndexBuffers[i]);
         }
@@ -1,16 +1,33 @@
 #pragma once
 
 #include "directx/compute/computeshader.h"
+#include <array>
+#include <algorithm>
 
 struct LongRangeConstraints {
-    // Each group of 8 consecutive indices corresponds to one voxel's long-range constraint particles
+    // Each group of 8 consecutive indices corresponds to one voxel block's long-range constraint particles, finest level first
     std::vector<uint> particleIndices;
+    // Index of the first constraint of each level (and the total, at the end)
+    std::array<uint, LONG_RANGE_LEVELS + 1> levelOffsets{};
+    // LONG_RANGE_SLOTS_PER_FACE per face constraint
     std::array<std::vector<uint>, 3> faceIdxToLRConstraintIndices;
+
+    // Width, in voxels, of the blocks a level's constraints treat as one big voxel. Level 0 has one (overlapping) block per voxel;
+    // coarser levels only use blocks aligned to their size, which stiffen larger structures with a single constraint.
+    static uint blockSize(int level) {
+        return 2u << level;
+    }
+
+    // A block's constraint particles are the ones at its outer corners. For a block n voxels wide, their centers are (4n - 2) particle radii apart,
+    // so it acts like a voxel with particles (2n - 1) times as big. (So 3x at level 0 - draw it out :))
+    static float particleRadiusScale(int level) {
+        return 2.0f * blockSize(level) - 1.0f;
+    }
 };
 
 struct LongRangeConstraintsCB {
     uint numConstraints{0};
-    uint padding0{0};
+    uint firstConstraint{0};
     uint padding1{0};
     uint padding2{0};
 };
@@ -32,11 +49,23 @@ public:
 
     void reset() override {
         DirectX::notifyMayaOfMemoryUsage(longRangeParticleIndicesBuffer, false);
-        DirectX::notifyMayaOfMemoryUsage(longRangeConstraintsCB, false);
+        for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+            DirectX::notifyMayaOfMemoryUsage(longRangeConstraintsCBs[level], false);
+            DirectX::notifyMayaOfMemoryUsage(vgsConstantsCBs[level], false);
+        }
     }
 
     void dispatch() override {
-        ComputeShader::dispatch(numWorkgroups);
+        // Levels share particles (a block's corner particles are also in finer blocks), so they're solved one after another.
+        for (activeLevel = 0; activeLevel < numActiveLevels; ++activeLevel) {
+            ComputeShader::dispatch(numWorkgroups[activeLevel]);
+        }
+        activeLevel = 0;
+    }
+
+    // How many levels of long-range constraints to solve, finest first (the rest are still built, just skipped).
+    void setNumActiveLevels(int numActiveLevels) {
+        this->numActiveLevels = std::clamp(numActiveLevels, 1, LONG_RANGE_LEVELS);
     }
 
     // This is hijacked by the FaceConstraintsCompute shader as a counter for number of broken face constraints
@@ -45,30 +74,51 @@ public:
         return longRangeParticleIndicesUAV;
     }
 
+    const ComPtr<ID3D11Buffer>& getLongRangeParticleIndicesBuffer() const {
+        return longRangeParticleIndicesBuffer;
+    }
+
     void setParticlesUAV(const ComPtr<ID3D11UnorderedAccessView>& uav) {
         particlesUAV = uav;
     }
 
+    // Round trip of the particle indices (and the broken face constraint counters packed into them) for the CPU backend.
+    void copyParticleIndicesToHost(std::vector<uint>& particleIndices) const {
+        if (!longRangeParticleIndicesBuffer) return;
+        DirectX::copyBufferToVector(longRangeParticleIndicesBuffer, particleIndices);
+    }
+
+    void copyParticleIndicesFromHost(const std::vector<uint>& particleIndices) {
+        DirectX::copyVectorToBuffer(particleIndices, longRangeParticleIndicesBuffer);
+    }
+
     void updateVGSParameters(
         float vgsRelaxation,
         float vgsEdgeUniformity,
         uint vgsIterations,
-        float compliance
+        float compliance,
+        float chebyshevRho
     ) {
-        vgsConstants.relaxation = vgsRelaxation;
-        vgsConstants.edgeUniformity = vgsEdgeUniformity;
-        vgsConstants.iterCount = vgsIterations;
-        vgsConstants.compliance = compliance;
-        DirectX::updateConstantBuffer(vgsConstantsCB, vgsConstants);
+        for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+            VGSConstants& vgsConstants = levelVGSConstants[level];
+            vgsConstants.relaxation = vgsRelaxation;
+            vgsConstants.edgeUniformity = vgsEdgeUniformity;
+            vgsConstants.iterCount = vgsIterations;
+            vgsConstants.compliance = compliance;
+            vgsConstants.chebyshevRho = chebyshevRho;
+            DirectX::updateConstantBuffer(vgsConstantsCBs[level], vgsConstants);
+        }
     }
 
 private:
-    int numWorkgroups = 0;
-    VGSConstants vgsConstants;
+    int activeLevel = 0;
+    int numActiveLevels = 1;
+    std::array<int, LONG_RANGE_LEVELS> numWorkgroups{};
+    std::array<VGSConstants, LONG_RANGE_LEVELS> levelVGSConstants;
     // Owned resources
     ComPtr<ID3D11Buffer> longRangeParticleIndicesBuffer;
-    ComPtr<ID3D11Buffer> longRangeConstraintsCB;
-    ComPtr<ID3D11Buffer> vgsConstantsCB;
+    std::array<ComPtr<ID3D11Buffer>, LONG_RANGE_LEVELS> longRangeConstraintsCBs;
+    std::array<ComPtr<ID3D11Buffer>, LONG_RANGE_LEVELS> vgsConstantsCBs;
     ComPtr<ID3D11ShaderResourceView> longRangeParticleIndicesSRV;
     ComPtr<ID3D11UnorderedAccessView> longRangeParticleIndicesUAV;
     // Passed-in resources
@@ -82,7 +132,7 @@ private:
         ID3D11UnorderedAccessView* uavs[] = { particlesUAV.Get() };
         DirectX::getContext()->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
 
-        ID3D11Buffer* cbvs[] = { longRangeConstraintsCB.Get(), vgsConstantsCB.Get() };
+        ID3D11Buffer* cbvs[] = { longRangeConstraintsCBs[activeLevel].Get(), vgsConstantsCBs[activeLevel].Get() };
         DirectX::getContext()->CSSetConstantBuffers(0, ARRAYSIZE(cbvs), cbvs);
     };
 
@@ -99,29 +149,34 @@ private:
     };
 
     void initializeBuffers(uint numParticles, float particleRadius, float voxelRestVolume, const LongRangeConstraints& constraints) {
-        uint numConstraints = static_cast<uint>(constraints.particleIndices.size() / 8);
-        numWorkgroups = Utils::divideRoundUp(numConstraints, VGS_THREADS);
-
         longRangeParticleIndicesBuffer = DirectX::createReadWriteBuffer(constraints.particleIndices);
         longRangeParticleIndicesSRV = DirectX::createSRV(longRangeParticleIndicesBuffer);
         longRangeParticleIndicesUAV = DirectX::createUAV(longRangeParticleIndicesBuffer);
         // Must be considered for caching because the lower bits store the broken face constraint counts, which change (unlike the constraint indices themselves).
         // (TODO: consider the tradeoff here: smaller simulation state storage but means more data gets to be cached, when caching is enabled. Basically GPU memory vs CPU memory tradeoff.)
         registerBufferForCaching(longRangeParticleIndicesBuffer);
-        
-        longRangeConstraintsCB = DirectX::createConstantBuffer<LongRangeConstraintsCB>({ numConstraints, 0, 0, 0 });
-
-        // Defaults
-        vgsConstants.relaxation = 0.5f;
-        vgsConstants.edgeUniformity = 1.0f;
-        vgsConstants.iterCount = 3;
-        vgsConstants.numVoxels = numParticles / 8;
-        vgsConstants.compliance = 0;
-
-        // These two values get fudged a bit. Long range constraints treat 2x2x2 groups of voxels as a one voxel.
-        // So the effective particle radius is **tripled** (not doubled - draw it out :)), and the rest volume is adjusted accordingly.
-        vgsConstants.particleRadius = particleRadius * 3.0f;
-        vgsConstants.voxelRestVolume = voxelRestVolume * (216.0f / 8.0f);
-        vgsConstantsCB = DirectX::createConstantBuffer<VGSConstants>(vgsConstants);
+
+        for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+            uint firstConstraint = constraints.levelOffsets[level];
+            uint numConstraints = constraints.levelOffsets[level + 1] - firstConstraint;
+            numWorkgroups[level] = Utils::divideRoundUp(numConstraints, VGS_THREADS);
+            longRangeConstraintsCBs[level] = DirectX::createConstantBuffer<LongRangeConstraintsCB>({ numConstraints, firstConstraint, 0, 0 });
+
+            // Defaults
+            VGSConstants& vgsConstants = levelVGSConstants[level];
+            vgsConstants.relaxation = 0.5f;
+            vgsConstants.edgeUniformity = 1.0f;
+            vgsConstants.iterCount = 3;
+            vgsConstants.numVoxels = numParticles / 8;
+            vgsConstants.compliance = 0;
+            vgsConstants.chebyshevRho = 0;
+
+            // These two values get fudged a bit: each block of voxels is treated as one voxel, with bigger particles (see LongRangeConstraints),
+            // and the rest volume is adjusted accordingly.
+            float radiusScale = LongRangeConstraints::particleRadiusScale(level);
+            vgsConstants.particleRadius = particleRadius * radiusScale;
+            vgsConstants.voxelRestVolume = voxelRestVolume * radiusScale * radiusScale * radiusScale;
+            vgsConstantsCBs[level] = DirectX::createConstantBuffer<VGSConstants>(vgsConstants);
+        }
     };
 };
\ No newline at end of file
@@ -1,10 +1,16 @@
 #pragma once
 
 #include "directx/compute/computeshader.h"
+#include <algorithm>
+#include <array>
 
 /**
  * The workhorse of voxel collisions. Following broadphase presteps (building a dense array of particle indices sorted by grid cell),
  * this shader resolves collisions between particles in the same grid cell in a pairwise fashion.
+ *
+ * Cells are cached in shared memory; any that don't fit are solved from global memory instead (slower, but no collisions are dropped).
+ * The shader counts those overflowing cells and their particles, accumulating until resetOverflowCounts, so the slow path shows up in the stats.
+ * The counts come back through a small ring of staging buffers, a frame or two behind, so reading them never stalls on the GPU.
  */
 class SolveCollisionsCompute : public ComputeShader
 {
@@ -23,6 +29,16 @@ public:
     {
         if (hashGridSize <= 0) return;
         numWorkgroups = Utils::divideRoundUp(hashGridSize, SOLVE_COLLISION_THREADS);
+
+        overflowCountsBuffer = DirectX::createReadWriteBuffer(std::vector<uint>(2, 0));
+        overflowCountsUAV = DirectX::createUAV(overflowCountsBuffer);
+        for (ComPtr<ID3D11Buffer>& stagingBuffer : overflowCountsStagingBuffers) {
+            stagingBuffer = DirectX::createStagingBuffer(2 * sizeof(uint));
+        }
+    }
+
+    void reset() override {
+        if (overflowCountsBuffer) DirectX::notifyMayaOfMemoryUsage(overflowCountsBuffer);
     }
 
     void dispatch() override {
@@ -37,6 +53,31 @@ public:
         this->oldParticlesSRV = oldParticlesSRV;
     }
 
+    void resetOverflowCounts() {
+        if (overflowCountsUAV) DirectX::clearUintBuffer(overflowCountsUAV);
+    }
+
+    // Snapshots the counts accumulated since the last resetOverflowCounts (summed over every dispatch in between), once the GPU gets there.
+    // Call after queueing the frame's dispatches. If the GPU falls more than a ring's worth of frames behind, the oldest snapshot is dropped.
+    void queueOverflowCountsReadback() {
+        if (!overflowCountsBuffer) return;
+        DirectX::getContext()->CopyResource(overflowCountsStagingBuffers[nextStagingBuffer].Get(), overflowCountsBuffer.Get());
+        nextStagingBuffer = (nextStagingBuffer + 1) % numStagingBuffers;
+        numPendingReadbacks = std::min(numPendingReadbacks + 1, numStagingBuffers);
+    }
+
+    // Cells that didn't fit in shared memory, and the particles in them, as of the latest snapshot the GPU has finished (usually a frame or two old).
+    // Doesn't wait on the GPU.
+    void readOverflowCounts(uint& numCells, uint& numParticles) {
+        while (numPendingReadbacks > 0) {
+            int oldest = (nextStagingBuffer - numPendingReadbacks + numStagingBuffers) % numStagingBuffers;
+            if (!DirectX::tryCopyStagingBufferToPointer(overflowCountsStagingBuffers[oldest], latestOverflowCounts.data())) break;
+            --numPendingReadbacks;
+        }
+        numCells = latestOverflowCounts[0];
+        numParticles = latestOverflowCounts[1];
+    }
+
 private:
     int numWorkgroups = 0;
     ComPtr<ID3D11UnorderedAccessView> particlesUAV;
@@ -44,12 +85,19 @@ private:
     ComPtr<ID3D11ShaderResourceView> particlesByCollisionCellSRV;
     ComPtr<ID3D11ShaderResourceView> collisionCellParticleCountsSRV;
     ComPtr<ID3D11Buffer> particleCollisionCB;
+    ComPtr<ID3D11Buffer> overflowCountsBuffer;
+    ComPtr<ID3D11UnorderedAccessView> overflowCountsUAV;
+    inline static constexpr int numStagingBuffers = 3;
+    std::array<ComPtr<ID3D11Buffer>, numStagingBuffers> overflowCountsStagingBuffers;
+    int nextStagingBuffer = 0;
+    int numPendingReadbacks = 0;
+    std::array<uint, 2> latestOverflowCounts = { 0, 0 };
 
     void bind() override {
         ID3D11ShaderResourceView* srvs[] = { particlesByCollisionCellSRV.Get(), collisionCellParticleCountsSRV.Get(), oldParticlesSRV.Get() };
         DirectX::getContext()->CSSetShaderResources(0, ARRAYSIZE(srvs), srvs);
 
-        ID3D11UnorderedAccessView* uavs[] = { particlesUAV.Get() };
+        ID3D11UnorderedAccessView* uavs[] = { particlesUAV.Get(), overflowCountsUAV.Get() };
         DirectX::getContext()->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
 
         ID3D11Buffer* cbvs[] = { particleCollisionCB.Get() };
@@ -60,7 +108,7 @@ private:
         ID3D11ShaderResourceView* srvs[] = { nullptr, nullptr, nullptr };
         DirectX::getContext()->CSSetShaderResources(0, ARRAYSIZE(srvs), srvs);
 
-        ID3D11UnorderedAccessView* uavs[] = { nullptr };
+        ID3D11UnorderedAccessView* uavs[] = { nullptr, nullptr };
         DirectX::getContext()->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
 
         ID3D11Buffer* cbvs[] = { nullptr };
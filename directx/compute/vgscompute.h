@@ -27,12 +27,14 @@ public:
         float relaxation,
         float edgeUniformity,
         uint iterCount,
-        float compliance
+        float compliance,
+        float chebyshevRho
     ) {
         vgsConstants.relaxation = relaxation;
         vgsConstants.edgeUniformity = edgeUniformity;
         vgsConstants.iterCount = iterCount;
         vgsConstants.compliance = compliance;
+        vgsConstants.chebyshevRho = chebyshevRho;
         DirectX::updateConstantBuffer(vgsConstantBuffer, vgsConstants);
     }
 
@@ -77,6 +79,7 @@ private:
         vgsConstants.particleRadius = particleRadius;
         vgsConstants.voxelRestVolume = voxelRestVolume;
         vgsConstants.compliance = 0;
+        vgsConstants.chebyshevRho = 0;
     
         vgsConstantBuffer = DirectX::createConstantBuffer(vgsConstants);
     }
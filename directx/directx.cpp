@@ -136,6 +136,61 @@ void DirectX::copyBufferToPointer(
         dxContext->Unmap(staging.Get(), 0);
 }
 
+void DirectX::copyBufferPrefixToPointer(
+    const ComPtr<ID3D11Buffer>& buffer,
+    UINT numBytes,
+    void* outData
+) {
+        if (numBytes == 0) return;
+
+        D3D11_BUFFER_DESC stagingDesc = {};
+        stagingDesc.Usage = D3D11_USAGE_STAGING;
+        stagingDesc.ByteWidth = numBytes;
+        stagingDesc.BindFlags = 0;
+        stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        stagingDesc.MiscFlags = 0;
+
+        ComPtr<ID3D11Buffer> staging;
+        HRESULT hr = dxDevice->CreateBuffer(&stagingDesc, nullptr, staging.GetAddressOf());
+
+        D3D11_BOX srcBox = { 0, 0, 0, numBytes, 1, 1 };
+        dxContext->CopySubresourceRegion(staging.Get(), 0, 0, 0, 0, buffer.Get(), 0, &srcBox);
+
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        hr = dxContext->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped);
+        memcpy(outData, mapped.pData, numBytes);
+        dxContext->Unmap(staging.Get(), 0);
+}
+
+ComPtr<ID3D11Buffer> DirectX::createStagingBuffer(UINT byteWidth) {
+        D3D11_BUFFER_DESC stagingDesc = {};
+        stagingDesc.Usage = D3D11_USAGE_STAGING;
+        stagingDesc.ByteWidth = byteWidth;
+        stagingDesc.BindFlags = 0;
+        stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        stagingDesc.MiscFlags = 0;
+
+        ComPtr<ID3D11Buffer> staging;
+        HRESULT hr = dxDevice->CreateBuffer(&stagingDesc, nullptr, staging.GetAddressOf());
+        return staging;
+}
+
+bool DirectX::tryCopyStagingBufferToPointer(
+    const ComPtr<ID3D11Buffer>& staging,
+    void* outData
+) {
+        D3D11_BUFFER_DESC desc;
+        staging->GetDesc(&desc);
+
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        HRESULT hr = dxContext->Map(staging.Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (FAILED(hr)) return false; // DXGI_ERROR_WAS_STILL_DRAWING: the GPU hasn't gotten to the copy yet
+
+        memcpy(outData, mapped.pData, desc.ByteWidth);
+        dxContext->Unmap(staging.Get(), 0);
+        return true;
+}
+
 ComPtr<ID3D11Buffer> DirectX::getBufferFromView(
     const ComPtr<ID3D11View>& view
 ) {
@@ -246,6 +246,34 @@ public:
         void* outData
     );
 
+    // Same, but only the first numBytes of the buffer (so the readback is proportional to what's actually needed).
+    static void copyBufferPrefixToPointer(
+        const ComPtr<ID3D11Buffer>& buffer,
+        UINT numBytes,
+        void* outData
+    );
+
+    // A buffer the CPU can read, for GPU buffers to be copied into (with CopyResource) and read back later, see tryCopyStagingBufferToPointer.
+    static ComPtr<ID3D11Buffer> createStagingBuffer(UINT byteWidth);
+
+    // Reads back a staging buffer without waiting on the GPU: returns false, leaving outData untouched, if the copy into it hasn't finished yet.
+    static bool tryCopyStagingBufferToPointer(
+        const ComPtr<ID3D11Buffer>& staging,
+        void* outData
+    );
+
+    /**
+     * Overwrite the contents of a (default usage) GPU buffer with a host vector of the same size.
+     */
+    template<typename T>
+    static void copyVectorToBuffer(
+        const std::vector<T>& data,
+        const ComPtr<ID3D11Buffer>& buffer
+    ) {
+        if (!buffer || data.empty()) return;
+        DirectX::getContext()->UpdateSubresource(buffer.Get(), 0, nullptr, data.data(), 0, 0);
+    }
+
     /*
     * Clears a UINT buffer with the value 0.
     */
@@ -268,13 +296,9 @@ public:
     static void notifyMayaOfMemoryUsage(const ComPtr<ID3D11Buffer>& buffer, bool acquire = false);
     static int getNumElementsInBuffer(const ComPtr<ID3D11Buffer>& buffer);
     
-private:
-    static HINSTANCE pluginInstance;
-    static ID3D11Device* dxDevice;
-    static ID3D11DeviceContext* dxContext;
-
+    // Copies numElements elements of srcBuffer, starting at srcOffset, into dstBuffer at dstOffset (GPU-side, no round trip through the host).
     template<typename T>
-    static void copyBufferSubregion(ComPtr<ID3D11Buffer>& srcBuffer, ComPtr<ID3D11Buffer>& dstBuffer, uint srcOffset, uint dstOffset, uint numElements) {
+    static void copyBufferSubregion(const ComPtr<ID3D11Buffer>& srcBuffer, const ComPtr<ID3D11Buffer>& dstBuffer, uint srcOffset, uint dstOffset, uint numElements) {
         D3D11_BOX srcBox = {};
         srcBox.left = srcOffset * sizeof(T);
         srcBox.right = (srcOffset + numElements) * sizeof(T);
@@ -293,4 +317,9 @@ private:
             &srcBox
         );
     }
+
+private:
+    static HINSTANCE pluginInstance;
+    static ID3D11Device* dxDevice;
+    static ID3D11DeviceContext* dxContext;
 };
\ No newline at end of file
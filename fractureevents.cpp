@@ -0,0 +1,107 @@
+#include "fractureevents.h"
+#include <algorithm>
+#include <fstream>
+#include <tuple>
+
+void FractureEventLog::setRecording(bool recording) {
+    if (recording == this->recording) return;
+    this->recording = recording;
+
+    if (!recording) {
+        releaseBuffers();
+        return;
+    }
+
+    eventsBuffer = DirectX::createReadWriteBuffer(std::vector<FractureEvent>(FRACTURE_EVENT_CAPACITY));
+    eventCountBuffer = DirectX::createReadWriteBuffer(std::vector<uint>(1, 0));
+    eventsUAV = DirectX::createUAV(eventsBuffer);
+    eventCountUAV = DirectX::createUAV(eventCountBuffer);
+}
+
+void FractureEventLog::releaseBuffers() {
+    if (eventsBuffer) DirectX::notifyMayaOfMemoryUsage(eventsBuffer);
+    if (eventCountBuffer) DirectX::notifyMayaOfMemoryUsage(eventCountBuffer);
+    eventsUAV.Reset();
+    eventCountUAV.Reset();
+    eventsBuffer.Reset();
+    eventCountBuffer.Reset();
+}
+
+void FractureEventLog::drain(int frame, std::vector<FractureEvent>& hostEvents, const std::vector<std::pair<uint, int>>& objectVoxelOffsets) {
+    while (!history.empty() && history.back().frame >= frame) {
+        history.pop_back();
+    }
+
+    if (eventCountBuffer) {
+        uint count = 0;
+        DirectX::copyBufferPrefixToPointer(eventCountBuffer, sizeof(uint), &count);
+
+        if (count > 0) {
+            uint numStored = std::min<uint>(count, FRACTURE_EVENT_CAPACITY);
+            numDropped += count - numStored;
+            gpuEvents.resize(numStored);
+            DirectX::copyBufferPrefixToPointer(eventsBuffer, numStored * sizeof(FractureEvent), gpuEvents.data());
+            DirectX::clearUintBuffer(eventCountUAV);
+
+            // Threads append in whatever order they happen to run; sort so that the log is the same from run to run.
+            std::sort(gpuEvents.begin(), gpuEvents.end(), [](const FractureEvent& a, const FractureEvent& b) {
+                return std::tie(a.substep, a.axis, a.constraintIdx, a.voxelA) < std::tie(b.substep, b.axis, b.constraintIdx, b.voxelA);
+            });
+            append(frame, gpuEvents, objectVoxelOffsets);
+        }
+    }
+
+    append(frame, hostEvents, objectVoxelOffsets);
+    hostEvents.clear();
+}
+
+void FractureEventLog::append(int frame, const std::vector<FractureEvent>& events, const std::vector<std::pair<uint, int>>& objectVoxelOffsets) {
+    for (const FractureEvent& event : events) {
+        // The last object starting at or before voxel A
+        auto object = std::upper_bound(objectVoxelOffsets.begin(), objectVoxelOffsets.end(), event.voxelA, [](uint voxel, const std::pair<uint, int>& offset) {
+            return voxel < offset.first;
+        });
+
+        Record record{ frame, -1, event };
+        if (object != objectVoxelOffsets.begin()) {
+            --object;
+            record.objectIndex = object->second;
+            record.event.voxelA -= object->first;
+            record.event.voxelB -= object->first;
+        }
+
+        history.push_back(record);
+        if (history.size() > historyCapacity) {
+            history.pop_front();
+        }
+    }
+}
+
+void FractureEventLog::clear() {
+    history.clear();
+    numDropped = 0;
+}
+
+std::pair<size_t, size_t> FractureEventLog::findFrames(int startFrame, int endFrame) const {
+    auto begin = std::lower_bound(history.begin(), history.end(), startFrame, [](const Record& record, int frame) {
+        return record.frame < frame;
+    });
+    auto end = std::upper_bound(begin, history.end(), endFrame, [](int frame, const Record& record) {
+        return frame < record.frame;
+    });
+    return { static_cast<size_t>(begin - history.begin()), static_cast<size_t>(end - history.begin()) };
+}
+
+MStatus FractureEventLog::exportToFile(const MString& filePath, const std::function<MString(int)>& objectName) const {
+    std::ofstream file(filePath.asChar());
+    if (!file) return MS::kFailure;
+
+    file << "frame,object,substep,axis,constraint,voxelA,voxelB,strain\n";
+    for (const Record& record : history) {
+        const FractureEvent& event = record.event;
+        file << record.frame << ',' << objectName(record.objectIndex).asChar() << ',' << event.substep << ',' << event.axis << ','
+             << event.constraintIdx << ',' << event.voxelA << ',' << event.voxelB << ',' << event.strain << '\n';
+    }
+
+    return file ? MS::kSuccess : MS::kFailure;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "directx/directx.h"
+#include "shaders/constants.hlsli"
+#include <maya/MString.h>
+#include <maya/MStatus.h>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <utility>
+#include <cstdint>
+
+/**
+ * A record of every face constraint that broke, for driving effects (dust, debris, sound) off of the fractures.
+ *
+ * While recording, the face constraint shader appends an event to a buffer shared by all objects, with an atomic counter, as each constraint breaks.
+ * Once a frame, drain() reads back the counter and then only the events written, and resets the counter - so the cost scales with the
+ * number of fractures, not the number of constraints. The CPU backend collects the same events on the host (see CPUSimulationBuffers::fractureEvents).
+ *
+ * Drained events go into a ring buffer of the most recent ones, ordered by frame, which can be queried or exported with the fractureEvents command.
+ */
+class FractureEventLog {
+public:
+    struct Record {
+        int frame;
+        int objectIndex;      // Logical index of the object's connection to the global solver (see GlobalSolver::aParticleData), or -1 if unknown
+        FractureEvent event;  // With voxel indices local to the object
+    };
+
+    inline static constexpr size_t historyCapacity = 1 << 18;
+
+    FractureEventLog() = default;
+    FractureEventLog(const FractureEventLog&) = delete;
+    FractureEventLog& operator=(const FractureEventLog&) = delete;
+
+    bool isRecording() const {
+        return recording;
+    }
+
+    // Creates the GPU buffers when recording starts, and frees them when it stops. The history is kept either way.
+    void setRecording(bool recording);
+
+    const ComPtr<ID3D11UnorderedAccessView>& getEventsUAV() const {
+        return eventsUAV;
+    }
+
+    const ComPtr<ID3D11UnorderedAccessView>& getEventCountUAV() const {
+        return eventCountUAV;
+    }
+
+    /**
+     * Moves the events recorded over the frame just simulated into the history: those the GPU appended, then hostEvents (which is cleared).
+     * objectVoxelOffsets pairs the first global voxel of each object with its object index, sorted by voxel, to attribute events to objects.
+     * Anything already recorded for this frame or later is dropped first, since it's being re-simulated.
+     */
+    void drain(int frame, std::vector<FractureEvent>& hostEvents, const std::vector<std::pair<uint, int>>& objectVoxelOffsets);
+
+    void clear();
+
+    size_t size() const {
+        return history.size();
+    }
+
+    // Oldest first
+    const Record& operator[](size_t i) const {
+        return history[i];
+    }
+
+    // Range [begin, end) of the history with frames in [startFrame, endFrame]
+    std::pair<size_t, size_t> findFrames(int startFrame, int endFrame) const;
+
+    // Events the GPU couldn't store because more than FRACTURE_EVENT_CAPACITY broke in one frame, since the log was last cleared.
+    uint64_t getNumDropped() const {
+        return numDropped;
+    }
+
+    // One line per event (frame, object, substep, axis, constraint, voxelA, voxelB, strain), objects named by objectName.
+    MStatus exportToFile(const MString& filePath, const std::function<MString(int)>& objectName) const;
+
+private:
+    bool recording = false;
+    std::deque<Record> history;
+    uint64_t numDropped = 0;
+    std::vector<FractureEvent> gpuEvents; // Readback scratch space, kept to avoid reallocating every frame
+    ComPtr<ID3D11Buffer> eventsBuffer;
+    ComPtr<ID3D11Buffer> eventCountBuffer;
+    ComPtr<ID3D11UnorderedAccessView> eventsUAV;
+    ComPtr<ID3D11UnorderedAccessView> eventCountUAV;
+
+    void releaseBuffers();
+    void append(int frame, const std::vector<FractureEvent>& events, const std::vector<std::pair<uint, int>>& objectVoxelOffsets);
+};
@@ -11,16 +11,33 @@
 #include "custommayaconstructs/data/functionaldata.h"
 #include "custommayaconstructs/data/colliderdata.h"
 #include "simulationcache.h"
+#include <algorithm>
 
 const MTypeId GlobalSolver::id(0x0013A7B1);
 const MString GlobalSolver::globalSolverNodeName("GlobalSolver");
 MObject GlobalSolver::globalSolverNodeObject = MObject::kNullObj;
 MObject GlobalSolver::aNumSubsteps = MObject::kNullObj;
+MObject GlobalSolver::aAdaptiveSubsteps = MObject::kNullObj;
+MObject GlobalSolver::aMinSubsteps = MObject::kNullObj;
+MObject GlobalSolver::aMaxSubsteps = MObject::kNullObj;
+MObject GlobalSolver::aSubstepsUsed = MObject::kNullObj;
+MObject GlobalSolver::aCollisionOverflowCells = MObject::kNullObj;
+MObject GlobalSolver::aCollisionOverflowParticles = MObject::kNullObj;
 MObject GlobalSolver::aParticleCollisionsEnabled = MObject::kNullObj;
 MObject GlobalSolver::aPrimitiveCollisionsEnabled = MObject::kNullObj;
 MObject GlobalSolver::aParticleFriction = MObject::kNullObj;
 MObject GlobalSolver::aCacheFrequency = MObject::kNullObj;
 MObject GlobalSolver::aMaxCacheSize = MObject::kNullObj;
+MObject GlobalSolver::aCPUSimulation = MObject::kNullObj;
+MObject GlobalSolver::aDeterministic = MObject::kNullObj;
+MObject GlobalSolver::aFlatFaceConstraints = MObject::kNullObj;
+MObject GlobalSolver::aSleepThreshold = MObject::kNullObj;
+MObject GlobalSolver::aRigidStrainThreshold = MObject::kNullObj;
+MObject GlobalSolver::aMeasureResiduals = MObject::kNullObj;
+MObject GlobalSolver::aConvergenceTolerance = MObject::kNullObj;
+MObject GlobalSolver::aJacobiConstraints = MObject::kNullObj;
+MObject GlobalSolver::aRecordFractureEvents = MObject::kNullObj;
+MObject GlobalSolver::aBatchedDispatch = MObject::kNullObj;
 MObject GlobalSolver::aParticleData = MObject::kNullObj;
 MObject GlobalSolver::aColliderData = MObject::kNullObj;
 MObject GlobalSolver::aParticleBufferOffset = MObject::kNullObj;
@@ -33,6 +50,12 @@ std::unordered_map<uint, std::function<void()>> GlobalSolver::pbdSimulateFuncs;
 ColliderBuffer GlobalSolver::colliderBuffer;
 std::unordered_set<int> GlobalSolver::dirtyColliderIndices;
 MTime GlobalSolver::lastComputeTime = MTime();
+CPUSimulationBuffers GlobalSolver::cpuSimulationBuffers;
+bool GlobalSolver::cpuSimulationActive = false;
+FractureEventLog GlobalSolver::fractureEventLog;
+uint GlobalSolver::currentSubstep = 0;
+bool GlobalSolver::batchCollectionActive = false;
+std::vector<BatchedObjectSource> GlobalSolver::batchedObjectSources;
 
 GlobalSolver::~GlobalSolver() {
     // As with other Maya nodes, preRemovalCallback is not always called (e.g. on a new scene load), so also do cleanup here.
@@ -42,6 +65,8 @@ GlobalSolver::~GlobalSolver() {
     buildCollisionParticleCompute.reset();
     dragParticlesCompute.reset();
     prefixScanCompute.reset();
+    solveCollisionsCompute.reset();
+    batchedConstraintsCompute.reset();
     tearDown();
 }
 
@@ -62,6 +87,9 @@ void GlobalSolver::postConstructor() {
     setExistWithoutOutConnections(true);
     
     unsubscribeFromDragStateChange = VoxelDragContext::subscribeToDragStateChange([this](const DragState& dragState) {
+        if (dragState.isDragging && !isDragging && MPlug(thisMObject(), aCPUSimulation).asBool()) {
+            MGlobal::displayWarning("Dragging is not supported by the CPU backend. Turn off cpuSimulation on the global solver to drag voxels.");
+        }
         isDragging = dragState.isDragging;
     });
 
@@ -110,6 +138,9 @@ void GlobalSolver::tearDown() {
     colliderBuffer = ColliderBuffer();
     dirtyColliderIndices.clear();
     bufferCacheRegistrations.clear();
+    cpuSimulationBuffers = CPUSimulationBuffers();
+    fractureEventLog.setRecording(false);
+    fractureEventLog.clear();
 
     SimulationCache::instance()->tearDown();
 }
@@ -288,6 +319,13 @@ void GlobalSolver::createGlobalComputeShaders(float maximumParticleRadius) {
     dragParticlesCompute.setParticlesUAV(particleUAV);
     buffers[BufferType::DRAGGING] = dragParticlesCompute.getIsDraggingBuffer();
 
+    batchedConstraintsCompute = BatchedConstraintsCompute(
+        particleUAV,
+        DirectX::createUAV(buffers[BufferType::OLDPARTICLE]),
+        DirectX::createUAV(buffers[BufferType::SURFACE]),
+        DirectX::createSRV(buffers[BufferType::DRAGGING])
+    );
+
     colliderBuffer.totalParticles = totalParticles;
     solvePrimitiveCollisionsCompute = SolvePrimitiveCollisionsCompute(colliderBuffer);
     solvePrimitiveCollisionsCompute.setParticlesUAV(particleUAV);
@@ -395,7 +433,38 @@ MStatus GlobalSolver::initialize() {
     status = addAttribute(aNumSubsteps);
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
+    aMinSubsteps = nAttr.create("minSubsteps", "mns", MFnNumericData::kInt, 2, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nAttr.setMin(1);
+    nAttr.setSoftMax(10);
+    nAttr.setMax(100);
+    nAttr.setStorable(true);
+    nAttr.setWritable(true);
+    nAttr.setReadable(true);
+    status = addAttribute(aMinSubsteps);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aMaxSubsteps = nAttr.create("maxSubsteps", "mxs", MFnNumericData::kInt, 40, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nAttr.setMin(1);
+    nAttr.setSoftMin(10);
+    nAttr.setSoftMax(60);
+    nAttr.setMax(100);
+    nAttr.setStorable(true);
+    nAttr.setWritable(true);
+    nAttr.setReadable(true);
+    status = addAttribute(aMaxSubsteps);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
     MFnNumericAttribute nBoolAttr;
+    aAdaptiveSubsteps = nBoolAttr.create("adaptiveSubsteps", "ads", MFnNumericData::kBoolean, false, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nBoolAttr.setStorable(true);
+    nBoolAttr.setWritable(true);
+    nBoolAttr.setReadable(true);
+    status = addAttribute(aAdaptiveSubsteps);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
     aParticleCollisionsEnabled = nBoolAttr.create("particleCollisionsEnabled", "pce", MFnNumericData::kBoolean, true, &status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
     nBoolAttr.setStorable(true);
@@ -447,6 +516,92 @@ MStatus GlobalSolver::initialize() {
     status = addAttribute(aMaxCacheSize);
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
+    aCPUSimulation = nBoolAttr.create("cpuSimulation", "cpus", MFnNumericData::kBoolean, false, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nBoolAttr.setStorable(true);
+    nBoolAttr.setWritable(true);
+    nBoolAttr.setReadable(true);
+    status = addAttribute(aCPUSimulation);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aDeterministic = nBoolAttr.create("deterministic", "dtm", MFnNumericData::kBoolean, false, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nBoolAttr.setStorable(true);
+    nBoolAttr.setWritable(true);
+    nBoolAttr.setReadable(true);
+    status = addAttribute(aDeterministic);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aFlatFaceConstraints = nBoolAttr.create("flatFaceConstraints", "ffc", MFnNumericData::kBoolean, true, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nBoolAttr.setStorable(true);
+    nBoolAttr.setWritable(true);
+    nBoolAttr.setReadable(true);
+    status = addAttribute(aFlatFaceConstraints);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aSleepThreshold = nFloatAttr.create("sleepThreshold", "slt", MFnNumericData::kFloat, 0.0f, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nFloatAttr.setMin(0.0f);
+    nFloatAttr.setSoftMax(1.0f);
+    nFloatAttr.setStorable(true);
+    nFloatAttr.setWritable(true);
+    nFloatAttr.setReadable(true);
+    status = addAttribute(aSleepThreshold);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aRigidStrainThreshold = nFloatAttr.create("rigidStrainThreshold", "rst", MFnNumericData::kFloat, 0.0f, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nFloatAttr.setMin(0.0f);
+    nFloatAttr.setSoftMax(0.1f);
+    nFloatAttr.setStorable(true);
+    nFloatAttr.setWritable(true);
+    nFloatAttr.setReadable(true);
+    status = addAttribute(aRigidStrainThreshold);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aMeasureResiduals = nBoolAttr.create("measureResiduals", "mres", MFnNumericData::kBoolean, false, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nBoolAttr.setStorable(true);
+    nBoolAttr.setWritable(true);
+    nBoolAttr.setReadable(true);
+    status = addAttribute(aMeasureResiduals);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aConvergenceTolerance = nFloatAttr.create("convergenceTolerance", "ctol", MFnNumericData::kFloat, 0.0f, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nFloatAttr.setMin(0.0f);
+    nFloatAttr.setSoftMax(0.01f);
+    nFloatAttr.setStorable(true);
+    nFloatAttr.setWritable(true);
+    nFloatAttr.setReadable(true);
+    status = addAttribute(aConvergenceTolerance);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aJacobiConstraints = nBoolAttr.create("jacobiConstraints", "jac", MFnNumericData::kBoolean, false, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nBoolAttr.setStorable(true);
+    nBoolAttr.setWritable(true);
+    nBoolAttr.setReadable(true);
+    status = addAttribute(aJacobiConstraints);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aRecordFractureEvents = nBoolAttr.create("recordFractureEvents", "rfe", MFnNumericData::kBoolean, false, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nBoolAttr.setStorable(true);
+    nBoolAttr.setWritable(true);
+    nBoolAttr.setReadable(true);
+    status = addAttribute(aRecordFractureEvents);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aBatchedDispatch = nBoolAttr.create("batchedDispatch", "bd", MFnNumericData::kBoolean, false, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nBoolAttr.setStorable(true);
+    nBoolAttr.setWritable(true);
+    nBoolAttr.setReadable(true);
+    status = addAttribute(aBatchedDispatch);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
     // Input attribute
     // Time attribute
     MFnUnitAttribute uTimeAttr;
@@ -500,6 +655,33 @@ MStatus GlobalSolver::initialize() {
     status = addAttribute(aTrigger);
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
+    // Number of substeps the last simulated frame took (only differs from numSubsteps with adaptive substepping). Set while computing the trigger.
+    aSubstepsUsed = nAttr.create("substepsUsed", "ssu", MFnNumericData::kInt, 0, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    nAttr.setReadable(true);
+    status = addAttribute(aSubstepsUsed);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    // Collision cells (summed over the substeps) too dense to solve in shared memory last frame, which fell back to the slower global memory path,
+    // and the number of particles in them. Set while computing the trigger, on the GPU with particle collisions on; 0 otherwise.
+    aCollisionOverflowCells = nAttr.create("collisionOverflowCells", "coc", MFnNumericData::kInt, 0, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    nAttr.setReadable(true);
+    status = addAttribute(aCollisionOverflowCells);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    aCollisionOverflowParticles = nAttr.create("collisionOverflowParticles", "cop", MFnNumericData::kInt, 0, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    nAttr.setReadable(true);
+    status = addAttribute(aCollisionOverflowParticles);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
     // Tells PBD nodes where in the global particle buffer their particles start
     aParticleBufferOffset = nAttr.create("particlebufferoffset", "pbo", MFnNumericData::kInt, -1, &status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
@@ -560,7 +742,9 @@ MStatus GlobalSolver::compute(const MPlug& plug, MDataBlock& block)
     }
     lastComputeTime = time;
     
-    simulationCache->tryUseCache(time);
+    if (simulationCache->tryUseCache(time)) {
+        cpuSimulationBuffers.gpuConstraintsVersion++;
+    }
     if (hasCacheData) return MS::kSuccess;
 
     bool particleCollisionsEnabled = block.inputValue(aParticleCollisionsEnabled).asBool();
@@ -569,34 +753,206 @@ MStatus GlobalSolver::compute(const MPlug& plug, MDataBlock& block)
     buildCollisionGridCompute.setFriction(particleFriction);
     int substeps = block.inputValue(aNumSubsteps).asInt();
     dragParticlesCompute.setNumSubsteps(substeps);
+    int substepsUsed = substeps;
+    uint collisionOverflowCells = 0;
+    uint collisionOverflowParticles = 0;
+    bool recordFractureEvents = block.inputValue(aRecordFractureEvents).asBool();
+    fractureEventLog.setRecording(recordFractureEvents);
+    cpuSimulationBuffers.recordFractureEvents = recordFractureEvents;
+
+    if (block.inputValue(aCPUSimulation).asBool()) {
+        CPUSolver::setDeterministic(block.inputValue(aDeterministic).asBool());
+        CPUSolver::setFlatFaceConstraints(block.inputValue(aFlatFaceConstraints).asBool());
+        CPUSolver::setSleepThreshold(block.inputValue(aSleepThreshold).asFloat());
+        CPUSolver::setRigidStrainThreshold(block.inputValue(aRigidStrainThreshold).asFloat());
+        CPUSolver::setMeasureResiduals(block.inputValue(aMeasureResiduals).asBool());
+        CPUSolver::setConvergenceTolerance(block.inputValue(aConvergenceTolerance).asFloat());
+        CPUSolver::setJacobiConstraints(block.inputValue(aJacobiConstraints).asBool());
+        bool adaptiveSubsteps = block.inputValue(aAdaptiveSubsteps).asBool();
+        int minSubsteps = adaptiveSubsteps ? block.inputValue(aMinSubsteps).asInt() : substeps;
+        int maxSubsteps = adaptiveSubsteps ? block.inputValue(aMaxSubsteps).asInt() : substeps;
+        substepsUsed = simulateFrameOnCPU(substeps, minSubsteps, maxSubsteps, particleCollisionsEnabled, primitiveCollisionsEnabled);
+    } else {
+        simulateFrameOnGPU(substeps, block.inputValue(aBatchedDispatch).asBool(), particleCollisionsEnabled, primitiveCollisionsEnabled);
+        if (particleCollisionsEnabled) {
+            solveCollisionsCompute.queueOverflowCountsReadback();
+            solveCollisionsCompute.readOverflowCounts(collisionOverflowCells, collisionOverflowParticles);
+        }
+    }
+
+    block.outputValue(aSubstepsUsed).setInt(substepsUsed);
+    block.setClean(aSubstepsUsed);
+    block.outputValue(aCollisionOverflowCells).setInt(static_cast<int>(collisionOverflowCells));
+    block.setClean(aCollisionOverflowCells);
+    block.outputValue(aCollisionOverflowParticles).setInt(static_cast<int>(collisionOverflowParticles));
+    block.setClean(aCollisionOverflowParticles);
+
+    int currentFrame = static_cast<int>(std::floor(time.as(MTime::uiUnit())));
+    if (recordFractureEvents) {
+        drainFractureEvents(currentFrame);
+    }
+
+    int cacheFrequency = block.inputValue(aCacheFrequency).asInt();
+    if (cacheFrequency > 0 && (std::abs(static_cast<int>(currentFrame - lastCachedFrame)) >= cacheFrequency)) {
+        simulationCache->cacheData(time);
+        lastCachedFrame = currentFrame;
+    }
+
+    return MS::kSuccess;
+}
+
+/**
+ * Resets the simulation to the start frame (clearing the cache), then steps forward numFrames frames, calling afterFrame(frame) after each
+ * (including the start frame, as frame 0). Evaluation is forced by pulling on the trigger plug, so this works with no viewport, e.g. in batch mode.
+ */
+void GlobalSolver::resimulateFromStart(int numFrames, const std::function<void(int)>& afterFrame) {
+    if (globalSolverNodeObject.isNull()) return;
+
+    SimulationCache::instance()->resetCache();
+    MTime startTime = MAnimControl::minTime();
+    lastComputeTime = startTime; // So frames already simulated once aren't skipped
+    MAnimControl::setCurrentTime(startTime);
+
+    MPlug triggerPlug(globalSolverNodeObject, aTrigger);
+    triggerPlug.asBool();
+    if (afterFrame) afterFrame(0);
+
+    for (int frame = 1; frame <= numFrames; ++frame) {
+        MAnimControl::setCurrentTime(startTime + MTime(static_cast<double>(frame), MTime::uiUnit()));
+        triggerPlug.asBool();
+        if (afterFrame) afterFrame(frame);
+    }
+}
+
+/**
+ * Runs a frame's worth of substeps with the compute shaders. Unbatched, each object dispatches its own passes every substep. Batched, the objects
+ * are collected once up front (their simulate functions add themselves to the batch instead of dispatching), and each pass then runs once per substep
+ * over all of them - falling back to unbatched for the frame if they can't be batched (see BatchedConstraintsCompute::gather).
+ */
+void GlobalSolver::simulateFrameOnGPU(int substeps, bool batched, bool particleCollisionsEnabled, bool primitiveCollisionsEnabled) {
+    solveCollisionsCompute.resetOverflowCounts();
+    cpuSimulationBuffers.gpuConstraintsVersion++; // Constraints may break
+
+    if (batched) {
+        batchCollectionActive = true;
+        for (const auto& [i, pbdSimulateFunc] : pbdSimulateFuncs) {
+            pbdSimulateFunc();
+        }
+        batchCollectionActive = false;
+
+        batched = batchedConstraintsCompute.gather(batchedObjectSources, static_cast<uint>(getTotalParticles()));
+        if (!batched) batchedObjectSources.clear();
+    }
+
+    for (int i = 0; i < substeps; ++i) {
+        currentSubstep = static_cast<uint>(i);
+        if (batched) {
+            batchedConstraintsCompute.setFractureEventRecording(
+                fractureEventLog.isRecording(), currentSubstep, fractureEventLog.getEventsUAV(), fractureEventLog.getEventCountUAV()
+            );
+            batchedConstraintsCompute.dispatch();
+        } else {
+            for (const auto& [j, pbdSimulateFunc] : pbdSimulateFuncs) {
+                pbdSimulateFunc();
+            }
+        }
+
+        dispatchGlobalPasses(particleCollisionsEnabled, primitiveCollisionsEnabled);
+    }
 
+    if (batched) {
+        batchedConstraintsCompute.scatter(batchedObjectSources);
+        batchedObjectSources.clear();
+    }
+}
+
+// The passes over all particles at the end of each GPU substep, after the objects' own.
+void GlobalSolver::dispatchGlobalPasses(bool particleCollisionsEnabled, bool primitiveCollisionsEnabled) {
+    if (isDragging) {
+        dragParticlesCompute.dispatch();
+    }   
+
+    if (particleCollisionsEnabled) {
+        buildCollisionGridCompute.dispatch();
+        prefixScanCompute.dispatch(); 
+        buildCollisionParticleCompute.dispatch();
+        solveCollisionsCompute.dispatch();
+    }
+
+    if (primitiveCollisionsEnabled) {
+        solvePrimitiveCollisionsCompute.dispatch();
+    }
+}
+
+/**
+ * Runs a frame's worth of substeps with the CPU backend. The particle buffers are copied down once at the start of the frame and back up at the end,
+ * so everything else (rendering, caching, paint) keeps working off the GPU buffers unchanged.
+ * Note: interactive dragging is GPU-only, so it's not applied while simulating on the CPU.
+ *
+ * The frame takes between minSubsteps and maxSubsteps substeps (see CPUSolver::chooseSubsteps); returns how many it took.
+ * Velocities are converted to and from that substep length around the frame, so the buffers always hold them in terms of the nominal one (numSubsteps),
+ * same as the GPU path.
+ */
+int GlobalSolver::simulateFrameOnCPU(int nominalSubsteps, int minSubsteps, int maxSubsteps, bool particleCollisionsEnabled, bool primitiveCollisionsEnabled) {
+    if (getTotalParticles() == 0) return 0;
+
+    DirectX::copyBufferToVector(buffers[BufferType::PARTICLE], cpuSimulationBuffers.particles);
+    DirectX::copyBufferToVector(buffers[BufferType::OLDPARTICLE], cpuSimulationBuffers.oldParticles);
+    DirectX::copyBufferToVector(buffers[BufferType::SURFACE], cpuSimulationBuffers.isSurface);
+    DirectX::copyBufferToVector(buffers[BufferType::DRAGGING], cpuSimulationBuffers.isDragging);
+    cpuSimulationBuffers.isAsleep.assign(cpuSimulationBuffers.particles.size() / 8, 0);
+    cpuSimulationBuffers.hasSleepingVoxels = false;
+    cpuSimulationBuffers.residuals = SolverResiduals();
+    cpuSimulationBuffers.syncId++;
+
+    MThreadPool::init();
+    CPUSolver::unpackParticleAttributes(cpuSimulationBuffers);
+    int substeps = (minSubsteps == maxSubsteps) ? minSubsteps : CPUSolver::chooseSubsteps(cpuSimulationBuffers, nominalSubsteps, minSubsteps, maxSubsteps);
+    cpuSimulationBuffers.timeStepScale = static_cast<float>(nominalSubsteps) / substeps;
+    cpuSimulationBuffers.peakStrainRatio = 0.0f;
+    CPUSolver::rescaleVelocities(cpuSimulationBuffers, cpuSimulationBuffers.timeStepScale);
+
+    cpuSimulationActive = true;
     for (int i = 0; i < substeps; ++i) {
+        currentSubstep = static_cast<uint>(i);
+        cpuSimulationBuffers.substep = currentSubstep;
         for (const auto& [j, pbdSimulateFunc] : pbdSimulateFuncs) {
             pbdSimulateFunc();
         }
-
-        if (isDragging) {
-            dragParticlesCompute.dispatch();
-        }   
+        if (i == 0) CPUSolver::updateAwakeVoxels(cpuSimulationBuffers); // Each object decided what sleeps on its first substep
 
         if (particleCollisionsEnabled) {
-            buildCollisionGridCompute.dispatch();
-            prefixScanCompute.dispatch(); 
-            buildCollisionParticleCompute.dispatch();
-            solveCollisionsCompute.dispatch();
+            CPUSolver::solveParticleCollisions(cpuSimulationBuffers, buildCollisionGridCompute.getParticleCollisionConstants(), cpuCollisionGrid);
         }
 
         if (primitiveCollisionsEnabled) {
-            solvePrimitiveCollisionsCompute.dispatch();
+            CPUSolver::solvePrimitiveCollisions(cpuSimulationBuffers, colliderBuffer);
         }
     }
+    cpuSimulationActive = false;
+    CPUSolver::rescaleVelocities(cpuSimulationBuffers, 1.0f / cpuSimulationBuffers.timeStepScale);
+    MThreadPool::release(); // reduce reference count incurred by init()
+
+    DirectX::copyVectorToBuffer(cpuSimulationBuffers.particles, buffers[BufferType::PARTICLE]);
+    DirectX::copyVectorToBuffer(cpuSimulationBuffers.oldParticles, buffers[BufferType::OLDPARTICLE]);
+    DirectX::copyVectorToBuffer(cpuSimulationBuffers.isSurface, buffers[BufferType::SURFACE]);
+    return substeps;
+}
 
-    int currentFrame = static_cast<int>(std::floor(time.as(MTime::uiUnit())));
-    int cacheFrequency = block.inputValue(aCacheFrequency).asInt();
-    if (cacheFrequency > 0 && (std::abs(static_cast<int>(currentFrame - lastCachedFrame)) >= cacheFrequency)) {
-        simulationCache->cacheData(time);
-        lastCachedFrame = currentFrame;
+/**
+ * Moves the fracture events recorded over the frame (by either backend) into the log, attributing each to the object it happened in
+ * by where its voxels fall in the global buffers.
+ */
+void GlobalSolver::drainFractureEvents(int frame) {
+    std::vector<std::pair<uint, int>> objectVoxelOffsets;
+    MPlug particleBufferOffsetArrayPlug(globalSolverNodeObject, aParticleBufferOffset);
+    for (uint i = 0; i < particleBufferOffsetArrayPlug.numElements(); ++i) {
+        MPlug particleBufferOffsetPlug = particleBufferOffsetArrayPlug.elementByPhysicalIndex(i);
+        int offset = particleBufferOffsetPlug.asInt();
+        if (offset < 0) continue;
+        objectVoxelOffsets.emplace_back(static_cast<uint>(offset / 8), static_cast<int>(particleBufferOffsetPlug.logicalIndex()));
     }
+    std::sort(objectVoxelOffsets.begin(), objectVoxelOffsets.end());
 
-    return MS::kSuccess;
-}
\ No newline at end of file
+    fractureEventLog.drain(frame, cpuSimulationBuffers.fractureEvents, objectVoxelOffsets);
+}
@@ -8,6 +8,7 @@
 #include "directx/compute/buildcollisionparticlescompute.h"
 #include "directx/compute/solvecollisionscompute.h"
 #include "directx/compute/solveprimitivecollisionscompute.h"
+#include "directx/compute/batchedconstraintscompute.h"
 #include <maya/MNodeMessage.h>
 #include <d3d11.h>
 #include <wrl/client.h>
@@ -16,6 +17,8 @@
 #include <functional>
 #include <unordered_set>
 #include "simulationcache.h"
+#include "fractureevents.h"
+#include "cpu/cpusolver.h"
 using Microsoft::WRL::ComPtr;
 
 struct ColliderBuffer; // forward declaration
@@ -45,11 +48,24 @@ public:
     static const MString globalSolverNodeName;
     // User-set attributes
     static MObject aNumSubsteps;
+    static MObject aAdaptiveSubsteps; // (CPU only) pick the substep count per frame, between min and max, from particle speeds and strain
+    static MObject aMinSubsteps;
+    static MObject aMaxSubsteps;
     static MObject aParticleCollisionsEnabled;
     static MObject aPrimitiveCollisionsEnabled;
     static MObject aParticleFriction;
     static MObject aCacheFrequency; // how often to cache a frame of simulation data
     static MObject aMaxCacheSize;   // cache size in MB
+    static MObject aCPUSimulation;  // run the simulation on the CPU instead of via compute shaders
+    static MObject aDeterministic;  // (CPU only) bit-identical results regardless of thread count
+    static MObject aFlatFaceConstraints; // (CPU only) face constraint pass layout (see FlatFaceConstraints)
+    static MObject aSleepThreshold; // (CPU only) particle speed below which resting pieces stop being simulated
+    static MObject aRigidStrainThreshold; // (CPU only) strain below which intact pieces are simulated as rigid bodies
+    static MObject aMeasureResiduals;     // (CPU only) track constraint errors per frame (see SolverResidualsCommand)
+    static MObject aConvergenceTolerance; // (CPU only) stop VGS iterations early once corrections fall below this fraction of a particle diameter
+    static MObject aJacobiConstraints;    // (CPU only) solve long-range and face constraints Jacobi-style, averaging corrections (see CPUSolver::setJacobiConstraints)
+    static MObject aRecordFractureEvents; // log every face constraint break (see FractureEventLog, FractureEventsCommand)
+    static MObject aBatchedDispatch;      // (GPU only) run each pass once per substep over all objects, instead of per object (see BatchedConstraintsCompute)
     // Input attributes
     static MObject aTime;
     static MObject aParticleData;
@@ -58,6 +74,9 @@ public:
     // Output attributes
     static MObject aParticleBufferOffset;
     static MObject aTrigger;
+    static MObject aSubstepsUsed;
+    static MObject aCollisionOverflowCells;     // (GPU only) collision cells that didn't fit in shared memory in a recent frame (read back a frame or two late, see SolveCollisionsCompute)
+    static MObject aCollisionOverflowParticles; // (GPU only) and the particles in them
 
     static MObject globalSolverNodeObject;
 
@@ -69,6 +88,21 @@ public:
     // Time input triggers compute which runs simulation step for all connected PBD nodes.
     MStatus compute(const MPlug& plug, MDataBlock& block) override;
 
+    // While a CPU frame is being simulated, PBD nodes run their substeps on these host buffers instead of dispatching shaders.
+    static bool isCPUSimulationActive() { return cpuSimulationActive; }
+    static CPUSimulationBuffers& getCPUSimulationBuffers() { return cpuSimulationBuffers; }
+
+    static FractureEventLog& getFractureEventLog() { return fractureEventLog; }
+    // Index of the substep being simulated, within the current frame
+    static uint getCurrentSubstep() { return currentSubstep; }
+
+    // While a batched GPU frame is being set up, PBD nodes add themselves to the batch instead of dispatching their passes.
+    static bool isCollectingBatch() { return batchCollectionActive; }
+    static void addToBatch(BatchedObjectSource&& source) { batchedObjectSources.push_back(std::move(source)); }
+
+    // Re-simulates from the start frame without relying on a viewport to drive evaluation (e.g. for benchmarks and regression runs).
+    static void resimulateFromStart(int numFrames, const std::function<void(int)>& afterFrame);
+
 private:
     GlobalSolver() = default;
     ~GlobalSolver();
@@ -91,6 +125,12 @@ private:
     static ColliderBuffer colliderBuffer;
     static std::unordered_set<int> dirtyColliderIndices;
     static MTime lastComputeTime;
+    static CPUSimulationBuffers cpuSimulationBuffers;
+    static bool cpuSimulationActive;
+    static FractureEventLog fractureEventLog;
+    static uint currentSubstep;
+    static bool batchCollectionActive;
+    static std::vector<BatchedObjectSource> batchedObjectSources;
 
     // Global compute shaders
     void createGlobalComputeShaders(float maxParticleRadius);
@@ -100,6 +140,13 @@ private:
     BuildCollisionParticlesCompute buildCollisionParticleCompute;
     SolveCollisionsCompute solveCollisionsCompute;
     SolvePrimitiveCollisionsCompute solvePrimitiveCollisionsCompute;
+    BatchedConstraintsCompute batchedConstraintsCompute;
+    CPUCollisionGrid cpuCollisionGrid;
+
+    void simulateFrameOnGPU(int substeps, bool batched, bool particleCollisionsEnabled, bool primitiveCollisionsEnabled);
+    void dispatchGlobalPasses(bool particleCollisionsEnabled, bool primitiveCollisionsEnabled);
+    int simulateFrameOnCPU(int nominalSubsteps, int minSubsteps, int maxSubsteps, bool particleCollisionsEnabled, bool primitiveCollisionsEnabled);
+    static void drainFractureEvents(int frame);
     
     bool isDragging = false;
     EventBase::Unsubscribe unsubscribeFromDragStateChange;
@@ -1,7 +1,60 @@
 #include "pbd.h"
 #include "utils.h"
 #include "cube.h"
+#include "globalsolver.h"
+#include "cpu/vgssimd.h"
+#include <maya/MGlobal.h>
+#include <algorithm>
+
+/**
+ * Topologies are matched on the voxels' Morton codes, which (in sorted order) fully determine the constraints and their indices.
+ * The registry only holds weak references: a topology goes away with the last object using it.
+ */
+std::shared_ptr<const ConstraintTopology> PBD::acquireConstraintTopology(const MSharedPtr<Voxels> voxels) {
+    static std::vector<std::weak_ptr<const ConstraintTopology>> registeredTopologies;
 
+    const std::vector<uint32_t>& mortonCodes = voxels->mortonCodes;
+    std::vector<uint32_t> occupiedMortonCodes(mortonCodes.begin(), mortonCodes.begin() + voxels->numOccupied);
+    registeredTopologies.erase(
+        std::remove_if(registeredTopologies.begin(), registeredTopologies.end(), [](const std::weak_ptr<const ConstraintTopology>& topology) { return topology.expired(); }),
+        registeredTopologies.end()
+    );
+    for (const std::weak_ptr<const ConstraintTopology>& registeredTopology : registeredTopologies) {
+        std::shared_ptr<const ConstraintTopology> topology = registeredTopology.lock();
+        if (topology && topology->mortonCodes == occupiedMortonCodes) return topology;
+    }
+
+    std::shared_ptr<ConstraintTopology> topology = std::make_shared<ConstraintTopology>();
+    topology->mortonCodes = std::move(occupiedMortonCodes);
+
+    constructConstraints(voxels, topology->faceConstraints, topology->longRangeConstraints);
+    for (int axis = 0; axis < 3; ++axis) {
+        topology->faceIdxToLRConstraintBuffers[axis] = DirectX::createReadWriteBuffer(topology->longRangeConstraints.faceIdxToLRConstraintIndices[axis]);
+        topology->faceIdxToLRConstraintUAVs[axis] = DirectX::createUAV(topology->faceIdxToLRConstraintBuffers[axis]);
+    }
+
+    registeredTopologies.push_back(topology);
+    return topology;
+}
+
+void PBD::constructConstraints(const MSharedPtr<Voxels> voxels, std::array<FaceConstraints, 3>& faceConstraints, LongRangeConstraints& longRangeConstraints) {
+    std::array<std::vector<int>, 3> voxelToFaceConstraintIndices; // per-axis arrays of mappings from voxel index to face constraint index
+    voxelToFaceConstraintIndices.fill( std::vector<int>(voxels->numOccupied, -1) );
+
+    faceConstraints = constructFaceToFaceConstraints(voxels, voxelToFaceConstraintIndices);
+    longRangeConstraints = constructLongRangeConstraints(voxels, voxelToFaceConstraintIndices, { faceConstraints[0].size(), faceConstraints[1].size(), faceConstraints[2].size()});
+}
+
+/**
+ * Builds one list of face constraints per axis, each joining a voxel to its neighbor in the positive direction.
+ *
+ * The per-axis lists double as a graph coloring: within an axis, no two constraints share a particle. A constraint only touches the particles on
+ * voxel A's + face and voxel B's - face, and a voxel's + and - faces along an axis are disjoint, so even a chain of constraints through the same voxels
+ * never overlaps. That makes each axis a single color (3 in total), and the solvers process them as independent batches, one axis after another.
+ *
+ * Built in parallel, in two passes over the voxels: find each voxel's neighbors, then (after a prefix sum over which ones exist) write each constraint
+ * to its slot. Constraints end up in voxel order, same as a serial loop would put them.
+ */
 std::array<FaceConstraints, 3> PBD::constructFaceToFaceConstraints(const MSharedPtr<Voxels> voxels, std::array<std::vector<int>, 3>& voxelToFaceConstraintIndices) {
     std::array<FaceConstraints, 3> faceConstraints;
 
@@ -9,99 +62,193 @@ std::array<FaceConstraints, 3> PBD::constructFaceToFaceConstraints(const MShared
     const std::unordered_map<uint32_t, uint32_t>& mortonCodesToSortedIdx = voxels->mortonCodesToSortedIdx;
     const int numOccupied = voxels->numOccupied;
 
-    for (int i = 0; i < numOccupied; i++) {
-        std::array<uint32_t, 3> voxelCoords;
-        Utils::fromMortonCode(mortonCodes[i], voxelCoords[0], voxelCoords[1], voxelCoords[2]);
+    MThreadPool::init();
 
-        // Check each neighboring direction (x+, y+, z+) (only need to do half the neighbors to avoid double-counting)
-        for (int j = 0; j < 3; j++) {
-            std::array<uint32_t, 3> neighborCoords = voxelCoords;
-            neighborCoords[j] += 1;
-            int neighborMortonCode = static_cast<int>(Utils::toMortonCode(neighborCoords[0], neighborCoords[1], neighborCoords[2]));
-            if (mortonCodesToSortedIdx.find(neighborMortonCode) == mortonCodesToSortedIdx.end()) continue;
+    // Count pass: each voxel's neighbor in each direction (x+, y+, z+) (only need to do half the neighbors to avoid double-counting), or -1.
+    // Stored in voxelToFaceConstraintIndices for now, and replaced by constraint indices below.
+    CPUSolver::parallelFor(numOccupied, constructionVoxelsPerTask, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            std::array<uint32_t, 3> voxelCoords;
+            Utils::fromMortonCode(mortonCodes[i], voxelCoords[0], voxelCoords[1], voxelCoords[2]);
 
-            faceConstraints[j].voxelIndices.push_back(i);
-            faceConstraints[j].voxelIndices.push_back(mortonCodesToSortedIdx.at(neighborMortonCode));
+            for (int j = 0; j < 3; j++) {
+                std::array<uint32_t, 3> neighborCoords = voxelCoords;
+                neighborCoords[j] += 1;
+                auto neighbor = mortonCodesToSortedIdx.find(Utils::toMortonCode(neighborCoords[0], neighborCoords[1], neighborCoords[2]));
+                voxelToFaceConstraintIndices[j][i] = (neighbor == mortonCodesToSortedIdx.end()) ? -1 : static_cast<int>(neighbor->second);
+            }
+        }
+    });
+
+    // Prefix sum: each voxel's constraint index per axis
+    std::array<std::vector<int>, 3> neighborIndices;
+    for (int j = 0; j < 3; j++) {
+        neighborIndices[j] = voxelToFaceConstraintIndices[j];
+        int numConstraints = 0;
+        for (int i = 0; i < numOccupied; i++) {
+            voxelToFaceConstraintIndices[j][i] = (neighborIndices[j][i] == -1) ? -1 : numConstraints++;
+        }
+
+        faceConstraints[j].voxelIndices.resize(2 * static_cast<size_t>(numConstraints));
+        faceConstraints[j].limits.assign(2 * static_cast<size_t>(numConstraints), 0.0f); // Initial constraint limits - can be updated via voxel paint tool
+    }
 
-            faceConstraints[j].limits.push_back(0.0f); // Initial constraint limits - can be updated via voxel paint tool
-            faceConstraints[j].limits.push_back(0.0f);
+    // Fill pass
+    CPUSolver::parallelFor(numOccupied, constructionVoxelsPerTask, [&](int begin, int end) {
+        for (int j = 0; j < 3; j++) {
+            for (int i = begin; i < end; i++) {
+                int constraintIdx = voxelToFaceConstraintIndices[j][i];
+                if (constraintIdx == -1) continue;
 
-            voxelToFaceConstraintIndices[j][i] = static_cast<int>(faceConstraints[j].size() - 1);
+                faceConstraints[j].voxelIndices[constraintIdx * 2] = i;
+                faceConstraints[j].voxelIndices[constraintIdx * 2 + 1] = neighborIndices[j][i];
+            }
         }
-    }
+    });
 
+    MThreadPool::release();
     return faceConstraints;
 }
 
+/**
+ * Builds a long-range constraint for each voxel whose 2x2x2 block (the voxel and its neighbors in the positive directions) is fully occupied,
+ * plus, per face constraint, the (up to 4) long-range constraints whose block it's an internal face of.
+ *
+ * Same two-pass structure as constructFaceToFaceConstraints: check which blocks are full, prefix sum, then fill in parallel.
+ * The face-to-long-range slot for a given block is fixed by which corner of the block the face's voxel is at (the two corner bits off the face's axis),
+ * so concurrent writes never collide and the result doesn't depend on thread timing.
+ *
+ * Then the coarser levels (see LongRangeConstraints::blockSize), which only use blocks aligned to their size - i.e. nodes of the Morton code hierarchy.
+ * Those don't overlap, so each face constraint is internal to at most one block per coarser level, and gets one more slot per level.
+ */
 LongRangeConstraints PBD::constructLongRangeConstraints(const MSharedPtr<Voxels> voxels, const std::array<std::vector<int>, 3>& voxelToFaceConstraintIndices, std::array<uint, 3> faceConstraintsCounts) {
     LongRangeConstraints longRangeConstraints;
-    // Up to 4 long range constraint indices per face constraint index
+    // Up to LONG_RANGE_SLOTS_PER_FACE long range constraint indices per face constraint index
     // Use 0xFFFFFFF as sentinel for no LR constraint
-    longRangeConstraints.faceIdxToLRConstraintIndices[0].resize(4 * faceConstraintsCounts[0], 0xFFFFFFFF);
-    longRangeConstraints.faceIdxToLRConstraintIndices[1].resize(4 * faceConstraintsCounts[1], 0xFFFFFFFF);
-    longRangeConstraints.faceIdxToLRConstraintIndices[2].resize(4 * faceConstraintsCounts[2], 0xFFFFFFFF);
+    longRangeConstraints.faceIdxToLRConstraintIndices[0].resize(LONG_RANGE_SLOTS_PER_FACE * faceConstraintsCounts[0], 0xFFFFFFFF);
+    longRangeConstraints.faceIdxToLRConstraintIndices[1].resize(LONG_RANGE_SLOTS_PER_FACE * faceConstraintsCounts[1], 0xFFFFFFFF);
+    longRangeConstraints.faceIdxToLRConstraintIndices[2].resize(LONG_RANGE_SLOTS_PER_FACE * faceConstraintsCounts[2], 0xFFFFFFFF);
 
     const std::vector<uint32_t>& mortonCodes = voxels->mortonCodes;
     const std::unordered_map<uint32_t, uint32_t>& mortonCodesToSortedIdx = voxels->mortonCodesToSortedIdx;
     const int numOccupied = voxels->numOccupied;
-    
-    std::array<uint, 8> particleIndices;
-    std::array<std::vector<uint>, 3> faceConstraintIndices; // 4 internal face constraints per axis per LR constraint
-    std::array<std::vector<uint>, 3> faceConstraintVisitedCounts = { std::vector<uint>(faceConstraintsCounts[0], 0), std::vector<uint>(faceConstraintsCounts[1], 0), std::vector<uint>(faceConstraintsCounts[2], 0) };
 
-    for (int i = 0; i < numOccupied; i++) {
+    // The voxel index at each corner of voxel i's block, or false if the block isn't full.
+    auto getBlockVoxels = [&](int i, std::array<uint, 8>& blockVoxels) {
         std::array<uint32_t, 3> voxelCoords;
         Utils::fromMortonCode(mortonCodes[i], voxelCoords[0], voxelCoords[1], voxelCoords[2]);
-        bool hasAllNeighbors = true;
-        faceConstraintIndices[0].clear(); faceConstraintIndices[1].clear(); faceConstraintIndices[2].clear();
 
         for (uint corner = 0; corner < 8; ++corner) {
             // Note that this can include the voxel itself (intentionally)
-            std::array<uint32_t, 3> neighborCoords = {
+            auto neighbor = mortonCodesToSortedIdx.find(Utils::toMortonCode(
                 voxelCoords[0] + ((corner >> 0) & 1),
                 voxelCoords[1] + ((corner >> 1) & 1),
                 voxelCoords[2] + ((corner >> 2) & 1)
-            }; 
+            ));
+            if (neighbor == mortonCodesToSortedIdx.end()) return false;
 
-            int neighborMortonCode = static_cast<int>(Utils::toMortonCode(neighborCoords[0], neighborCoords[1], neighborCoords[2]));
-            if (mortonCodesToSortedIdx.find(neighborMortonCode) == mortonCodesToSortedIdx.end()) {
-                hasAllNeighbors = false;
-                break;
-            };
-            
-            // Get the particle involved in the constraint from this neighbor voxel
-            // Hijack the lower 4 bits of each entry to store a broken face constraint counter
-            uint neighborVoxelIdx = mortonCodesToSortedIdx.at(neighborMortonCode);
-            particleIndices[corner] = (neighborVoxelIdx * 8u + corner) << 4; // (28 bits for particle indices is far more than enough)
+            blockVoxels[corner] = neighbor->second;
+        }
+        return true;
+    };
 
-            // Get the face constraints this voxel contributes to this LR constraint
-            for (int axis = 0; axis < 3; ++axis) {
-                if (((corner >> axis) & 1) != 0) continue; // only internal faces
+    // An aligned block of n^3 voxels is a run of n^3 consecutive Morton codes, starting at a multiple of n^3. Voxels are sorted by Morton code,
+    // so such a block is fully occupied exactly when voxel i is at its start and the voxel n^3 - 1 places later has its last code.
+    auto isAlignedBlockStart = [&](int i, uint blockVolume) {
+        return (mortonCodes[i] & (blockVolume - 1)) == 0
+            && i + static_cast<int>(blockVolume) - 1 < numOccupied
+            && mortonCodes[i + blockVolume - 1] == mortonCodes[i] + blockVolume - 1;
+    };
 
-                int faceConstraintIdx = voxelToFaceConstraintIndices[axis][neighborVoxelIdx];
-                if (faceConstraintIdx == -1) continue;
+    MThreadPool::init();
 
-                faceConstraintIndices[axis].push_back(faceConstraintIdx);
-                faceConstraintVisitedCounts[axis][faceConstraintIdx]++;
+    // Count pass
+    std::array<std::vector<uint>, LONG_RANGE_LEVELS> longRangeConstraintIndices;
+    for (std::vector<uint>& levelConstraintIndices : longRangeConstraintIndices) {
+        levelConstraintIndices.resize(numOccupied);
+    }
+    CPUSolver::parallelFor(numOccupied, constructionVoxelsPerTask, [&](int begin, int end) {
+        std::array<uint, 8> blockVoxels;
+        for (int i = begin; i < end; i++) {
+            longRangeConstraintIndices[0][i] = getBlockVoxels(i, blockVoxels) ? 1u : 0u;
+            for (int level = 1; level < LONG_RANGE_LEVELS; ++level) {
+                uint blockSize = LongRangeConstraints::blockSize(level);
+                longRangeConstraintIndices[level][i] = isAlignedBlockStart(i, blockSize * blockSize * blockSize) ? 1u : 0u;
+            }
+        }
+    });
+
+    // Prefix sum, one level after another
+    uint numLongRangeConstraints = 0;
+    for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+        longRangeConstraints.levelOffsets[level] = numLongRangeConstraints;
+        for (int i = 0; i < numOccupied; i++) {
+            uint hasConstraint = longRangeConstraintIndices[level][i];
+            longRangeConstraintIndices[level][i] = hasConstraint ? numLongRangeConstraints++ : 0xFFFFFFFF;
+        }
+    }
+    longRangeConstraints.levelOffsets[LONG_RANGE_LEVELS] = numLongRangeConstraints;
+    longRangeConstraints.particleIndices.resize(8 * static_cast<size_t>(numLongRangeConstraints));
+
+    // Fill pass
+    CPUSolver::parallelFor(numOccupied, constructionVoxelsPerTask, [&](int begin, int end) {
+        std::array<uint, 8> blockVoxels;
+        for (int i = begin; i < end; i++) {
+            uint longRangeConstraintIdx = longRangeConstraintIndices[0][i];
+            if (longRangeConstraintIdx == 0xFFFFFFFF) continue;
+            getBlockVoxels(i, blockVoxels);
+
+            for (uint corner = 0; corner < 8; ++corner) {
+                // Get the particle involved in the constraint from this neighbor voxel
+                // Hijack the lower 4 bits of each entry to store a broken face constraint counter
+                longRangeConstraints.particleIndices[longRangeConstraintIdx * 8 + corner] = (blockVoxels[corner] * 8u + corner) << 4; // (28 bits for particle indices is far more than enough)
+
+                // Record this LR constraint against the face constraints this voxel contributes to it
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (((corner >> axis) & 1) != 0) continue; // only internal faces
+
+                    int faceConstraintIdx = voxelToFaceConstraintIndices[axis][blockVoxels[corner]];
+                    if (faceConstraintIdx == -1) continue;
+
+                    uint slot = ((corner >> ((axis + 1) % 3)) & 1) | (((corner >> ((axis + 2) % 3)) & 1) << 1);
+                    longRangeConstraints.faceIdxToLRConstraintIndices[axis][faceConstraintIdx * LONG_RANGE_SLOTS_PER_FACE + slot] = longRangeConstraintIdx;
+                }
             }
         }
 
-        if (!hasAllNeighbors) continue;
-        
-        // Record the particle indices for this long-range constraint
-        longRangeConstraints.particleIndices.insert( longRangeConstraints.particleIndices.end(), particleIndices.begin(), particleIndices.end() );
-        
-        // Record the face constraint indices for this long-range constraint
-        uint currentLRConstraintIdx = static_cast<uint>(longRangeConstraints.particleIndices.size() / 8 - 1);
-        for (int axis = 0; axis < 3; ++axis) {
-            for (uint faceConstraintIdx : faceConstraintIndices[axis]) {
-                uint visitedCount = faceConstraintVisitedCounts[axis][faceConstraintIdx];
-                uint lrConstraintArrayOffset = faceConstraintIdx * 4 + (visitedCount - 1);
-                longRangeConstraints.faceIdxToLRConstraintIndices[axis][lrConstraintArrayOffset] = currentLRConstraintIdx;
+        for (int level = 1; level < LONG_RANGE_LEVELS; ++level) {
+            const uint blockSize = LongRangeConstraints::blockSize(level);
+            const uint blockVolume = blockSize * blockSize * blockSize;
+            for (int i = begin; i < end; i++) {
+                uint longRangeConstraintIdx = longRangeConstraintIndices[level][i];
+                if (longRangeConstraintIdx == 0xFFFFFFFF) continue;
+
+                // The block is fully occupied, so a voxel's index is just the block's first index plus its Morton code within the block
+                for (uint corner = 0; corner < 8; ++corner) {
+                    uint cornerVoxelIdx = i + Utils::toMortonCode(
+                        ((corner >> 0) & 1) * (blockSize - 1),
+                        ((corner >> 1) & 1) * (blockSize - 1),
+                        ((corner >> 2) & 1) * (blockSize - 1)
+                    );
+                    longRangeConstraints.particleIndices[longRangeConstraintIdx * 8 + corner] = (cornerVoxelIdx * 8u + corner) << 4;
+                }
+
+                for (uint voxelIdx = i; voxelIdx < i + blockVolume; ++voxelIdx) {
+                    std::array<uint32_t, 3> voxelCoords;
+                    Utils::fromMortonCode(mortonCodes[voxelIdx], voxelCoords[0], voxelCoords[1], voxelCoords[2]);
+                    for (int axis = 0; axis < 3; ++axis) {
+                        if ((voxelCoords[axis] & (blockSize - 1)) == blockSize - 1) continue; // only internal faces
+
+                        int faceConstraintIdx = voxelToFaceConstraintIndices[axis][voxelIdx];
+                        if (faceConstraintIdx == -1) continue;
+                        longRangeConstraints.faceIdxToLRConstraintIndices[axis][faceConstraintIdx * LONG_RANGE_SLOTS_PER_FACE + 4 + (level - 1)] = longRangeConstraintIdx;
+                    }
+                }
             }
         }
-    }
+    });
 
+    MThreadPool::release();
     return longRangeConstraints;
 }
 
@@ -142,9 +289,10 @@ ParticleDataContainer PBD::createParticles(const MSharedPtr<Voxels> voxels) {
 
 void PBD::createComputeShaders(
     const MSharedPtr<Voxels> voxels, 
-    const std::array<FaceConstraints, 3>& faceConstraints,
-    const LongRangeConstraints& longRangeConstraints
+    std::shared_ptr<const ConstraintTopology> constraintTopology
 ) {
+    const std::array<FaceConstraints, 3>& faceConstraints = constraintTopology->faceConstraints;
+    const LongRangeConstraints& longRangeConstraints = constraintTopology->longRangeConstraints;
 
     float particleRadius = static_cast<float>(voxels->voxelSize) * 0.25f;
     // This is really the rest volume of the cube made from particle centers, which are offset one particle radius from each corner of the voxel
@@ -166,7 +314,7 @@ void PBD::createComputeShaders(
 
 	faceConstraintsCompute = FaceConstraintsCompute(
 		faceConstraints,
-        longRangeConstraints.faceIdxToLRConstraintIndices,
+        constraintTopology->faceIdxToLRConstraintUAVs,
         numParticles(),
         particleRadius,
         voxelRestVolume
@@ -175,6 +323,26 @@ void PBD::createComputeShaders(
     faceConstraintsCompute.setLongRangeConstraintCountersUAV(longRangeConstraintsCompute.getLongRangeParticleIndicesUAV());
 
     preVGSCompute = PreVGSCompute(numParticles());
+
+    // Same defaults as the compute shaders above. The mutable constraint state is pulled down from them on the first CPU-simulated frame
+    // (see simulateSubstepOnCPU), so objects that are only ever simulated on the GPU don't keep a host copy.
+    cpuSimulationObject.numParticles = numParticles();
+    cpuSimulationObject.constraintTopology = std::move(constraintTopology);
+    cpuSimulationObject.faceConstraints = {};
+    cpuSimulationObject.longRangeConstraints = {};
+    cpuSimulationObject.islands.invalidate();
+    cpuSimulationObject.hasSleepingVoxels = false;
+    cpuSimulationObject.flatFaceConstraintsValid = false;
+    cpuConstraintsVersion = UINT_MAX;
+    cpuSimulationObject.vgsConstants = { 0.5f, 1.0f, particleRadius, voxelRestVolume, 3, numParticles() / 8, 0.0f, 0.0f };
+    for (int level = 0; level < LONG_RANGE_LEVELS; ++level) {
+        float radiusScale = LongRangeConstraints::particleRadiusScale(level);
+        VGSConstants& longRangeVGSConstants = cpuSimulationObject.longRangeVGSConstants[level];
+        longRangeVGSConstants = cpuSimulationObject.vgsConstants;
+        longRangeVGSConstants.particleRadius = particleRadius * radiusScale;
+        longRangeVGSConstants.voxelRestVolume = voxelRestVolume * radiusScale * radiusScale * radiusScale;
+    }
+    cpuSimulationObject.preVGSConstants = { -9.81f, 1.0f / 600.0f, numParticles(), 0.0f, 0.0f, 0, 0, 0 };
 }
 
 // See note in PBDNode destructor
@@ -206,6 +374,7 @@ void PBD::updateFaceConstraintsWithPaintValues(
     float constraintHigh
 ) {
     faceConstraintsCompute.updateFaceConstraintsFromPaint(paintDeltaUAV, paintValueUAV, constraintLow, constraintHigh);
+    cpuConstraintsVersion = UINT_MAX;
 }
 
 void PBD::updateParticleMassWithPaintValues(
@@ -223,10 +392,26 @@ void PBD::updateSimulationParameters(const SimulationParameters& simParams) {
     if (simParams == simulationParameters) return;
 
     const float compliance = simParams.compliance / simParams.secondsPerFrame; // normalize compliance by timestep to keep behavior consistent at different substeps per frame.
-    vgsCompute.updateVGSParameters(simParams.vgsRelaxation, simParams.vgsEdgeUniformity, static_cast<uint>(simParams.vgsIterations), compliance);
-    faceConstraintsCompute.updateVGSParameters(simParams.vgsRelaxation, simParams.vgsEdgeUniformity, static_cast<uint>(simParams.vgsIterations), compliance);
-    longRangeConstraintsCompute.updateVGSParameters(simParams.vgsRelaxation, simParams.vgsEdgeUniformity, static_cast<uint>(simParams.vgsIterations), compliance);
+    vgsCompute.updateVGSParameters(simParams.vgsRelaxation, simParams.vgsEdgeUniformity, static_cast<uint>(simParams.vgsIterations), compliance, simParams.vgsChebyshevRho);
+    faceConstraintsCompute.updateVGSParameters(simParams.vgsRelaxation, simParams.vgsEdgeUniformity, static_cast<uint>(simParams.vgsIterations), compliance, simParams.vgsChebyshevRho);
+    longRangeConstraintsCompute.updateVGSParameters(simParams.vgsRelaxation, simParams.vgsEdgeUniformity, static_cast<uint>(simParams.vgsIterations), compliance, simParams.vgsChebyshevRho);
+    longRangeConstraintsCompute.setNumActiveLevels(static_cast<int>(simParams.longRangeLevels));
     preVGSCompute.updatePreVgsConstants(simParams.secondsPerFrame, simParams.gravityStrength);
+
+    auto updateCPUVGSConstants = [&](VGSConstants& vgsConstants) {
+        vgsConstants.relaxation = simParams.vgsRelaxation;
+        vgsConstants.edgeUniformity = simParams.vgsEdgeUniformity;
+        vgsConstants.iterCount = static_cast<uint>(simParams.vgsIterations);
+        vgsConstants.compliance = compliance;
+        vgsConstants.chebyshevRho = simParams.vgsChebyshevRho;
+    };
+    updateCPUVGSConstants(cpuSimulationObject.vgsConstants);
+    for (VGSConstants& longRangeVGSConstants : cpuSimulationObject.longRangeVGSConstants) {
+        updateCPUVGSConstants(longRangeVGSConstants);
+    }
+    cpuSimulationObject.numLongRangeLevels = std::clamp(static_cast<int>(simParams.longRangeLevels), 1, LONG_RANGE_LEVELS);
+    cpuSimulationObject.preVGSConstants.timeStep = simParams.secondsPerFrame;
+    cpuSimulationObject.preVGSConstants.gravityStrength = simParams.gravityStrength;
 }
 
 void PBD::mergeRenderParticles() {
@@ -236,8 +421,106 @@ void PBD::mergeRenderParticles() {
 void PBD::simulateSubstep() {
     if (!initialized) return;
 
+    if (GlobalSolver::isCPUSimulationActive()) {
+        simulateSubstepOnCPU();
+        return;
+    }
+
+    // In batched mode, the global solver collects every object once per frame and runs their passes together (see BatchedConstraintsCompute).
+    if (GlobalSolver::isCollectingBatch()) {
+        GlobalSolver::addToBatch(getBatchedObjectSource());
+        return;
+    }
+
+    const FractureEventLog& fractureEventLog = GlobalSolver::getFractureEventLog();
+    faceConstraintsCompute.setFractureEventRecording(
+        fractureEventLog.isRecording(), GlobalSolver::getCurrentSubstep(), cpuSimulationObject.particleOffset / 8,
+        fractureEventLog.getEventsUAV(), fractureEventLog.getEventCountUAV()
+    );
+
     preVGSCompute.dispatch();
     vgsCompute.dispatch();
     longRangeConstraintsCompute.dispatch();
     faceConstraintsCompute.dispatch();
+}
+
+BatchedObjectSource PBD::getBatchedObjectSource() const {
+    const ConstraintTopology& topology = *cpuSimulationObject.constraintTopology;
+    BatchedObjectSource source;
+    source.particleOffset = cpuSimulationObject.particleOffset;
+    source.numParticles = cpuSimulationObject.numParticles;
+    source.faceConstraintIndexBuffers = faceConstraintsCompute.getFaceConstraintIndexBuffers();
+    source.faceConstraintLimitsBuffers = faceConstraintsCompute.getFaceConstraintLimitsBuffers();
+    source.faceIdxToLRConstraintBuffers = topology.faceIdxToLRConstraintBuffers;
+    for (int axis = 0; axis < 3; ++axis) {
+        source.numFaceConstraints[axis] = topology.faceConstraints[axis].size();
+    }
+    source.longRangeParticleIndicesBuffer = longRangeConstraintsCompute.getLongRangeParticleIndicesBuffer();
+    source.longRangeLevelOffsets = topology.longRangeConstraints.levelOffsets;
+    source.numLongRangeLevels = cpuSimulationObject.numLongRangeLevels;
+    // The host mirror's constants are kept in sync with the shaders' (see updateSimulationParameters)
+    source.params = { cpuSimulationObject.vgsConstants, cpuSimulationObject.preVGSConstants.gravityStrength, cpuSimulationObject.preVGSConstants.timeStep };
+    return source;
+}
+
+void PBD::getPieceBounds(std::vector<MBoundingBox>& bounds) const {
+    const CPUSimulationBuffers& cpuBuffers = GlobalSolver::getCPUSimulationBuffers();
+    if (!cpuSimulationObject.islands.isValid() || cpuBuffers.particles.size() < cpuSimulationObject.particleOffset + cpuSimulationObject.numParticles) {
+        bounds.clear();
+        return;
+    }
+
+    cpuSimulationObject.islands.computeBounds(cpuBuffers.particles.data() + cpuSimulationObject.particleOffset, bounds);
+}
+
+void PBD::simulateSubstepOnCPU() {
+    CPUSimulationBuffers& cpuBuffers = GlobalSolver::getCPUSimulationBuffers();
+
+    // Particle state is synced from the GPU every frame, so the per-frame bookkeeping runs on the first substep after that.
+    if (cpuSyncId != cpuBuffers.syncId) {
+        // The host copy of the constraints is authoritative while only the CPU backend touches them: breaks during CPU substeps are applied to it
+        // (and uploaded) as they happen. Only when they may have changed outside of it (a GPU-simulated frame, a cache restore, paint) is the
+        // GPU state pulled down again - and if it differs, the pieces and the flattened constraints are rebuilt.
+        if (cpuConstraintsVersion != cpuBuffers.gpuConstraintsVersion) {
+            std::array<FaceConstraints, 3> faceConstraints;
+            faceConstraintsCompute.copyConstraintsToHost(faceConstraints);
+            for (int axis = 0; axis < 3; ++axis) {
+                if (faceConstraints[axis].voxelIndices != cpuSimulationObject.faceConstraints[axis].voxelIndices) {
+                    cpuSimulationObject.islands.invalidate();
+                    cpuSimulationObject.flatFaceConstraintsValid = false;
+                }
+                if (faceConstraints[axis].limits != cpuSimulationObject.faceConstraints[axis].limits) {
+                    cpuSimulationObject.flatFaceConstraintsValid = false;
+                }
+            }
+            cpuSimulationObject.faceConstraints = std::move(faceConstraints);
+            longRangeConstraintsCompute.copyParticleIndicesToHost(cpuSimulationObject.longRangeConstraints.particleIndices);
+            cpuConstraintsVersion = cpuBuffers.gpuConstraintsVersion;
+        }
+        cpuSyncId = cpuBuffers.syncId;
+
+#ifdef _DEBUG
+        // Once a frame, check that the AVX2 VGS kernel still agrees with the scalar reference on this object's voxels.
+        // (Heavily inverted voxels can legitimately differ: which edge gets flipped may come down to rounding.)
+        if (VGSSimd::isSupported()) {
+            const VGSConstants& vgsConstants = cpuSimulationObject.vgsConstants;
+            const Particle* particles = cpuBuffers.particles.data() + cpuSimulationObject.particleOffset;
+            float deviation = VGSSimd::maxDeviationFromScalar(particles, static_cast<int>(cpuSimulationObject.numParticles / 8), vgsConstants, false);
+            if (deviation > 1e-3f * vgsConstants.particleRadius) {
+                MGlobal::displayWarning(MString("SIMD VGS kernel deviates from the scalar reference by ") + deviation);
+            }
+        }
+#endif
+
+        CPUSolver::updateIslands(cpuSimulationObject);
+        CPUSolver::updateFlatFaceConstraints(cpuSimulationObject);
+        CPUSolver::updateSleepingIslands(cpuSimulationObject, cpuBuffers);
+        CPUSolver::updateRigidClusters(cpuSimulationObject, cpuBuffers);
+    }
+
+    uint numBroken = CPUSolver::simulateSubstep(cpuSimulationObject, cpuBuffers);
+    if (numBroken == 0) return;
+
+    faceConstraintsCompute.copyConstraintIndicesFromHost(cpuSimulationObject.faceConstraints);
+    longRangeConstraintsCompute.copyParticleIndicesFromHost(cpuSimulationObject.longRangeConstraints.particleIndices);
 }
\ No newline at end of file
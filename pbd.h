@@ -9,8 +9,12 @@
 #include "directx/compute/faceconstraintscompute.h"
 #include "custommayaconstructs/data/particledata.h"
 #include "directx/compute/longrangeconstraintscompute.h"
+#include "directx/compute/batchedconstraintscompute.h"
+#include "cpu/cpusolver.h"
+#include "constrainttopology.h"
 
 #include <maya/MSharedPtr.h>
+#include <memory>
 
 struct SimulationParameters {
     float compliance;
@@ -19,6 +23,8 @@ struct SimulationParameters {
     uint vgsIterations;
     float gravityStrength;
     float secondsPerFrame;
+    uint longRangeLevels;
+    float vgsChebyshevRho;
     
     bool operator==(const SimulationParameters& other) const {
         return (compliance == other.compliance &&
@@ -26,7 +32,9 @@ struct SimulationParameters {
                 vgsEdgeUniformity == other.vgsEdgeUniformity &&
                 vgsIterations == other.vgsIterations &&
                 gravityStrength == other.gravityStrength &&
-                secondsPerFrame == other.secondsPerFrame);
+                secondsPerFrame == other.secondsPerFrame &&
+                longRangeLevels == other.longRangeLevels &&
+                vgsChebyshevRho == other.vgsChebyshevRho);
     };
 };
 
@@ -37,16 +45,21 @@ public:
     PBD() = default;
     ~PBD() = default;
    
-    std::array<FaceConstraints, 3> constructFaceToFaceConstraints(MSharedPtr<Voxels> voxels, std::array<std::vector<int>, 3>& voxelToFaceConstraintIndices);
+    // The constraint topology for these voxels: shared with any live object whose voxels are the same, otherwise built (and registered for later objects).
+    static std::shared_ptr<const ConstraintTopology> acquireConstraintTopology(MSharedPtr<Voxels> voxels);
 
-    LongRangeConstraints constructLongRangeConstraints(MSharedPtr<Voxels> voxels, const std::array<std::vector<int>, 3>& voxelToFaceConstraintIndices, std::array<uint, 3> faceConstraintsCounts);
+    // Builds the face and long-range constraints for these voxels from scratch (the CPU side of a ConstraintTopology).
+    static void constructConstraints(MSharedPtr<Voxels> voxels, std::array<FaceConstraints, 3>& faceConstraints, LongRangeConstraints& longRangeConstraints);
+
+    static std::array<FaceConstraints, 3> constructFaceToFaceConstraints(MSharedPtr<Voxels> voxels, std::array<std::vector<int>, 3>& voxelToFaceConstraintIndices);
+
+    static LongRangeConstraints constructLongRangeConstraints(MSharedPtr<Voxels> voxels, const std::array<std::vector<int>, 3>& voxelToFaceConstraintIndices, std::array<uint, 3> faceConstraintsCounts);
 
     ParticleDataContainer createParticles(MSharedPtr<Voxels> voxels);
 
     void createComputeShaders(
         MSharedPtr<Voxels> voxels, 
-        const std::array<FaceConstraints, 3>& faceConstraints,
-        const LongRangeConstraints& longRangeConstraints
+        std::shared_ptr<const ConstraintTopology> constraintTopology
     );
 
     void setGPUResourceHandles(
@@ -62,6 +75,10 @@ public:
         this->initialized = initialized;
     }
 
+    void setParticleBufferOffset(uint particleBufferOffset) {
+        cpuSimulationObject.particleOffset = particleBufferOffset;
+    }
+
     uint numParticles() const {
         return totalParticles;
     }
@@ -90,6 +107,14 @@ public:
         return renderParticlesSRV;
     }
 
+    // The separate pieces this object has broken into (see VoxelIslands), as of the last CPU-simulated frame. Not tracked on the GPU; 0 until then.
+    uint getNumPieces() const {
+        return cpuSimulationObject.islands.isValid() ? cpuSimulationObject.islands.numIslands() : 0;
+    }
+
+    // Bounds of each piece, as of the last CPU-simulated frame.
+    void getPieceBounds(std::vector<MBoundingBox>& bounds) const;
+
 private:
     // Inverse mass (w) and particle radius stored, packed at half-precision, as 4th component.
     // TODO: particles do not need to be stored after the node is done initializing. (The global solver maintains them on the GPU, and should save them as a node attribute).
@@ -101,6 +126,16 @@ private:
     ComPtr<ID3D11UnorderedAccessView> renderParticlesUAV;
     ComPtr<ID3D11ShaderResourceView> renderParticlesSRV;
     SimulationParameters simulationParameters;
+    inline static constexpr int constructionVoxelsPerTask = 4096; // Grain size for the parallel constraint construction passes
+
+    // Host-side mirror of this object's constraints, for the CPU backend (see GlobalSolver::aCPUSimulation)
+    CPUSimulationObject cpuSimulationObject;
+    uint cpuSyncId = UINT_MAX;
+    // The CPUSimulationBuffers::gpuConstraintsVersion the host constraints were last read back at. Reset to force a readback
+    // when this object's constraints change on the GPU by themselves (paint).
+    uint cpuConstraintsVersion = UINT_MAX;
+    void simulateSubstepOnCPU();
+    BatchedObjectSource getBatchedObjectSource() const;
 
     // Shaders
     VGSCompute vgsCompute;
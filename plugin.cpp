@@ -20,6 +20,10 @@
 #include "custommayaconstructs/commands/createcollidercommand.h"
 #include "custommayaconstructs/commands/changevoxeleditmodecommand.h"
 #include "custommayaconstructs/commands/applyvoxelpaintcommand.h"
+#include "custommayaconstructs/commands/benchmarksimulationcommand.h"
+#include "custommayaconstructs/commands/hashsimulationcommand.h"
+#include "custommayaconstructs/commands/solverresidualscommand.h"
+#include "custommayaconstructs/commands/fractureeventscommand.h"
 #include "simulationcache.h"
 #include <maya/MDrawRegistry.h>
 #include <maya/MTransformationMatrix.h>
@@ -28,12 +32,15 @@
 #include "globalsolver.h"
 #include <maya/M3dView.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MSceneMessage.h>
+#include <maya/MDGMessage.h>
 
 // define EXPORT for exporting dll functions
 #define EXPORT __declspec(dllexport)
 
 VoxelRendererOverride* plugin::voxelRendererOverride = nullptr;
 MCallbackId plugin::toolChangedCallbackId;
+MCallbackIdArray plugin::voxelizerCacheCallbackIds;
 
 // Maya Plugin creator function
 void* plugin::creator()
@@ -105,6 +112,10 @@ MStatus plugin::doIt(const MArgList& argList)
 		pluginArgs.voxelizeInterior,
 		!pluginArgs.renderAsVoxels,
 		pluginArgs.clipTriangles,
+		pluginArgs.computeDistanceField,
+		pluginArgs.refineDistanceField,
+		pluginArgs.useWindingNumber,
+		pluginArgs.thinSurface,
 		voxelizedMeshDagPath,
 		status
 	);
@@ -197,6 +208,10 @@ PluginArgs plugin::parsePluginArgs(const MArgList& args) {
 		pluginArgs.voxelizeInterior = (type & 0x2) != 0;
 		pluginArgs.renderAsVoxels = (type & 0x4) != 0;
 		pluginArgs.clipTriangles = (type & 0x8) != 0;
+		pluginArgs.refineDistanceField = (type & 0x10) != 0;
+		pluginArgs.useWindingNumber = (type & 0x20) != 0;
+		pluginArgs.thinSurface = (type & 0x40) != 0;
+		pluginArgs.computeDistanceField = (type & 0x80) != 0 || pluginArgs.refineDistanceField; // (Refining implies computing)
 	}
 
 	return pluginArgs;
@@ -223,6 +238,10 @@ EXPORT MStatus initializePlugin(MObject obj)
 	CHECK_MSTATUS_AND_RETURN_IT(status);
 	plugin::toolChangedCallbackId = MEventMessage::addEventCallback("PostToolChanged", ChangeVoxelEditModeCommand::onExternalToolChange, nullptr);
 	plugin::voxelRendererOverride = new VoxelRendererOverride(VoxelRendererOverride::voxelRendererOverrideName);
+	auto clearVoxelizerCaches = [](void*) { Voxelizer::clearIntersectionCaches(); };
+	plugin::voxelizerCacheCallbackIds.append(MSceneMessage::addCallback(MSceneMessage::kBeforeNew, clearVoxelizerCaches));
+	plugin::voxelizerCacheCallbackIds.append(MSceneMessage::addCallback(MSceneMessage::kBeforeOpen, clearVoxelizerCaches));
+	plugin::voxelizerCacheCallbackIds.append(MDGMessage::addNodeRemovedCallback(Voxelizer::onNodeRemoved, "transform"));
 
 	// Register all commands, nodes, and custom plug data types
 	MFnPlugin plugin(obj, "cubit", "1.0", "Any");
@@ -234,6 +253,14 @@ EXPORT MStatus initializePlugin(MObject obj)
 	CHECK_MSTATUS(status);
 	status = plugin.registerCommand(ApplyVoxelPaintCommand::commandName, ApplyVoxelPaintCommand::creator, ApplyVoxelPaintCommand::syntax);
 	CHECK_MSTATUS(status);
+	status = plugin.registerCommand(BenchmarkSimulationCommand::commandName, BenchmarkSimulationCommand::creator, BenchmarkSimulationCommand::syntax);
+	CHECK_MSTATUS(status);
+	status = plugin.registerCommand(HashSimulationCommand::commandName, HashSimulationCommand::creator, HashSimulationCommand::syntax);
+	CHECK_MSTATUS(status);
+	status = plugin.registerCommand(SolverResidualsCommand::commandName, SolverResidualsCommand::creator, SolverResidualsCommand::syntax);
+	CHECK_MSTATUS(status);
+	status = plugin.registerCommand(FractureEventsCommand::commandName, FractureEventsCommand::creator, FractureEventsCommand::syntax);
+	CHECK_MSTATUS(status);
 	status = plugin.registerData(VoxelData::fullName, VoxelData::id, VoxelData::creator);
 	CHECK_MSTATUS(status);
 	status = plugin.registerData(ParticleData::fullName, ParticleData::id, ParticleData::creator);
@@ -325,6 +352,14 @@ EXPORT MStatus uninitializePlugin(MObject obj)
 	CHECK_MSTATUS(status);
 	status = plugin.deregisterCommand(ApplyVoxelPaintCommand::commandName);
 	CHECK_MSTATUS(status);
+	status = plugin.deregisterCommand(BenchmarkSimulationCommand::commandName);
+	CHECK_MSTATUS(status);
+	status = plugin.deregisterCommand(HashSimulationCommand::commandName);
+	CHECK_MSTATUS(status);
+	status = plugin.deregisterCommand(SolverResidualsCommand::commandName);
+	CHECK_MSTATUS(status);
+	status = plugin.deregisterCommand(FractureEventsCommand::commandName);
+	CHECK_MSTATUS(status);
     status = plugin.deregisterContextCommand("voxelDragContextCommand");
 	CHECK_MSTATUS(status);
 	status = plugin.deregisterContextCommand("voxelPaintContextCommand");
@@ -367,6 +402,9 @@ EXPORT MStatus uninitializePlugin(MObject obj)
     plugin::voxelRendererOverride = nullptr;
 	ComputeShader::clearShaderCache();
 	MEventMessage::removeCallback(plugin::toolChangedCallbackId);
+	MMessage::removeCallbacks(plugin::voxelizerCacheCallbackIds);
+	plugin::voxelizerCacheCallbackIds.clear();
+	Voxelizer::clearIntersectionCaches();
 
 	return status;
 }
@@ -6,6 +6,7 @@
 #include <array>
 #include "custommayaconstructs/draw/voxelrendereroverride.h"
 #include <maya/MEventMessage.h>
+#include <maya/MCallbackIdArray.h>
 using namespace MHWRender;
 
 struct PluginArgs {
@@ -18,6 +19,10 @@ struct PluginArgs {
 	bool voxelizeInterior{ false };
 	bool renderAsVoxels{ false };
 	bool clipTriangles{ false };
+	bool computeDistanceField{ false };
+	bool refineDistanceField{ false };
+	bool useWindingNumber{ false };
+	bool thinSurface{ false };
 };
 
 // TODO: move this command into the commands folder
@@ -34,6 +39,7 @@ public:
 
 	static VoxelRendererOverride* voxelRendererOverride;
 	static MCallbackId toolChangedCallbackId;
+	static MCallbackIdArray voxelizerCacheCallbackIds; // Scene change / node removal callbacks that evict Voxelizer's cached boolean results
 	
 private:
 };
\ No newline at end of file
@@ -33,12 +33,16 @@
 #define IDR_PNG_VOXELDRAG               131
 #define IDR_PNG_VOXELCOLLIDER           132
 #define IDR_PNG_VOXELPAINT              133
+#define IDR_SHADER20                    134
+#define IDR_SHADER21                    135
+#define IDR_SHADER22                    136
+#define IDR_SHADER23                    137
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        134
+#define _APS_NEXT_RESOURCE_VALUE        138
 #define _APS_NEXT_COMMAND_VALUE         40001
 #define _APS_NEXT_CONTROL_VALUE         1001
 #define _APS_NEXT_SYMED_VALUE           101
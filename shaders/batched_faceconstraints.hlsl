@@ -0,0 +1,99 @@
+#include "batched_shared.hlsl"
+
+StructuredBuffer<uint> faceIdxToLRConstraintIndices : register(t2); // Every object's, concatenated (long-range indices are still local to each object)
+StructuredBuffer<float> faceConstraintsLimits : register(t3);
+RWStructuredBuffer<int> faceConstraintsIndices : register(u1);      // Every object's, concatenated (voxel indices are still local to each object)
+RWStructuredBuffer<uint> isSurfaceVoxel : register(u2);             // The whole global buffer
+RWStructuredBuffer<uint> longRangeConstraintCounters : register(u3);
+RWStructuredBuffer<FractureEvent> fractureEvents : register(u6);
+RWStructuredBuffer<uint> fractureEventCount : register(u7);
+
+// Same as breakConstraint in faceconstraints.hlsl, with voxel indices already global and long-range indices offset to the object's.
+void breakConstraint(uint batchedConstraintIdx, uint constraintIdx, uint objectIdx, uint voxelAIdx, uint voxelBIdx, float strain) {
+    if (recordFractureEvents) {
+        uint eventIdx;
+        InterlockedAdd(fractureEventCount[0], 1, eventIdx);
+        if (eventIdx < FRACTURE_EVENT_CAPACITY) {
+            FractureEvent fractureEvent;
+            fractureEvent.constraintIdx = constraintIdx;
+            fractureEvent.axis = axis;
+            fractureEvent.voxelA = voxelAIdx;
+            fractureEvent.voxelB = voxelBIdx;
+            fractureEvent.strain = strain;
+            fractureEvent.substep = substep;
+            fractureEvents[eventIdx] = fractureEvent;
+        }
+    }
+
+    isSurfaceVoxel[voxelAIdx] = 1;
+    isSurfaceVoxel[voxelBIdx] = 1;
+
+    faceConstraintsIndices[batchedConstraintIdx * 2] = -1;
+    faceConstraintsIndices[batchedConstraintIdx * 2 + 1] = -1;
+
+    uint firstLongRangeConstraint = objectOffset(objectIdx, BATCH_OFFSET_LONG_RANGE_CONSTRAINTS);
+    for (int i = 0; i < LONG_RANGE_SLOTS_PER_FACE; ++i) {
+        uint longRangeConstraintIdx = faceIdxToLRConstraintIndices[batchedConstraintIdx * LONG_RANGE_SLOTS_PER_FACE + i];
+        if (longRangeConstraintIdx == 0xFFFFFFFF) continue;
+
+        uint counterIdx = (firstLongRangeConstraint + longRangeConstraintIdx) << 3;
+        uint expected = longRangeConstraintCounters[counterIdx];
+        [allow_uav_condition] while ((expected & 0xF) < 0xF) {
+            uint original;
+            InterlockedCompareExchange(longRangeConstraintCounters[counterIdx], expected, expected + 1, original);
+            if (original == expected) break;
+            expected = original;
+        }
+    }
+}
+
+// Same as faceconstraints.hlsl, over one axis of every object's face constraints.
+[numthreads(VGS_THREADS, 1, 1)]
+void main(
+    uint3 globalThreadId : SV_DispatchThreadID
+)
+{
+    uint batchedConstraintIdx = globalThreadId.x;
+    if (batchedConstraintIdx >= numThreads) return;
+
+    int localVoxelAIdx = faceConstraintsIndices[batchedConstraintIdx * 2];
+    int localVoxelBIdx = faceConstraintsIndices[batchedConstraintIdx * 2 + 1];
+    if (localVoxelAIdx == -1 || localVoxelBIdx == -1) return;
+
+    uint objectIdx = findObject(batchedConstraintIdx, BATCH_OFFSET_FACE_CONSTRAINTS + axis);
+    uint constraintIdx = batchedConstraintIdx - objectOffset(objectIdx, BATCH_OFFSET_FACE_CONSTRAINTS + axis);
+    uint voxelOffset = objectOffset(objectIdx, BATCH_OFFSET_PARTICLES) >> 3;
+    uint voxelAIdx = voxelOffset + localVoxelAIdx;
+    uint voxelBIdx = voxelOffset + localVoxelBIdx;
+    uint voxelAParticlesIdx = voxelAIdx << 3;
+    uint voxelBParticlesIdx = voxelBIdx << 3;
+
+    VGSConstants vgsConstants = objectParams[objectIdx].vgsConstants;
+    float tensionLimit = faceConstraintsLimits[batchedConstraintIdx * 2];
+    float compressionLimit = faceConstraintsLimits[batchedConstraintIdx * 2 + 1];
+
+    // Same (intentional) A/B index swap as faceconstraints.hlsl
+    Particle voxelParticles[8];
+    for (int i = 0; i < 4; ++i) {
+        voxelParticles[faceBParticles[i]] = particles[voxelAParticlesIdx + faceAParticles[i]];
+        voxelParticles[faceAParticles[i]] = particles[voxelBParticlesIdx + faceBParticles[i]];
+
+        float edgeLength = length(voxelParticles[faceAParticles[i]].position - voxelParticles[faceBParticles[i]].position);
+        float strain = (edgeLength - 2.0f * vgsConstants.particleRadius) / (2.0f * vgsConstants.particleRadius);
+        if (strain > tensionLimit || strain < compressionLimit) {
+            breakConstraint(batchedConstraintIdx, constraintIdx, objectIdx, voxelAIdx, voxelBIdx, strain);
+            return;
+        }
+    }
+
+    doVGSIterations(voxelParticles, vgsConstants, true);
+
+    for (int j = 0; j < 4; ++j) {
+        if (!massIsInfinite(voxelParticles[j])) {
+            particles[voxelAParticlesIdx + faceAParticles[j]] = voxelParticles[faceBParticles[j]];
+        }
+        if (!massIsInfinite(voxelParticles[j])) {
+            particles[voxelBParticlesIdx + faceBParticles[j]] = voxelParticles[faceAParticles[j]];
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#include "batched_shared.hlsl"
+
+StructuredBuffer<uint> longRangeParticleIndices : register(t2); // Every object's, concatenated (particle indices are still local to each object)
+
+// Same as longrangeconstraints.hlsl, over one level of every object's long-range constraints.
+[numthreads(VGS_THREADS, 1, 1)]
+void main(uint3 globalThreadId : SV_DispatchThreadID)
+{
+    if (globalThreadId.x >= numThreads) return;
+
+    uint objectIdx = findObject(globalThreadId.x, BATCH_OFFSET_LONG_RANGE_THREADS + level);
+    uint constraintIdx = objectOffset(objectIdx, BATCH_OFFSET_LONG_RANGE_CONSTRAINTS + level) 
+                       + (globalThreadId.x - objectOffset(objectIdx, BATCH_OFFSET_LONG_RANGE_THREADS + level));
+
+    // See longRangeConstraintBroken in longrangeconstraints.hlsl
+    uint particleIdx0 = longRangeParticleIndices[constraintIdx << 3];
+    if ((particleIdx0 & 0xF) >= 3u) return;
+
+    uint firstParticle = objectOffset(objectIdx, BATCH_OFFSET_PARTICLES);
+    uint particleIndices[8];
+    Particle constraintParticles[8];
+    [unroll] for (uint i = 0; i < 8; ++i) {
+        particleIndices[i] = firstParticle + (longRangeParticleIndices[(constraintIdx << 3) + i] >> 4);
+        constraintParticles[i] = particles[particleIndices[i]];
+    }
+
+    // Blocks act as voxels with bigger particles (see LongRangeConstraints::particleRadiusScale)
+    VGSConstants vgsConstants = objectParams[objectIdx].vgsConstants;
+    float radiusScale = 2.0f * (2u << level) - 1.0f;
+    vgsConstants.particleRadius *= radiusScale;
+    vgsConstants.voxelRestVolume *= radiusScale * radiusScale * radiusScale;
+
+    doVGSIterations(constraintParticles, vgsConstants, true);
+
+    [unroll] for (uint j = 0; j < 8; ++j) {
+        particles[particleIndices[j]] = constraintParticles[j];
+    }
+}
@@ -0,0 +1,27 @@
+#include "batched_shared.hlsl"
+
+StructuredBuffer<bool> isDragging : register(t2);
+RWStructuredBuffer<Particle> oldParticles : register(u1);
+
+// Same as prevgs.hlsl, over every object's particles, each with its own gravity and time step.
+[numthreads(VGS_THREADS, 1, 1)]
+void main(uint3 gId : SV_DispatchThreadID) 
+{
+    if (gId.x >= numThreads) return; 
+    
+    Particle particle = particles[gId.x];
+    if (massIsInfinite(particle)) return;
+
+    Particle oldParticle = oldParticles[gId.x];
+    oldParticles[gId.x] = particle;
+
+    int voxelIndex = gId.x >> 3;
+    if (isDragging[voxelIndex]) return;
+
+    BatchedObjectParams params = objectParams[findObject(gId.x, BATCH_OFFSET_PARTICLES)];
+    float3 delta = (particle.position - oldParticle.position);
+    delta += float3(0, params.gravityStrength, 0) * params.timeStep * params.timeStep;
+    particle.position += delta;
+    
+    particles[gId.x] = particle;
+}
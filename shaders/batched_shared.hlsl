@@ -0,0 +1,41 @@
+#include "vgs_core.hlsl"
+
+// Shared by the batched passes, which each run once over every object's items (see BatchedConstraintsCompute).
+cbuffer BatchedPassCB : register(b0)
+{
+    uint4 faceAParticles;   // Face constraint pass only (same as FaceConstraintsCB)
+    uint4 faceBParticles;
+    uint numThreads;        // Items in this pass, over all objects
+    uint numObjects;
+    uint axis;              // Face constraint pass only
+    uint level;             // Long-range constraint pass only
+    uint substep;           // Current substep within the frame (only used to stamp fracture events)
+    uint recordFractureEvents;
+    uint padding0;
+    uint padding1;
+};
+
+StructuredBuffer<uint> objectOffsets : register(t0);                  // BATCH_OFFSET_KINDS arrays of numObjects, see constants.hlsli
+StructuredBuffer<BatchedObjectParams> objectParams : register(t1);
+RWStructuredBuffer<Particle> particles : register(u0);               // The whole global buffer
+
+uint objectOffset(uint objectIdx, uint offsetKind) {
+    return objectOffsets[offsetKind * numObjects + objectIdx];
+}
+
+// Objects are laid out in the same order in every batched buffer, so the object an item belongs to is the last one starting at or before it.
+// (Objects with no items of a kind start where the next one does, so they're skipped over.)
+uint findObject(uint item, uint offsetKind) {
+    uint first = offsetKind * numObjects;
+    uint lo = 0;
+    uint hi = numObjects;
+    while (hi - lo > 1) {
+        uint mid = (lo + hi) >> 1;
+        if (objectOffsets[first + mid] <= item) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
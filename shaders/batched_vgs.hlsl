@@ -0,0 +1,24 @@
+#include "batched_shared.hlsl"
+
+// Same as vgs.hlsl, over every object's voxels.
+[numthreads(VGS_THREADS, 1, 1)]
+void main(uint3 globalThreadId : SV_DispatchThreadID)
+{
+    uint voxel_idx = globalThreadId.x;
+    if (voxel_idx >= numThreads) return;
+
+    uint start_idx = voxel_idx << 3;
+    VGSConstants vgsConstants = objectParams[findObject(start_idx, BATCH_OFFSET_PARTICLES)].vgsConstants;
+
+    Particle voxelParticles[8];
+    for (int i = 0; i < 8; ++i) {
+        voxelParticles[i] = particles[start_idx + i];
+    }
+
+    doVGSIterations(voxelParticles, vgsConstants, false);
+
+    for (int j = 0; j < 8; ++j) {
+        if (massIsInfinite(voxelParticles[j])) continue;
+        particles[start_idx + j] = voxelParticles[j];
+    }
+}
@@ -29,9 +29,10 @@ void main(uint3 gId : SV_DispatchThreadID)
         for (int y = gridMinOverlap.y; y <= gridMaxOverlap.y; ++y) {
             for (int x = gridMinOverlap.x; x <= gridMaxOverlap.x; ++x) {
                 int cellHash = getParticleCellHash(x, y, z);
+                // The counts were scanned inclusively, so each cell's count starts one past its last slot - hence the - 1.
                 int sortedParticleIndex;
                 InterlockedAdd(collisionCellParticleCounts[cellHash], -1, sortedParticleIndex);
-                particlesByCollisionCell[sortedParticleIndex] = gId.x;
+                particlesByCollisionCell[sortedParticleIndex - 1] = gId.x;
             }
         }
     }
@@ -13,6 +13,21 @@
 #define SOLVE_COLLISION_THREADS 32        // CAREFUL: this directly affects the amount of shared memory available to each collision cell.
 #define PREFIX_SCAN_THREADS 512  // This MUST be a power of two (many assumptions in the scan code rely on this).
 #define MAX_COLLIDERS 256
+#define LONG_RANGE_LEVELS 3         // Block sizes of long-range constraints: 2x2x2, 4x4x4, 8x8x8 voxels (see LongRangeConstraints::blockSize)
+#define LONG_RANGE_SLOTS_PER_FACE 6 // Long-range constraints a face constraint can be internal to: 4 at the finest level, then 1 per coarser level
+#define FRACTURE_EVENT_CAPACITY 65536 // Fracture events the GPU can record per frame (see FractureEventLog). Any beyond that are counted, but dropped.
+
+// Where each object's items start in the batched passes' concatenated buffers (see BatchedConstraintsCompute), one kind after another.
+#define BATCH_OFFSET_PARTICLES 0                                             // Into the global particle buffer
+#define BATCH_OFFSET_FACE_CONSTRAINTS 1                                      // Per axis
+#define BATCH_OFFSET_LONG_RANGE_THREADS (BATCH_OFFSET_FACE_CONSTRAINTS + 3)  // Per level, in the thread space of that level's dispatch
+#define BATCH_OFFSET_LONG_RANGE_CONSTRAINTS (BATCH_OFFSET_LONG_RANGE_THREADS + LONG_RANGE_LEVELS) // Per level, into the long-range buffer
+#define BATCH_OFFSET_KINDS (BATCH_OFFSET_LONG_RANGE_CONSTRAINTS + LONG_RANGE_LEVELS)
+
+// Range the quantized trilinear coordinates of a VertexBinding cover, in units of the voxel's edge length. A little wider than [0, 1],
+// so vertices that sit just outside their voxel (e.g. from floating point error at the voxel's faces) don't get clamped.
+#define VERTEX_BINDING_COORD_MIN -0.25f
+#define VERTEX_BINDING_COORD_RANGE 1.5f
 
 struct VGSConstants
 {
@@ -23,7 +38,7 @@ struct VGSConstants
     uint iterCount;
     uint numVoxels;
     float compliance;
-    int padding0;
+    float chebyshevRho; // Estimated spectral radius of the VGS iteration, for Chebyshev acceleration (see doVGSIterations). 0 disables.
 };
 
 struct PreVGSConstants
@@ -38,6 +53,35 @@ struct PreVGSConstants
     int padding2;
 };
 
+// Appended by the face constraint pass every time a constraint breaks (when recording, see GlobalSolver::aRecordFractureEvents).
+struct FractureEvent
+{
+    uint constraintIdx; // Into the face constraints of the given axis
+    uint axis;
+    uint voxelA;        // Global voxel indices (i.e. into the global particle buffer / 8)
+    uint voxelB;
+    float strain;       // Of the edge that broke the constraint, relative to the particle diameter (negative = compression)
+    uint substep;       // Within the frame
+};
+
+// Per-object parameters for the batched passes, which simulate every object in one dispatch per pass (see BatchedConstraintsCompute)
+struct BatchedObjectParams
+{
+    VGSConstants vgsConstants;
+    float gravityStrength;
+    float timeStep;
+};
+
+// Where a vertex sits in its voxel's rest frame, computed once when the deformer is set up (see VertexDeform::bindVertex).
+// The trilinear coordinates are 16-bit unorm over VERTEX_BINDING_COORD_MIN + [0, VERTEX_BINDING_COORD_RANGE].
+struct VertexBinding
+{
+    uint voxelId;    // UINT_MAX if the vertex doesn't belong to any voxel
+    uint uv;         // [lower 16 bits: u, upper 16 bits: v]
+    uint w;          // Lower 16 bits (upper 16 bits unused, to keep the struct 16 bytes)
+    uint restNormal; // Octahedral encoding of the rest normal, in the grid's frame: [lower 16 bits: x, upper 16 bits: y], as snorm
+};
+
 struct Particle
 {
 #ifdef __cplusplus
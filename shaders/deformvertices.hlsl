@@ -1,11 +1,8 @@
 #include "common.hlsl"
 #include "constants.hlsli"
 
-StructuredBuffer<float3> originalVertPositions : register(t0);
-StructuredBuffer<float3> originalVertNormals : register(t1);
-StructuredBuffer<Particle> originalParticles : register(t2);
-StructuredBuffer<Particle> particles : register(t3);
-StructuredBuffer<uint> vertexVoxelIds : register(t4);
+StructuredBuffer<Particle> particles : register(t0);
+StructuredBuffer<VertexBinding> vertexBindings : register(t1);
 
 // The bind flags Maya uses prevents us from using structured buffers and requires an R32_FLOAT format for UAVs.
 RWBuffer<float > outVertPositions : register(u0);
@@ -13,14 +10,27 @@ RWBuffer<float> outVertNormals : register(u1);
 
 cbuffer DeformConstants : register(b0)
 {
-    // The rest frame of each voxel may be rotated if the voxel grid is rotated. We need to account for that in the deformation.
-    float4x4 gridRotationInverse;
     uint vertexCount;
     uint padding0;
     uint padding1;
     uint padding2;
 };
 
+float decodeBindingCoord(uint quantized)
+{
+    return VERTEX_BINDING_COORD_MIN + (float)(quantized & 0xFFFFu) * (VERTEX_BINDING_COORD_RANGE / 65535.0f);
+}
+
+float3 decodeOctahedral(uint packed)
+{
+    // Sign-extend each 16-bit half
+    float2 e = float2((int)(packed << 16) >> 16, (int)packed >> 16) / 32767.0f;
+    float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += (n.xy >= 0.0f) ? -t : t;
+    return normalize(n);
+}
+
 float3x3 inverseFromRows(float3 r0, float3 r1, float3 r2)
 {
     float3 c0 = cross(r1, r2);
@@ -38,7 +48,7 @@ float3x3 inverseFromRows(float3 r0, float3 r1, float3 r2)
 /**
  * Each thread represents a vertex. Based on the voxel the vertex belongs to, we deform the vertex
  * according to the positions of the particles in that voxel, compared to their original positions.
- * Similarly, we deform the normals.
+ * Similarly, we deform the normals. cpu/vertexdeform.h does the same on the host (for export); keep the two in sync.
  * 
  * A couple notes:
  * 1. Vertices and normals may be duplicated in the input buffers if a vertex is shared between triangles
@@ -52,8 +62,8 @@ void main(uint3 gId : SV_DispatchThreadID)
 {
     if (gId.x >= vertexCount) return;
 
-    uint voxelId = vertexVoxelIds[gId.x];
-    uint particleStartIdx = voxelId << 3;
+    VertexBinding binding = vertexBindings[gId.x];
+    uint particleStartIdx = binding.voxelId << 3;
 
     float3 v0 = particles[particleStartIdx + 0].position;
     float3 v1 = particles[particleStartIdx + 1].position;
@@ -64,14 +74,10 @@ void main(uint3 gId : SV_DispatchThreadID)
     float3 v6 = particles[particleStartIdx + 6].position;
     float3 v7 = particles[particleStartIdx + 7].position;
 
-    // Note: originalParticles contains only one reference particle per voxel, thus the index into it
-    // does not need to be multiplied by 8 to account for the 8 particles per voxel.
-    Particle p0_orig = originalParticles[voxelId];
-    float r = particleRadius(p0_orig);
-    float3x3 gridRotInv3x3 = (float3x3)gridRotationInverse;
-    float3 restLocal = mul(gridRotInv3x3, originalVertPositions[gId.x] - (p0_orig.position - float3(r, r, r)));
-    float3 uvw = restLocal / (4.0f * r);
-    float u = uvw.x; float v = uvw.y; float w = uvw.z;
+    // Trilinear coordinates within the voxel's rest frame, precomputed on the CPU (they never change).
+    float u = decodeBindingCoord(binding.uv);
+    float v = decodeBindingCoord(binding.uv >> 16);
+    float w = decodeBindingCoord(binding.w);
 
     float3 deformedPos =
         v0 * (1 - u) * (1 - v) * (1 - w) +
@@ -109,8 +115,8 @@ void main(uint3 gId : SV_DispatchThreadID)
 
     float3x3 deformMatrix = transpose(inverseFromRows(dP_du, dP_dv, dP_dw));
 
-    float3 normal = originalVertNormals[gId.x];
-    normal = mul(gridRotInv3x3, normal);
+    // The rest normal is already in the grid's frame (see VertexDeform::bindVertex)
+    float3 normal = decodeOctahedral(binding.restNormal);
     normal = normalize(mul(deformMatrix, normal));
 
     outVertNormals[outOffset + 0] = normal.x;
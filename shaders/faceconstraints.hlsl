@@ -3,29 +3,60 @@
 
 RWStructuredBuffer<uint> longRangeConstraintCounters : register(u4);
 RWStructuredBuffer<uint> longRangeConstraintIndices : register(u5);
+RWStructuredBuffer<FractureEvent> fractureEvents : register(u6);  // Shared by all objects (see FractureEventLog)
+RWStructuredBuffer<uint> fractureEventCount : register(u7);
+
+void recordFractureEvent(uint constraintIdx, uint voxelAIdx, uint voxelBIdx, float strain) {
+    // The count keeps going past the capacity, so the host can tell how many events were dropped.
+    uint eventIdx;
+    InterlockedAdd(fractureEventCount[0], 1, eventIdx);
+    if (eventIdx >= FRACTURE_EVENT_CAPACITY) return;
+
+    FractureEvent fractureEvent;
+    fractureEvent.constraintIdx = constraintIdx;
+    fractureEvent.axis = faceAId >> 1; // Face IDs are 2 per axis (see cube.h)
+    fractureEvent.voxelA = voxelAIdx + voxelOffset;
+    fractureEvent.voxelB = voxelBIdx + voxelOffset;
+    fractureEvent.strain = strain;
+    fractureEvent.substep = substep;
+    fractureEvents[eventIdx] = fractureEvent;
+}
+
+void breakConstraint(int constraintIdx, int voxelAIdx, int voxelBIdx, float strain) {
+    if (recordFractureEvents) {
+        recordFractureEvent(constraintIdx, voxelAIdx, voxelBIdx, strain);
+    }
 
-void breakConstraint(int constraintIdx, int voxelAIdx, int voxelBIdx) {
     isSurfaceVoxel[voxelAIdx] = 1;
     isSurfaceVoxel[voxelBIdx] = 1;
 
     faceConstraintsIndices[constraintIdx * 2] = -1;
     faceConstraintsIndices[constraintIdx * 2 + 1] = -1;
 
-    // Each face constraint belongs to up to 4 long-range constraints.
-    for (int i = 0; i < 4; ++i) {
-        uint longRangeConstraintIdx = longRangeConstraintIndices[constraintIdx * 4 + i];
+    // Each face constraint belongs to up to 4 long-range constraints at the finest level, and one per coarser level.
+    for (int i = 0; i < LONG_RANGE_SLOTS_PER_FACE; ++i) {
+        uint longRangeConstraintIdx = longRangeConstraintIndices[constraintIdx * LONG_RANGE_SLOTS_PER_FACE + i];
         if (longRangeConstraintIdx == 0xFFFFFFFF) continue;
 
         // The counters buffer doubles as the LR particles indices buffer. We hijack the lower 4 bits of the first particle index
         // to act as a counter of how many face constraints associated with this long-range constraint have been broken.
-        uint original;
-        InterlockedAdd(longRangeConstraintCounters[longRangeConstraintIdx << 3], 1, original);
+        // Coarser blocks have far more than 15 internal faces, so the counter saturates instead of carrying into the particle index.
+        uint counterIdx = longRangeConstraintIdx << 3;
+        uint expected = longRangeConstraintCounters[counterIdx];
+        [allow_uav_condition] while ((expected & 0xF) < 0xF) {
+            uint original;
+            InterlockedCompareExchange(longRangeConstraintCounters[counterIdx], expected, expected + 1, original);
+            if (original == expected) break;
+            expected = original;
+        }
     }
 }
 
 /**
 * Solves face constraints for a pair of voxels using the VGS method.
 * One thread = one face constraint. 
+* Constraints along one axis never share particles (see PBD::constructFaceToFaceConstraints), so threads can't race on particle data;
+* the only shared writes are to surface flags (idempotent) and long-range counters (atomic), so results don't depend on thread order.
 */
 [numthreads(VGS_THREADS, 1, 1)]
 void main(
@@ -60,7 +91,7 @@ void main(
         float edgeLength = length(voxelParticles[faceAParticles[i]].position - voxelParticles[faceBParticles[i]].position);
         float strain = (edgeLength - 2.0f * vgsConstants.particleRadius) / (2.0f * vgsConstants.particleRadius);
         if (strain > tensionLimit || strain < compressionLimit) {
-            breakConstraint(constraintIdx, voxelAIdx, voxelBIdx);
+            breakConstraint(constraintIdx, voxelAIdx, voxelBIdx, strain);
             return;
         }
     }
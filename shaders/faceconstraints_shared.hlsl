@@ -8,13 +8,13 @@ cbuffer FaceConstraintsCB : register(b1)
     uint4 faceAParticles; // Which particles of voxel A are involved in the face constraint
     uint4 faceBParticles; // Which particles of voxel B are involved in the face constraint
     uint numConstraints;
-    int faceAId;          // Which face index this constraint corresponds to on voxel A (only used for paint value lookup)
+    int faceAId;          // Which face index this constraint corresponds to on voxel A (for paint value lookup, and the axis of fracture events)
     int faceBId;          // Which face index this constraint corresponds to on voxel B (only used for paint value lookup)
     float constraintLow;
     float constraintHigh;
-    int padding0;
-    int padding1;
-    int padding2;
+    uint substep;         // Current substep within the frame (only used to stamp fracture events)
+    uint voxelOffset;     // This object's first voxel in the global buffers (likewise)
+    uint recordFractureEvents;
 };
 
 RWStructuredBuffer<Particle> particles : register(u0);
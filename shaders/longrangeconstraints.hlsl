@@ -5,8 +5,8 @@ RWStructuredBuffer<Particle> particles : register(u0);
 
 cbuffer LongRangeConstraintsCB : register(b0)
 {
-    uint numConstraints;
-    uint padding0;
+    uint numConstraints;   // In this level (one dispatch per level)
+    uint firstConstraint;
     uint padding1;
     uint padding2;
 };
@@ -20,16 +20,17 @@ bool longRangeConstraintBroken(uint particleIdx0) {
     // The lower 4 bits (0xF) of the first particle are a counter of how many face constraints associated with this long-range constraint have been broken.
     // Three is a bit of a heuristic: it's the minimum number of face constraints internal to a 2x2x2 voxel grouping
     // that may disconnect the group into multiple parts. If that many (or more) are broken, we must break the long-range constraint.
+    // Coarser blocks use the same rule: it errs on the side of breaking them early, which leaves their finer constraints in charge.
     return (particleIdx0 & 0xF) >= 3u;
 }
 
 [numthreads(VGS_THREADS, 1, 1)]
 void main(uint3 globalThreadId : SV_DispatchThreadID)
 {
-    uint constraintIdx = globalThreadId.x;
-    if (constraintIdx >= numConstraints) {
+    if (globalThreadId.x >= numConstraints) {
         return;
     }
+    uint constraintIdx = firstConstraint + globalThreadId.x;
 
     uint particleIdx0 = longRangeParticleIndices[constraintIdx << 3];
     if (longRangeConstraintBroken(particleIdx0)) return;
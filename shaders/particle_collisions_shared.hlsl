@@ -6,7 +6,19 @@ cbuffer ParticleCollisionsConstantBuffer : register(b0)
     float friction;
 };
 
+// Spreads the low 10 bits of v out to every third bit.
+uint spreadBits(uint v) {
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// Cells are numbered by the Morton code of their grid position (wrapping every 1024 cells per axis), folded into the table.
+// Unlike a scrambling hash, this puts spatially adjacent cells in adjacent slots, so neighbouring threads solve neighbouring cells -
+// which share most of their particles (each particle is binned into up to 8 cells), and so hit the same cache lines.
 int getParticleCellHash(int gridPosX, int gridPosY, int gridPosZ) {
-    int hash = (gridPosX * 92837111) ^ (gridPosY * 689287499) ^ (gridPosZ * 283923481);
-    return abs(hash) % hashGridSize;
+    uint mortonCode = spreadBits(uint(gridPosX) & 1023) | (spreadBits(uint(gridPosY) & 1023) << 1) | (spreadBits(uint(gridPosZ) & 1023) << 2);
+    return int(mortonCode % hashGridSize);
 }
\ No newline at end of file
@@ -6,6 +6,7 @@ StructuredBuffer<uint> particleIndices : register(t0);
 StructuredBuffer<uint> collisionCellParticleCounts : register(t1);
 StructuredBuffer<Particle> frameStartParticles : register(t2);
 RWStructuredBuffer<Particle> particles : register(u0);
+RWStructuredBuffer<uint> collisionOverflowCounts : register(u1); // [0]: cells that didn't fit in shared memory, [1]: their particles (see SolveCollisionsCompute)
 
 static const float jitterEpsilon = 1e-3f;
 static const float relaxationFactor = 0.35f;
@@ -65,9 +66,100 @@ void applyFriction(Particle preCollisionA, Particle preCollisionB, Particle fram
     postCollisionB.position += (invMassB * invMassSumReciprocal) * relTangentClamped;
 }
 
+/**
+ * Resolves the collision (if any) between two particles of a cell, updating them in place. Returns true if they collided.
+ * particleA and particleB are the cell's working copies; globalParticleIdxA and globalParticleIdxB are where they live in the particle buffer.
+ */
+bool resolveParticlePair(inout Particle particleA, inout Particle particleB, uint globalParticleIdxA, uint globalParticleIdxB)
+{
+    uint globalVoxelIdxA = globalParticleIdxA >> 3;
+    uint globalVoxelIdxB = globalParticleIdxB >> 3;
+    if (globalVoxelIdxA == globalVoxelIdxB) return false; // Skip particle pairs from the same voxel.
+
+    float distanceSquared;
+    float3 particleAToB;
+    float2 particleRadiusAndInvMassA = unpackHalf2x16(particleA.radiusAndInvMass);
+    float2 particleRadiusAndInvMassB = unpackHalf2x16(particleB.radiusAndInvMass);
+    float invMassSum = particleRadiusAndInvMassA.y + particleRadiusAndInvMassB.y;
+    if (invMassSum <= 0.0f) return false; // Both particles are immovable.
+
+    if (!doParticlesOverlap(particleA.position, particleB.position, particleRadiusAndInvMassA.x, particleRadiusAndInvMassB.x, distanceSquared, particleAToB)) return false;
+    particleAToB = normalize(particleAToB);
+    float delta = (particleRadiusAndInvMassA.x + particleRadiusAndInvMassB.x) - sqrt(distanceSquared);
+    
+    float jitterThreshold = jitterEpsilon * min(particleRadiusAndInvMassA.x, particleRadiusAndInvMassB.x);            
+    if (delta <= jitterThreshold) return false;
+    delta -= jitterThreshold; 
+
+    // Get the particles diagonal to A and B within their respective voxels.
+    // Then approximate the voxel centers to augment collision normals, to avoid voxel interlock.
+    float3 voxelACenter = getVoxelCenterOfParticle(particleA, globalParticleIdxA, globalVoxelIdxA);
+    float3 voxelBCenter = getVoxelCenterOfParticle(particleB, globalParticleIdxB, globalVoxelIdxB);
+
+    // Test for voxel-center collision, treating each center as an imaginary "particle" with radius 1.5x that of the voxel's real particles. 
+    float3 augmentedNormal = particleAToB;
+    float3 voxelAToB;
+    if (doParticlesOverlap(voxelACenter, voxelBCenter, 1.5f * particleRadiusAndInvMassA.x, 1.5f * particleRadiusAndInvMassB.x, distanceSquared, voxelAToB)) {
+        augmentedNormal = normalize(normalize(voxelAToB) + particleAToB);
+    }
+    
+    float invMassSumReciprocal = 1 / (invMassSum);
+
+    Particle preCollisionA = particleA;
+    Particle preCollisionB = particleB;
+    particleA.position -= delta * relaxationFactor * (invMassSumReciprocal * particleRadiusAndInvMassA.y) * augmentedNormal;
+    particleB.position += delta * relaxationFactor * (invMassSumReciprocal * particleRadiusAndInvMassB.y) * augmentedNormal;
+
+    // We do have to do some extra per-collision-pair global reads to apply friction. There's not enough shared memory to store frame start positions.
+    // But since these reads only happen on actual collisions (not on all candidates), it's manageable.
+    applyFriction(
+        preCollisionA, 
+        preCollisionB,
+        frameStartParticles[globalParticleIdxA],
+        frameStartParticles[globalParticleIdxB],
+        particleA,
+        particleB,
+        augmentedNormal,
+        delta
+    );
+
+    return true;
+}
+
+/**
+ * Slow path for a cell whose particles don't all fit in the group's shared memory (a dense pile): the same pairwise solve, but reading and writing
+ * the particles in global memory. Each particle of the outer loop is held in a register across the inner loop, so only the inner loop's particles
+ * go through global memory. Counted in collisionOverflowCounts, so it's visible when this path is being hit.
+ */
+void solveCellFromGlobalMemory(uint particleStartIdx, uint numParticlesInCell)
+{
+    InterlockedAdd(collisionOverflowCounts[0], 1);
+    InterlockedAdd(collisionOverflowCounts[1], numParticlesInCell);
+
+    for (uint i = 0; i < numParticlesInCell; ++i) {
+        uint globalParticleIdx_i = particleIndices[particleStartIdx + i];
+        Particle particleA = particles[globalParticleIdx_i];
+        bool positionChanged_i = false;
+
+        for (uint j = i + 1; j < numParticlesInCell; ++j) {
+            uint globalParticleIdx_j = particleIndices[particleStartIdx + j];
+            Particle particleB = particles[globalParticleIdx_j];
+            if (!resolveParticlePair(particleA, particleB, globalParticleIdx_i, globalParticleIdx_j)) continue;
+
+            particles[globalParticleIdx_j] = particleB;
+            positionChanged_i = true;
+        }
+
+        if (positionChanged_i) {
+            particles[globalParticleIdx_i] = particleA;
+        }
+    }
+}
+
 /**
  * Resolve collisions between particles in the same collision cell. (Particles have been pre-binned into all cells they overlap)
  * Note: no shared memory barriers are needed because each thread writes to its own section of shared memory. (so "shared" is a bit of a misnomer here :D)
+ * Cells that don't fit in the group's shared memory fall back to solveCellFromGlobalMemory, rather than dropping their collisions.
 */
 [numthreads(SOLVE_COLLISION_THREADS, 1, 1)]
 void main(uint3 globalId : SV_DispatchThreadID, uint3 groupThreadId : SV_GroupThreadID) {
@@ -76,11 +168,15 @@ void main(uint3 globalId : SV_DispatchThreadID, uint3 groupThreadId : SV_GroupTh
     uint particleStartIdx = collisionCellParticleCounts[globalId.x];
     uint particleEndIdx = collisionCellParticleCounts[globalId.x + 1]; // No out of bounds concern because we added a guard (extra buffer entry) for this very purpose.
     uint sharedMemoryStartIdx = particleStartIdx - collisionCellParticleCounts[globalId.x - groupThreadId.x];
+    uint numParticlesInCell = particleEndIdx - particleStartIdx;
+
+    if (sharedMemoryStartIdx + numParticlesInCell > SHARED_MEMORY_SIZE) {
+        solveCellFromGlobalMemory(particleStartIdx, numParticlesInCell);
+        return;
+    }
 
     // Store particles in shared memory.
-    uint numParticlesInCell = particleEndIdx - particleStartIdx;
     for (uint u = 0; u < numParticlesInCell; ++u) {
-        if (sharedMemoryStartIdx + u >= SHARED_MEMORY_SIZE) break; // Ignore any particles that would overflow shared memory.
         uint globalParticleIdx = particleIndices[particleStartIdx + u];
         s_globalParticleIndices[sharedMemoryStartIdx + u] = globalParticleIdx;
         s_particles[sharedMemoryStartIdx + u] = particles[globalParticleIdx];
@@ -88,69 +184,16 @@ void main(uint3 globalId : SV_DispatchThreadID, uint3 groupThreadId : SV_GroupTh
     }
 
     for (uint i = 0; i < numParticlesInCell; ++i) {
-        if (sharedMemoryStartIdx + i >= SHARED_MEMORY_SIZE) break;
         for (uint j = i + 1; j < numParticlesInCell; ++j) {
-            if (sharedMemoryStartIdx + j >= SHARED_MEMORY_SIZE) break;
-
             uint sharedMemIdx_i = sharedMemoryStartIdx + i;
             uint sharedMemIdx_j = sharedMemoryStartIdx + j;
-            
-            uint globalParticleIdx_i = s_globalParticleIndices[sharedMemIdx_i];
-            uint globalParticleIdx_j = s_globalParticleIndices[sharedMemIdx_j];
-            
-            uint globalVoxelIdx_i = globalParticleIdx_i >> 3;
-            uint globalVoxelIdx_j = globalParticleIdx_j >> 3;
-            
-            if (globalVoxelIdx_i == globalVoxelIdx_j) continue; // Skip particle pairs from the same voxel.
 
             Particle particleA = s_particles[sharedMemIdx_i];
             Particle particleB = s_particles[sharedMemIdx_j];
+            if (!resolveParticlePair(particleA, particleB, s_globalParticleIndices[sharedMemIdx_i], s_globalParticleIndices[sharedMemIdx_j])) continue;
 
-            float distanceSquared;
-            float3 particleAToB;
-            float2 particleRadiusAndInvMassA = unpackHalf2x16(particleA.radiusAndInvMass);
-            float2 particleRadiusAndInvMassB = unpackHalf2x16(particleB.radiusAndInvMass);
-            float invMassSum = particleRadiusAndInvMassA.y + particleRadiusAndInvMassB.y;
-            if (invMassSum <= 0.0f) continue; // Both particles are immovable.
-
-            if (!doParticlesOverlap(particleA.position, particleB.position, particleRadiusAndInvMassA.x, particleRadiusAndInvMassB.x, distanceSquared, particleAToB)) continue;
-            particleAToB = normalize(particleAToB);
-            float delta = (particleRadiusAndInvMassA.x + particleRadiusAndInvMassB.x) - sqrt(distanceSquared);
-            
-            float jitterThreshold = jitterEpsilon * min(particleRadiusAndInvMassA.x, particleRadiusAndInvMassB.x);            
-            if (delta <= jitterThreshold) continue;
-            delta -= jitterThreshold; 
-
-            // Get the particles diagonal to A and B within their respective voxels.
-            // Then approximate the voxel centers to augment collision normals, to avoid voxel interlock.
-            float3 voxelACenter = getVoxelCenterOfParticle(particleA, globalParticleIdx_i, globalVoxelIdx_i);
-            float3 voxelBCenter = getVoxelCenterOfParticle(particleB, globalParticleIdx_j, globalVoxelIdx_j);
-
-            // Test for voxel-center collision, treating each center as an imaginary "particle" with radius 1.5x that of the voxel's real particles. 
-            float3 augmentedNormal = particleAToB;
-            float3 voxelAToB;
-            if (doParticlesOverlap(voxelACenter, voxelBCenter, 1.5f * particleRadiusAndInvMassA.x, 1.5f * particleRadiusAndInvMassB.x, distanceSquared, voxelAToB)) {
-                augmentedNormal = normalize(normalize(voxelAToB) + particleAToB);
-            }
-            
-            float invMassSumReciprocal = 1 / (invMassSum);
-
-            s_particles[sharedMemIdx_i].position -= delta * relaxationFactor * (invMassSumReciprocal * particleRadiusAndInvMassA.y) * augmentedNormal;
-            s_particles[sharedMemIdx_j].position += delta * relaxationFactor * (invMassSumReciprocal * particleRadiusAndInvMassB.y) * augmentedNormal;
-
-            // We do have to do some extra per-collision-pair global reads to apply friction. There's not enough shared memory to store frame start positions.
-            // But since these reads only happen on actual collisions (not on all candidates), it's manageable.
-            applyFriction(
-                particleA, 
-                particleB,
-                frameStartParticles[globalParticleIdx_i],
-                frameStartParticles[globalParticleIdx_j],
-                s_particles[sharedMemIdx_i],
-                s_particles[sharedMemIdx_j],
-                augmentedNormal,
-                delta
-            );
-
+            s_particles[sharedMemIdx_i] = particleA;
+            s_particles[sharedMemIdx_j] = particleB;
             s_positionChanged[sharedMemIdx_i] = true;
             s_positionChanged[sharedMemIdx_j] = true;
         }
@@ -158,7 +201,6 @@ void main(uint3 globalId : SV_DispatchThreadID, uint3 groupThreadId : SV_GroupTh
 
     // Write the particles back to global memory.
     for (uint v = 0; v < numParticlesInCell; ++v) {
-        if (sharedMemoryStartIdx + v >= SHARED_MEMORY_SIZE) break; // Ignore any particles that would overflow shared memory.
         if (!s_positionChanged[sharedMemoryStartIdx + v]) continue;
 
         uint globalParticleIdx = s_globalParticleIndices[sharedMemoryStartIdx + v];
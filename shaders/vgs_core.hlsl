@@ -40,6 +40,13 @@ float calcMassNormalization(
     return 1.0f / (maxInvMass + compliance);
 }
 
+// Chebyshev semi-iterative weights (Wang 2015): 1 for the first iteration, then increasing towards 2 / (1 + sqrt(1 - rho^2)).
+float chebyshevOmega(uint iter, float rhoSq, float previousOmega) {
+    if (iter == 0) return 1.0f;
+    if (iter == 1) return 2.0f / (2.0f - rhoSq);
+    return 4.0f / (4.0f - rhoSq * previousOmega);
+}
+
 void doVGSIterations(
     inout Particle particles[8],
     VGSConstants vgsConstants,
@@ -52,6 +59,15 @@ void doVGSIterations(
     uint iterCount = vgsConstants.iterCount;
     float massNormalization = calcMassNormalization(particles, vgsConstants.compliance);
 
+    // Chebyshev acceleration, if enabled: each iteration's result is extrapolated from the one before last. Drops back to plain projection
+    // for the rest of the solve as soon as a plain step comes out longer than the one before it (rho was overestimated, extrapolating would diverge).
+    bool accelerate = (vgsConstants.chebyshevRho > 0.0f);
+    float rhoSq = vgsConstants.chebyshevRho * vgsConstants.chebyshevRho;
+    float omega = 1.0f;
+    float lastStepSq = 3.402823466e+38f;
+    float3 previous[8];
+    float3 older[8];
+
     for (uint iter = 0; iter < iterCount; iter++)
     {
         // Calculate basis vectors (average of edges for each axis)
@@ -107,6 +123,12 @@ void doVGSIterations(
         float3 center = 0.125f * (particles[0].position + particles[1].position + particles[2].position + particles[3].position +
                                   particles[4].position + particles[5].position + particles[6].position + particles[7].position);
 
+        if (accelerate) {
+            [unroll] for (uint corner = 0; corner < 8; ++corner) {
+                previous[corner] = particles[corner].position;
+            }
+        }
+
         // Lerp between current positions and goal positions weighted by inverse mass (relative to max inverse mass)
         // NOTE: this seems to produce the right effect, but I fear it introduces compliance / increases time to converge, because a single iteration 
         // won't preserve a voxel's COM. It might be better to compute the COM shift after applying the position updates, and then apply a COM correction step.
@@ -118,5 +140,23 @@ void doVGSIterations(
         particles[5].position = lerp(particles[5].position, center + u0 - u1 + u2, particleInverseMass(particles[5]) * massNormalization);
         particles[6].position = lerp(particles[6].position, center - u0 + u1 + u2, particleInverseMass(particles[6]) * massNormalization);
         particles[7].position = lerp(particles[7].position, center + u0 + u1 + u2, particleInverseMass(particles[7]) * massNormalization);
+
+        if (accelerate) {
+            omega = chebyshevOmega(iter, rhoSq, omega);
+
+            float stepSq = 0.0f;
+            [unroll] for (uint j = 0; j < 8; ++j) {
+                float3 delta = particles[j].position - previous[j];
+                stepSq = max(stepSq, dot(delta, delta));
+            }
+            if (stepSq > lastStepSq) accelerate = false;
+            lastStepSq = stepSq;
+
+            bool extrapolate = accelerate && omega != 1.0f;
+            [unroll] for (uint k = 0; k < 8; ++k) {
+                if (extrapolate) particles[k].position = older[k] + omega * (particles[k].position - older[k]);
+                older[k] = previous[k];
+            }
+        }
     }
 }
\ No newline at end of file
@@ -188,6 +188,36 @@ uint16_t floatToHalf(float value) {
     }
 }
 
+float halfToFloat(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x03FF;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign; // Zero
+        } else {
+            // Subnormal: renormalize the mantissa
+            exponent = 113;
+            while ((mantissa & 0x0400) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x03FF) << 13);
+        }
+    } else if (exponent == 31) {
+        // Inf or NaN
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
 uint32_t packTwoFloatsInUint32(float a, float b) {
     uint32_t ha = static_cast<uint32_t>(floatToHalf(a));
     uint32_t hb = static_cast<uint32_t>(floatToHalf(b));
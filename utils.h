@@ -29,8 +29,21 @@ inline int ilogbaseceil(int x, int base) {
     return static_cast<int>(std::ceil(std::log(x) / std::log(base)));
 }
 
+// 64-bit FNV-1a. Pass the previous result as the seed to hash several ranges together.
+inline uint64_t hashBytes(const void* data, size_t numBytes, uint64_t seed = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < numBytes; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
 uint16_t floatToHalf(float value);
 
+float halfToFloat(uint16_t value);
+
 uint32_t packTwoFloatsInUint32(float a, float b);
 
 MFloatVector sign(const MFloatVector& v);
@@ -3,9 +3,15 @@
 #include <maya/MFnTransform.h>
 #include <algorithm>
 #include <numeric>
+#include <cfloat>
+#include <chrono>
 #include "cgalhelper.h"
 #include <maya/MFloatVectorArray.h>
 #include <maya/MProgressWindow.h>
+#include <maya/MUuid.h>
+
+// Width (in voxels) of the band around the surface in which voxel distances are refined against the actual mesh triangles.
+constexpr static int DISTANCE_FIELD_NARROW_BAND = 2;
 
 Voxels Voxelizer::voxelizeSelectedMesh(
     const VoxelizationGrid& grid,
@@ -14,6 +20,10 @@ Voxels Voxelizer::voxelizeSelectedMesh(
     bool voxelizeInterior,
     bool doBoolean,
     bool clipTriangles,
+    bool computeDistances,
+    bool refineDistanceField,
+    bool useWindingNumber,
+    bool thinSurface,
     MStatus& status
 ) {
     MFnMesh selectedMesh(selectedMeshPath);
@@ -39,7 +49,24 @@ Voxels Voxelizer::voxelizeSelectedMesh(
     MProgressWindow::setProgressStatus("Processing mesh triangles...");
     std::vector<Triangle> meshTris = getTrianglesOfMesh(selectedMesh, voxels.voxelSize);
 
-    if (voxelizeInterior) {
+    // The winding number replaces the parity fill and CGAL side tests when the input mesh may have holes or self-intersections.
+    FastWindingNumber windingNumber;
+    if (useWindingNumber) {
+        MProgressWindow::setProgressStatus("Building winding number tree...");
+        MPointArray meshVertices;
+        selectedMesh.getPoints(meshVertices, MSpace::kWorld);
+        windingNumber = FastWindingNumber(meshVertices, meshTris);
+    }
+
+    if (voxelizeInterior && useWindingNumber) {
+        MProgressWindow::setProgressStatus("Performing interior voxelization (winding number)...");
+        getInteriorVoxelsWindingNumber(
+            windingNumber,
+            grid,
+            voxels
+        );
+    }
+    else if (voxelizeInterior) {
         MProgressWindow::setProgressStatus("Performing interior voxelization...");
         getInteriorVoxels(
             meshTris,
@@ -51,11 +78,17 @@ Voxels Voxelizer::voxelizeSelectedMesh(
 
     if (voxelizeSurface) {
         MProgressWindow::setProgressStatus("Performing surface voxelization...");
+        // Clipping cuts each triangle to the voxels it was assigned to, so any piece in a voxel the thin test drops would be lost
+        // (leaving holes in the render mesh). Fall back to the conservative voxelization in that case.
+        if (thinSurface && clipTriangles) {
+            MGlobal::displayWarning("Thin surface voxelization is not supported with clipped triangles; using the conservative surface instead.");
+        }
         getSurfaceVoxels(
             meshTris,
             grid,
             voxels,
-            selectedMesh
+            selectedMesh,
+            thinSurface && !clipTriangles
         );
     }
 
@@ -65,6 +98,21 @@ Voxels Voxelizer::voxelizeSelectedMesh(
         grid
     );
 
+    // Nothing downstream reads distanceToSurface yet, so the distance field is opt-in (left at zero otherwise).
+    if (computeDistances) {
+        MProgressWindow::setProgressStatus("Computing voxel distance to surface...");
+        auto distanceFieldBegin = std::chrono::steady_clock::now();
+        computeDistanceField(
+            meshTris,
+            grid,
+            voxels,
+            selectedMesh,
+            refineDistanceField
+        );
+        double distanceFieldSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - distanceFieldBegin).count();
+        MGlobal::displayInfo(MString("Distance field: ") + distanceFieldSeconds + "s over " + voxels.size() + " grid cells" + (refineDistanceField ? " (refined)" : ""));
+    }
+
     MProgressWindow::setProgressStatus("Sorting voxels by Morton code...");
     Voxels sortedVoxels = sortVoxelsByMortonCode(voxels); // note: assign to new var to take advantage of RVO
 
@@ -76,7 +124,9 @@ Voxels Voxelizer::voxelizeSelectedMesh(
         newMeshName,
         gridTransform.asMatrix(),
         doBoolean,
-        clipTriangles
+        clipTriangles,
+        useWindingNumber ? &windingNumber : nullptr,
+        grid
     );
 
     if (status != MStatus::kSuccess) {
@@ -141,6 +191,10 @@ Triangle Voxelizer::processMayaTriangle(const MFnMesh& meshFn, const std::array<
     MVector deltaP(voxelSize, voxelSize, voxelSize);
     triangle.d1 = triangle.normal * (criticalPoint - vertices[0]);
     triangle.d2 = triangle.normal * (deltaP - criticalPoint - vertices[0]);
+    triangle.planeD = -(triangle.normal * MVector(vertices[0]));
+
+    MVector absNormal(std::abs(triangle.normal.x), std::abs(triangle.normal.y), std::abs(triangle.normal.z));
+    triangle.dominantAxis = (absNormal.x >= absNormal.y && absNormal.x >= absNormal.z) ? 0 : (absNormal.y >= absNormal.z ? 1 : 2);
 
     // Compute edge normals and distances for the XY, XZ, and YZ planes
     for (int i = 0; i < 3; ++i) {
@@ -171,6 +225,14 @@ Triangle Voxelizer::processMayaTriangle(const MFnMesh& meshFn, const std::array<
         triangle.d_ei_yz[i] = triangle.d_ei_yz_solid[i]
             + std::max(0.0, voxelSize * triangle.n_ei_yz[i].y)
             + std::max(0.0, voxelSize * triangle.n_ei_yz[i].z);
+
+        // Dominant plane, thin test. The diamond's extent along the edge normal is (voxelSize / 2) * max(|n.u|, |n.v|).
+        // (The normal's component along the dominant axis is 0, so the max over all three components is the same thing.)
+        const MVector& n_ei = (triangle.dominantAxis == 0) ? triangle.n_ei_yz[i] : (triangle.dominantAxis == 1) ? triangle.n_ei_xz[i] : triangle.n_ei_xy[i];
+        MVector vi_dominant(vertices[i]);
+        vi_dominant[triangle.dominantAxis] = 0.0;
+        triangle.d_ei_thin[i] = -n_ei * vi_dominant
+            + (voxelSize / 2.0) * std::max({ std::abs(n_ei.x), std::abs(n_ei.y), std::abs(n_ei.z) });
     }
 
     return triangle;
@@ -180,7 +242,8 @@ void Voxelizer::getSurfaceVoxels(
     const std::vector<Triangle>& triangles,
     const VoxelizationGrid& grid,
     Voxels& voxels,
-    const MFnMesh& selectedMesh
+    const MFnMesh& selectedMesh,
+    bool thinSurface
 ) {
     MProgressWindow::setProgressRange(0, static_cast<int>(triangles.size()));
     MProgressWindow::setProgress(0);
@@ -189,6 +252,9 @@ void Voxelizer::getSurfaceVoxels(
     const std::array<int, 3>& voxelsPerEdge = grid.voxelsPerEdge;
     MPoint gridMin = -(voxelSize / 2) * MVector(voxelsPerEdge[0], voxelsPerEdge[1], voxelsPerEdge[2]);
 
+    // In thin mode, also track which voxels the conservative test would have picked, so we can report the savings.
+    std::vector<uint8_t> isConservativeSurface(thinSurface ? voxels.size() : 0, 0);
+
     int triIdx = 0;
     for (const Triangle& tri : triangles) {
         MPoint voxelMin = MPoint(
@@ -210,11 +276,18 @@ void Voxelizer::getSurfaceVoxels(
 
                     MVector voxelMinCorner(MVector(x, y, z) * voxelSize + gridMin);
                     if (!doesTriangleOverlapVoxel(tri, voxelMinCorner)) continue;
+
+                    bool centroidInVoxel = isTriangleCentroidInVoxel(tri, voxelMinCorner, voxelSize, selectedMesh);
+                    if (thinSurface) {
+                        isConservativeSurface[index] = 1;
+                        // The voxel containing the centroid is always kept so that every (unclipped) triangle has a home voxel.
+                        if (!centroidInVoxel && !doesTriangleOverlapVoxelThin(tri, voxelMinCorner, voxelSize)) continue;
+                    }
                     
                     voxels.occupied[index] = true;
                     voxels.isSurface[index] = true;
                     
-                    isTriangleCentroidInVoxel(tri, voxelMinCorner, voxelSize, selectedMesh) ? 
+                    centroidInVoxel ? 
                         voxels.containedTris[index].push_back(triIdx) :
                         voxels.overlappingTris[index].push_back(triIdx);
                 }
@@ -224,6 +297,14 @@ void Voxelizer::getSurfaceVoxels(
         ++triIdx;
         if (triIdx % 100 == 0) MProgressWindow::advanceProgress(100);
     }
+
+    int numSurfaceVoxels = static_cast<int>(std::count(voxels.isSurface.begin(), voxels.isSurface.end(), 1u));
+    if (thinSurface) {
+        int numConservativeSurfaceVoxels = static_cast<int>(std::count(isConservativeSurface.begin(), isConservativeSurface.end(), 1));
+        MGlobal::displayInfo(MString("Surface voxels: ") + numSurfaceVoxels + " (thin, 6-separating) vs. " + numConservativeSurfaceVoxels + " (conservative)");
+    } else {
+        MGlobal::displayInfo(MString("Surface voxels: ") + numSurfaceVoxels + " (conservative)");
+    }
 }
 
 bool Voxelizer::doesTriangleOverlapVoxel(
@@ -244,6 +325,29 @@ bool Voxelizer::doesTriangleOverlapVoxel(
     return true;
 }
 
+bool Voxelizer::doesTriangleOverlapVoxelThin(
+    const Triangle& triangle,
+    const MVector& voxelMin,
+    double voxelSize
+) {
+    double halfVoxelSize = voxelSize / 2.0;
+    MVector voxelCenter = voxelMin + MVector(halfVoxelSize, halfVoxelSize, halfVoxelSize);
+    int axis = triangle.dominantAxis;
+
+    // Test 1: Triangle's plane crosses the voxel's center line along the dominant axis
+    if (std::abs(triangle.normal * voxelCenter + triangle.planeD) > halfVoxelSize * std::abs(triangle.normal[axis])) return false;
+
+    // Test 2: The triangle's projection onto the dominant plane overlaps the voxel center's 2D diamond
+    const MVector* n_ei = (axis == 0) ? triangle.n_ei_yz : (axis == 1) ? triangle.n_ei_xz : triangle.n_ei_xy;
+    MVector voxelCenterProjected = voxelCenter;
+    voxelCenterProjected[axis] = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        if ((n_ei[i] * voxelCenterProjected) + triangle.d_ei_thin[i] < 0) return false;
+    }
+
+    return true;
+}
+
 bool Voxelizer::isTriangleCentroidInVoxel(
     const Triangle& triangle,
     const MVector& voxelMin,
@@ -315,6 +419,74 @@ void Voxelizer::getInteriorVoxels(
     }
 }
 
+void Voxelizer::getInteriorVoxelsWindingNumber(
+    const FastWindingNumber& windingNumber,
+    const VoxelizationGrid& grid,
+    Voxels& voxels
+) {
+    const std::array<int, 3>& voxelsPerEdge = grid.voxelsPerEdge;
+    std::vector<uint8_t> isInside(voxels.size(), 0);
+
+    WindingNumberTaskData taskData {
+        &windingNumber,
+        &grid,
+        &isInside
+    };
+
+    MProgressWindow::setProgressRange(0, voxelsPerEdge[0]);
+    MProgressWindow::setProgress(0);
+    MThreadPool::newParallelRegion(
+        Voxelizer::getWindingNumberClassification,
+        (void*)&taskData
+    );
+    MThreadPool::release(); // reduce reference count incurred by opening a new parallel region
+
+    for (int i = 0; i < voxels.size(); ++i) {
+        if (isInside[i]) voxels.occupied[i] = true;
+    }
+}
+
+void Voxelizer::getWindingNumberClassification(void* data, MThreadRootTask* rootTask) {
+    const WindingNumberTaskData* taskData = static_cast<WindingNumberTaskData*>(data);
+    int numSlabs = taskData->grid->voxelsPerEdge[0];
+
+    std::vector<WindingNumberThreadData> threadData(numSlabs);
+    for (int x = 0; x < numSlabs; ++x) {
+        threadData[x].taskData = taskData;
+        threadData[x].x = x;
+
+        MThreadPool::createTask(Voxelizer::getWindingNumberClassificationSlab, (void*)&threadData[x], rootTask);
+    }
+    MThreadPool::executeAndJoin(rootTask);
+    MProgressWindow::setProgress(numSlabs);
+}
+
+MThreadRetVal Voxelizer::getWindingNumberClassificationSlab(void* data) {
+    const WindingNumberThreadData* threadData = static_cast<WindingNumberThreadData*>(data);
+    const WindingNumberTaskData* taskData = threadData->taskData;
+    const FastWindingNumber& windingNumber = *taskData->windingNumber;
+    std::vector<uint8_t>& isInside = *taskData->isInside;
+    const double voxelSize = taskData->grid->voxelSize;
+    const std::array<int, 3>& voxelsPerEdge = taskData->grid->voxelsPerEdge;
+    MPoint gridMin = -(voxelSize / 2) * MVector(voxelsPerEdge[0], voxelsPerEdge[1], voxelsPerEdge[2]);
+
+    const int x = threadData->x;
+    for (int y = 0; y < voxelsPerEdge[1]; ++y) {
+        for (int z = 0; z < voxelsPerEdge[2]; ++z) {
+            int index = x * voxelsPerEdge[1] * voxelsPerEdge[2] + y * voxelsPerEdge[2] + z;
+            MPoint voxelCenter(
+                (x + 0.5) * voxelSize + gridMin.x,
+                (y + 0.5) * voxelSize + gridMin.y,
+                (z + 0.5) * voxelSize + gridMin.z
+            );
+
+            isInside[index] = windingNumber.isInside(voxelCenter) ? 1 : 0;
+        }
+    }
+
+    return (MThreadRetVal)0;
+}
+
 bool Voxelizer::doesTriangleOverlapVoxelCenter(
     const Triangle& triangle,
     const MVector& voxelCenterYZ  // YZ center of the voxel
@@ -393,6 +565,292 @@ void Voxelizer::createVoxels(
     }
 }
 
+void Voxelizer::computeDistanceField(
+    const std::vector<Triangle>& triangles,
+    const VoxelizationGrid& grid,
+    Voxels& voxels,
+    const MFnMesh& selectedMesh,
+    bool refineNarrowBand
+) {
+    const std::array<int, 3>& voxelsPerEdge = grid.voxelsPerEdge;
+    const int strideX = voxelsPerEdge[1] * voxelsPerEdge[2];
+    const int strideY = voxelsPerEdge[2];
+
+    // Seed the transform: the "surface" is every surface voxel, plus any occupied voxel on the boundary of the occupied region
+    // (so that interior-only voxelizations still get a meaningful field). Everything else starts infinitely far away.
+    std::vector<float> squaredDistances(voxels.size(), FLT_MAX);
+    for (int x = 0; x < voxelsPerEdge[0]; ++x) {
+        for (int y = 0; y < voxelsPerEdge[1]; ++y) {
+            for (int z = 0; z < voxelsPerEdge[2]; ++z) {
+                int index = x * strideX + y * strideY + z;
+                if (voxels.isSurface[index]) {
+                    squaredDistances[index] = 0.0f;
+                    continue;
+                }
+                if (!voxels.occupied[index]) continue;
+
+                bool onBoundary = 
+                    x == 0 || x == voxelsPerEdge[0] - 1 || !voxels.occupied[index - strideX] || !voxels.occupied[index + strideX] ||
+                    y == 0 || y == voxelsPerEdge[1] - 1 || !voxels.occupied[index - strideY] || !voxels.occupied[index + strideY] ||
+                    z == 0 || z == voxelsPerEdge[2] - 1 || !voxels.occupied[index - 1]       || !voxels.occupied[index + 1];
+                if (onBoundary) squaredDistances[index] = 0.0f;
+            }
+        }
+    }
+
+    // Separable passes (see Felzenszwalb & Huttenlocher, "Distance Transforms of Sampled Functions"):
+    // the squared EDT in 3D is three 1D lower-envelope-of-parabolas transforms, one per axis. Each grid line is independent.
+    MProgressWindow::setProgressRange(0, 3);
+    MProgressWindow::setProgress(0);
+    for (int axis = 2; axis >= 0; --axis) {
+        DistanceTransformTaskData taskData {
+            &squaredDistances,
+            voxelsPerEdge,
+            axis
+        };
+
+        MThreadPool::newParallelRegion(
+            Voxelizer::getDistanceTransformPass,
+            (void*)&taskData
+        );
+        MThreadPool::release(); // reduce reference count incurred by opening a new parallel region
+        MProgressWindow::advanceProgress(1);
+    }
+
+    for (int i = 0; i < voxels.size(); ++i) {
+        if (!voxels.occupied[i]) continue;
+        voxels.distanceToSurface[i] = static_cast<float>(std::sqrt(squaredDistances[i]) * grid.voxelSize);
+    }
+
+    // Refinement needs the triangles bucketed into surface voxels, which only exist if surface voxelization was run.
+    if (!refineNarrowBand || std::none_of(voxels.isSurface.begin(), voxels.isSurface.end(), [](uint s) { return s != 0; })) return;
+
+    MPointArray vertices;
+    selectedMesh.getPoints(vertices, MSpace::kWorld);
+
+    DistanceRefinementTaskData refinementTaskData {
+        &voxels,
+        &squaredDistances,
+        &vertices,
+        &triangles,
+        &grid,
+        DISTANCE_FIELD_NARROW_BAND
+    };
+
+    MProgressWindow::setProgressRange(0, voxelsPerEdge[0]);
+    MProgressWindow::setProgress(0);
+    MThreadPool::newParallelRegion(
+        Voxelizer::getDistanceRefinement,
+        (void*)&refinementTaskData
+    );
+    MThreadPool::release(); // reduce reference count incurred by opening a new parallel region
+}
+
+void Voxelizer::getDistanceTransformPass(void* data, MThreadRootTask* rootTask) {
+    const DistanceTransformTaskData* taskData = static_cast<DistanceTransformTaskData*>(data);
+    const std::array<int, 3>& voxelsPerEdge = taskData->voxelsPerEdge;
+    int axis = taskData->axis;
+    int numLines = (voxelsPerEdge[0] * voxelsPerEdge[1] * voxelsPerEdge[2]) / voxelsPerEdge[axis];
+
+    // Batch lines together so each task has a meaningful amount of work
+    constexpr int linesPerTask = 64;
+    int numTasks = Utils::divideRoundUp(numLines, linesPerTask);
+    std::vector<DistanceTransformThreadData> threadData(numTasks);
+    for (int i = 0; i < numTasks; ++i) {
+        threadData[i].taskData = taskData;
+        threadData[i].firstLine = i * linesPerTask;
+        threadData[i].numLines = std::min(linesPerTask, numLines - i * linesPerTask);
+
+        MThreadPool::createTask(Voxelizer::getDistanceTransformLines, (void*)&threadData[i], rootTask);
+    }
+    MThreadPool::executeAndJoin(rootTask);
+}
+
+MThreadRetVal Voxelizer::getDistanceTransformLines(void* data) {
+    const DistanceTransformThreadData* threadData = static_cast<DistanceTransformThreadData*>(data);
+    const DistanceTransformTaskData* taskData = threadData->taskData;
+    std::vector<float>& squaredDistances = *taskData->squaredDistances;
+    const std::array<int, 3>& voxelsPerEdge = taskData->voxelsPerEdge;
+    const std::array<int, 3> strides = { voxelsPerEdge[1] * voxelsPerEdge[2], voxelsPerEdge[2], 1 };
+
+    // The two axes perpendicular to the line direction enumerate the lines.
+    const int axis = taskData->axis;
+    const int axisU = (axis == 0) ? 1 : 0;
+    const int axisV = (axis == 2) ? 1 : 2;
+    const int n = voxelsPerEdge[axis];
+    const int stride = strides[axis];
+
+    std::vector<float> f(n);           // Input samples of the current line
+    std::vector<int> v(n);             // Locations of the parabolas in the lower envelope
+    std::vector<double> boundaries(n + 1); // Boundaries between parabolas in the lower envelope
+
+    for (int line = threadData->firstLine; line < threadData->firstLine + threadData->numLines; ++line) {
+        int u = line / voxelsPerEdge[axisV];
+        int w = line % voxelsPerEdge[axisV];
+        int base = u * strides[axisU] + w * strides[axisV];
+
+        for (int q = 0; q < n; ++q) {
+            f[q] = squaredDistances[base + q * stride];
+        }
+
+        // Build the lower envelope. Samples at "infinity" contribute no parabola, which avoids inf - inf arithmetic.
+        int k = -1;
+        for (int q = 0; q < n; ++q) {
+            if (f[q] == FLT_MAX) continue;
+            if (k < 0) {
+                k = 0;
+                v[0] = q;
+                boundaries[0] = -DBL_MAX;
+                boundaries[1] = DBL_MAX;
+                continue;
+            }
+
+            double s;
+            while (true) {
+                int p = v[k];
+                s = ((static_cast<double>(f[q]) + q * q) - (static_cast<double>(f[p]) + p * p)) / (2.0 * (q - p));
+                if (s > boundaries[k]) break;
+                --k;
+            }
+
+            ++k;
+            v[k] = q;
+            boundaries[k] = s;
+            boundaries[k + 1] = DBL_MAX;
+        }
+
+        // No surface voxels along this line (and none projected into it by earlier passes): leave it at infinity.
+        if (k < 0) continue;
+
+        k = 0;
+        for (int q = 0; q < n; ++q) {
+            while (boundaries[k + 1] < q) ++k;
+            int p = v[k];
+            squaredDistances[base + q * stride] = static_cast<float>((q - p) * (q - p) + f[p]);
+        }
+    }
+
+    return (MThreadRetVal)0;
+}
+
+void Voxelizer::getDistanceRefinement(void* data, MThreadRootTask* rootTask) {
+    const DistanceRefinementTaskData* taskData = static_cast<DistanceRefinementTaskData*>(data);
+    int numSlabs = taskData->grid->voxelsPerEdge[0];
+
+    std::vector<DistanceRefinementThreadData> threadData(numSlabs);
+    for (int x = 0; x < numSlabs; ++x) {
+        threadData[x].taskData = taskData;
+        threadData[x].x = x;
+
+        MThreadPool::createTask(Voxelizer::getDistanceRefinementSlab, (void*)&threadData[x], rootTask);
+    }
+    MThreadPool::executeAndJoin(rootTask);
+    MProgressWindow::setProgress(numSlabs);
+}
+
+MThreadRetVal Voxelizer::getDistanceRefinementSlab(void* data) {
+    const DistanceRefinementThreadData* threadData = static_cast<DistanceRefinementThreadData*>(data);
+    const DistanceRefinementTaskData* taskData = threadData->taskData;
+    Voxels& voxels = *taskData->voxels;
+    const std::vector<float>& squaredDistances = *taskData->squaredDistances;
+    const MPointArray& vertices = *taskData->vertices;
+    const std::vector<Triangle>& triangles = *taskData->triangles;
+    const double voxelSize = taskData->grid->voxelSize;
+    const std::array<int, 3>& voxelsPerEdge = taskData->grid->voxelsPerEdge;
+    const int bandWidth = taskData->bandWidth;
+    const float bandWidthSquared = static_cast<float>(bandWidth * bandWidth);
+    MPoint gridMin = -(voxelSize / 2) * MVector(voxelsPerEdge[0], voxelsPerEdge[1], voxelsPerEdge[2]);
+
+    // The closest point on the mesh to a voxel center within the band lies in a surface voxel at most
+    // (bandWidth + 1) voxels away, so that's the neighborhood we need to search.
+    const int searchRadius = bandWidth + 1;
+    const int x = threadData->x;
+    for (int y = 0; y < voxelsPerEdge[1]; ++y) {
+        for (int z = 0; z < voxelsPerEdge[2]; ++z) {
+            int index = x * voxelsPerEdge[1] * voxelsPerEdge[2] + y * voxelsPerEdge[2] + z;
+            if (!voxels.occupied[index] || squaredDistances[index] > bandWidthSquared) continue;
+
+            MPoint voxelCenter(
+                (x + 0.5) * voxelSize + gridMin.x,
+                (y + 0.5) * voxelSize + gridMin.y,
+                (z + 0.5) * voxelSize + gridMin.z
+            );
+
+            double minDistanceSquared = DBL_MAX;
+            for (int nx = std::max(0, x - searchRadius); nx <= std::min(voxelsPerEdge[0] - 1, x + searchRadius); ++nx) {
+                for (int ny = std::max(0, y - searchRadius); ny <= std::min(voxelsPerEdge[1] - 1, y + searchRadius); ++ny) {
+                    for (int nz = std::max(0, z - searchRadius); nz <= std::min(voxelsPerEdge[2] - 1, z + searchRadius); ++nz) {
+                        int neighborIndex = nx * voxelsPerEdge[1] * voxelsPerEdge[2] + ny * voxelsPerEdge[2] + nz;
+                        if (!voxels.isSurface[neighborIndex]) continue;
+
+                        for (const std::vector<int>* tris : { &voxels.containedTris[neighborIndex], &voxels.overlappingTris[neighborIndex] }) {
+                            for (int triIdx : *tris) {
+                                const Triangle& tri = triangles[triIdx];
+                                minDistanceSquared = std::min(minDistanceSquared, pointTriangleDistanceSquared(
+                                    voxelCenter, vertices[tri.indices[0]], vertices[tri.indices[1]], vertices[tri.indices[2]]
+                                ));
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (minDistanceSquared == DBL_MAX) continue;
+            voxels.distanceToSurface[index] = static_cast<float>(std::sqrt(minDistanceSquared));
+        }
+    }
+
+    return (MThreadRetVal)0;
+}
+
+double Voxelizer::pointTriangleDistanceSquared(
+    const MPoint& p,
+    const MPoint& a,
+    const MPoint& b,
+    const MPoint& c
+) {
+    // Determine which Voronoi region of the triangle p lies in, and project accordingly.
+    MVector ab = b - a;
+    MVector ac = c - a;
+    MVector ap = p - a;
+    double d1 = ab * ap;
+    double d2 = ac * ap;
+    if (d1 <= 0.0 && d2 <= 0.0) return (p - a) * (p - a);
+
+    MVector bp = p - b;
+    double d3 = ab * bp;
+    double d4 = ac * bp;
+    if (d3 >= 0.0 && d4 <= d3) return (p - b) * (p - b);
+
+    double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+        MPoint closest = a + (d1 / (d1 - d3)) * ab;
+        return (p - closest) * (p - closest);
+    }
+
+    MVector cp = p - c;
+    double d5 = ab * cp;
+    double d6 = ac * cp;
+    if (d6 >= 0.0 && d5 <= d6) return (p - c) * (p - c);
+
+    double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+        MPoint closest = a + (d2 / (d2 - d6)) * ac;
+        return (p - closest) * (p - closest);
+    }
+
+    double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0) {
+        MPoint closest = b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+        return (p - closest) * (p - closest);
+    }
+
+    // Inside the face region
+    double denom = 1.0 / (va + vb + vc);
+    MPoint closest = a + ab * (vb * denom) + ac * (vc * denom);
+    return (p - closest) * (p - closest);
+}
+
 MStatus Voxelizer::prepareForAndDoVoxelIntersection(
     Voxels& voxels,      
     MFnMesh& originalMesh,
@@ -400,7 +858,9 @@ MStatus Voxelizer::prepareForAndDoVoxelIntersection(
     const MString& newMeshName,
     const MMatrix& gridTransform,
     bool doBoolean,
-    bool clipTriangles
+    bool clipTriangles,
+    const FastWindingNumber* windingNumber,
+    const VoxelizationGrid& grid
 ) 
 {
     // Prepare for boolean operations
@@ -413,16 +873,17 @@ MStatus Voxelizer::prepareForAndDoVoxelIntersection(
     Tree aabbTree(originalMeshCGAL.faces().first, originalMeshCGAL.faces().second, originalMeshCGAL);
     SideTester sideTester(aabbTree);
 
-    if (!CGAL::is_closed(originalMeshCGAL)) {
-        MGlobal::displayError("Input mesh must be water tight.");
+    // With the winding number, holes and self-intersections are tolerated (and the SideTester goes unused).
+    if (!windingNumber && !CGAL::is_closed(originalMeshCGAL)) {
+        MGlobal::displayError("Input mesh must be water tight. (Try the winding number interior option for meshes with holes.)");
         return MStatus::kFailure;
     }
     if (!CGAL::is_valid_polygon_mesh(originalMeshCGAL)) {
         MGlobal::displayError("Invalid mesh - try checking for and resolving non-manifold geometry.");
         return MStatus::kFailure;
     }
-    if (CGAL::Polygon_mesh_processing::does_self_intersect(originalMeshCGAL)) {
-        MGlobal::displayError("Input mesh self-intersects.");
+    if (!windingNumber && CGAL::Polygon_mesh_processing::does_self_intersect(originalMeshCGAL)) {
+        MGlobal::displayError("Input mesh self-intersects. (Try the winding number interior option for meshes with overlaps.)");
         return MStatus::kFailure;
     }
 
@@ -440,10 +901,13 @@ MStatus Voxelizer::prepareForAndDoVoxelIntersection(
         &originalVertices,
         &meshTris,
         &sideTester,
+        windingNumber,
         &gridTransform,
         doBoolean,
         clipTriangles,
-        newMeshName
+        newMeshName,
+        &intersectionCaches[newMeshName],
+        hashVoxelizationInputs(grid, originalMesh, clipTriangles, windingNumber != nullptr)
     };
 
     MProgressWindow::setProgressRange(0, voxels.numOccupied);
@@ -554,6 +1018,7 @@ Voxels Voxelizer::sortVoxelsByMortonCode(const Voxels& voxels) {
 
     for (size_t i = 0; i < voxels.numOccupied; ++i) {
         sortedVoxels.isSurface[i] = voxels.isSurface[voxelIndices[i]];
+        sortedVoxels.distanceToSurface[i] = voxels.distanceToSurface[voxelIndices[i]];
         sortedVoxels.modelMatrices[i] = voxels.modelMatrices[voxelIndices[i]];
         sortedVoxels.mortonCodes[i] = voxels.mortonCodes[voxelIndices[i]];
         sortedVoxels.mortonCodesToSortedIdx[voxels.mortonCodes[voxelIndices[i]]] = static_cast<uint32_t>(i);
@@ -577,6 +1042,7 @@ void Voxelizer::getVoxelMeshIntersection(void* data, MThreadRootTask* rootTask)
     std::vector<MIntArray> polyCountsAfterIntersection(voxels->numOccupied);
     std::vector<MIntArray> polyConnectsAfterIntersection(voxels->numOccupied);
     std::vector<int> numSurfaceFacesAfterIntersection(voxels->numOccupied, 0);
+    std::vector<uint64_t> intersectionKeys(voxels->numOccupied, 0);
     const MObjectArray& surfaceFaceComponents = voxels->surfaceFaceComponents;
     const MObjectArray& interiorFaceComponents = voxels->interiorFaceComponents;
 
@@ -588,6 +1054,7 @@ void Voxelizer::getVoxelMeshIntersection(void* data, MThreadRootTask* rootTask)
         threadData[i].polyCountsAfterIntersection = &polyCountsAfterIntersection;
         threadData[i].polyConnectsAfterIntersection = &polyConnectsAfterIntersection;
         threadData[i].numSurfaceFacesAfterIntersection = &numSurfaceFacesAfterIntersection;
+        threadData[i].intersectionKeys = &intersectionKeys;
 
         MThreadPool::createTask(Voxelizer::getSingleVoxelMeshIntersection, (void *)&threadData[i], rootTask);
 
@@ -600,6 +1067,21 @@ void Voxelizer::getVoxelMeshIntersection(void* data, MThreadRootTask* rootTask)
     MProgressWindow::setProgress(voxels->numOccupied);
     threadData.clear();
 
+    // Replace this mesh's cached results with those of the current voxelization (before the per-voxel arrays are freed below).
+    // Note: the previous cache is still referenced by taskData, so build the new one separately and swap it in.
+    VoxelIntersectionCache newResults;
+    for (int i = 0; i < voxels->numOccupied; ++i) {
+        if (intersectionKeys[i] == 0) continue;
+
+        newResults[intersectionKeys[i]] = VoxelIntersectionResult {
+            meshPointsAfterIntersection[i],
+            polyCountsAfterIntersection[i],
+            polyConnectsAfterIntersection[i],
+            numSurfaceFacesAfterIntersection[i]
+        };
+    }
+    intersectionCaches[newMeshName] = std::move(newResults);
+
     // Merge together all the mesh points, poly counts, and poly connects into one mesh
     // Also, build the face components for surface and interior faces (for the whole mesh), and a face component per voxel.
     MPointArray allMeshPoints;
@@ -690,6 +1172,7 @@ MThreadRetVal Voxelizer::getSingleVoxelMeshIntersection(void* threadData) {
     // (Because consumers of the voxelization data expect world space transforms)
     MMatrix& modelMatrix = voxels->modelMatrices[voxelIndex];
     SurfaceMesh cube = CGALHelper::cube(modelMatrix);
+    MMatrix localModelMatrix = modelMatrix;
     modelMatrix = modelMatrix * gridTransform;
 
     // In this case, we just return the points of the cube without intersection.
@@ -708,6 +1191,26 @@ MThreadRetVal Voxelizer::getSingleVoxelMeshIntersection(void* threadData) {
         return (MThreadRetVal)0;
     }
 
+    // If nothing this voxel's boolean depends on has changed since the last voxelization of this mesh, reuse that result.
+    uint64_t key = hashVoxelIntersectionInputs(
+        taskData->voxelizationHash,
+        localModelMatrix,
+        voxels->containedTris[voxelIndex],
+        voxels->overlappingTris[voxelIndex],
+        *taskData->originalVertices,
+        *taskData->triangles
+    );
+    (*data->intersectionKeys)[voxelIndex] = key;
+
+    auto previousResult = taskData->previousResults->find(key);
+    if (previousResult != taskData->previousResults->end()) {
+        meshPointsAfterIntersection = previousResult->second.points;
+        polyCountsAfterIntersection = previousResult->second.polyCounts;
+        polyConnectsAfterIntersection = previousResult->second.polyConnects;
+        numSurfaceFacesAfterIntersection = previousResult->second.numSurfaceFaces;
+        return (MThreadRetVal)0;
+    }
+
     // Each voxel tracks triangles that are contained within it and triangles that just overlap it. 
     // For the boolean intersection, we want the union of these two sets. Then convert this subset of the original mesh to a CGAL SurfaceMesh.
     std::vector<int> originalMeshTriIndices;
@@ -726,7 +1229,8 @@ MThreadRetVal Voxelizer::getSingleVoxelMeshIntersection(void* threadData) {
         originalMeshPiece,
         cube,
         taskData->sideTester,
-        taskData->clipTriangles
+        taskData->clipTriangles,
+        taskData->windingNumber
     );
     
     // If we're not clipping triangles, the originalMeshPiece should be reduced to only the triangles
@@ -760,4 +1264,58 @@ MThreadRetVal Voxelizer::getSingleVoxelMeshIntersection(void* threadData) {
     );
 
     return (MThreadRetVal)0;
-}
\ No newline at end of file
+}
+
+uint64_t Voxelizer::hashVoxelizationInputs(
+    const VoxelizationGrid& grid,
+    const MFnMesh& originalMesh,
+    bool clipTriangles,
+    bool useWindingNumber
+) {
+    uint64_t hash = Utils::hashBytes(&grid.voxelSize, sizeof(grid.voxelSize));
+    hash = Utils::hashBytes(grid.voxelsPerEdge.data(), sizeof(grid.voxelsPerEdge), hash);
+    MMatrix gridMatrix = grid.gridTransform.asMatrix();
+    hash = Utils::hashBytes(gridMatrix.matrix, sizeof(gridMatrix.matrix), hash);
+    uint8_t flags = (clipTriangles ? 1 : 0) | (useWindingNumber ? 2 : 0);
+    hash = Utils::hashBytes(&flags, sizeof(flags), hash);
+
+    // A different source mesh voxelized into the same output name shouldn't match, even if it happens to have the same geometry.
+    MString sourceMeshId = MFnDependencyNode(originalMesh.object()).uuid().asString();
+    hash = Utils::hashBytes(sourceMeshId.asChar(), sourceMeshId.length(), hash);
+
+    return hash;
+}
+
+uint64_t Voxelizer::hashVoxelIntersectionInputs(
+    uint64_t voxelizationHash,
+    const MMatrix& voxelModelMatrix,
+    const std::vector<int>& containedTris,
+    const std::vector<int>& overlappingTris,
+    const MPointArray& vertices,
+    const std::vector<Triangle>& triangles
+) {
+    // The model matrix captures both the voxel's grid-local position and the voxel size.
+    uint64_t hash = Utils::hashBytes(voxelModelMatrix.matrix, sizeof(voxelModelMatrix.matrix), voxelizationHash);
+
+    // Hash positions rather than vertex indices, so that moved vertices invalidate the voxels they touch (and only those).
+    // The triangle counts separate the contained and overlapping sets (which are treated differently when not clipping).
+    for (const std::vector<int>* tris : { &containedTris, &overlappingTris }) {
+        size_t numTris = tris->size();
+        hash = Utils::hashBytes(&numTris, sizeof(numTris), hash);
+        for (int triIdx : *tris) {
+            for (int vertIdx : triangles[triIdx].indices) {
+                const MPoint& vertex = vertices[vertIdx];
+                double position[3] = { vertex.x, vertex.y, vertex.z };
+                hash = Utils::hashBytes(position, sizeof(position), hash);
+            }
+        }
+    }
+
+    // 0 is reserved for "no boolean needed"
+    return (hash == 0) ? 1 : hash;
+}
+
+void Voxelizer::onNodeRemoved(MObject& node, void* clientData) {
+    if (intersectionCaches.empty()) return;
+    intersectionCaches.erase(MFnDependencyNode(node).name());
+}
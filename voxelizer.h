@@ -12,6 +12,7 @@
 #include <unordered_map>
 
 #include "utils.h"
+#include "windingnumber.h"
 #include <maya/MThreadPool.h>
 #include <maya/MFnSingleIndexedComponent.h>
 
@@ -47,6 +48,10 @@ struct Triangle {
     double d_ei_xz[3];   // Edge distances for the xz plane
     double d_ei_yz[3];   // Edge distances for the yz plane
     double d_ei_yz_solid[3]; // Edge distances for the yz plane (for solid voxelization)
+    // Derived values used in the thin (6-separating) surface voxelization
+    int dominantAxis;        // Axis along which the normal has its largest component; the 2D test is done in the plane perpendicular to it
+    double planeD;           // Plane equation offset (n · p + planeD = 0 on the triangle's plane)
+    double d_ei_thin[3];     // Edge distances for the dominant plane, relative to the voxel center's 2D "diamond"
 };
 
 struct VoxelizationGrid {
@@ -58,6 +63,7 @@ struct VoxelizationGrid {
 struct Voxels {
     std::vector<bool> occupied;             // Contains some part (surface or interior) of the underlying mesh
     std::vector<uint> isSurface;            // Use uints instead of bools because vector<bool> packs bools into bits, which will not work for GPU access.
+    std::vector<float> distanceToSurface;   // Distance from the voxel center to the mesh surface (world units, i.e. already scaled by voxelSize). Exact within the refined narrow band, voxel-center EDT elsewhere. Zero unless requested (-t 0x80).
     MMatrixArray modelMatrices;             // Model matrix for each voxel - aside from size and position, this array is directly used to instance voxels in voxelsubsceneoverride
     std::vector<uint32_t> mortonCodes;
     // Answers the question: for a given voxel morton code, what is the index of the corresponding voxel in the sorted array of voxels?
@@ -78,6 +84,7 @@ struct Voxels {
     Voxels(const Voxels& other)
         : occupied(other.occupied),
           isSurface(other.isSurface),
+          distanceToSurface(other.distanceToSurface),
           modelMatrices(other.modelMatrices),
           mortonCodes(other.mortonCodes),
           mortonCodesToSortedIdx(other.mortonCodesToSortedIdx),
@@ -97,6 +104,7 @@ struct Voxels {
         if (this != &other) {
             occupied = other.occupied;
             isSurface = other.isSurface;
+            distanceToSurface = other.distanceToSurface;
             modelMatrices = other.modelMatrices;
             mortonCodes = other.mortonCodes;
             mortonCodesToSortedIdx = other.mortonCodesToSortedIdx;
@@ -117,6 +125,7 @@ struct Voxels {
     Voxels(Voxels&& other) noexcept
         : occupied(std::move(other.occupied)),
           isSurface(std::move(other.isSurface)),
+          distanceToSurface(std::move(other.distanceToSurface)),
           modelMatrices(std::move(other.modelMatrices)),
           mortonCodes(std::move(other.mortonCodes)),
           mortonCodesToSortedIdx(std::move(other.mortonCodesToSortedIdx)),
@@ -137,6 +146,7 @@ struct Voxels {
         _size = size;
         occupied.resize(size, false);
         isSurface.resize(size, false);
+        distanceToSurface.resize(size, 0.0f);
         modelMatrices.setLength(size);
         interiorFaceComponents.setLength(size);
         surfaceFaceComponents.setLength(size);
@@ -146,12 +156,31 @@ struct Voxels {
     }
 };
 
+// The result of a single voxel's boolean intersection with the mesh. Cached between voxelizations of the same mesh so that,
+// after a local edit, voxels whose inputs didn't change can be spliced back in instead of recomputed.
+struct VoxelIntersectionResult {
+    MPointArray points;
+    MIntArray polyCounts;
+    MIntArray polyConnects;
+    int numSurfaceFaces = 0;
+};
+// Keyed by a hash of everything the intersection depends on (see Voxelizer::hashVoxelIntersectionInputs)
+using VoxelIntersectionCache = std::unordered_map<uint64_t, VoxelIntersectionResult>;
+
 class Voxelizer {
 
 public:
     Voxelizer() = default;
     ~Voxelizer() = default;
 
+    // Drops every cached boolean result. Called on scene new / open and when the plugin unloads.
+    static void clearIntersectionCaches() {
+        intersectionCaches.clear();
+    }
+
+    // Node removed callback (see plugin.cpp): drops the cached results of a voxelized mesh when it's deleted.
+    static void onNodeRemoved(MObject& node, void* clientData);
+
     Voxels voxelizeSelectedMesh(
         const VoxelizationGrid& grid,
         const MDagPath& selectedMeshDagPath,
@@ -159,6 +188,10 @@ public:
         bool voxelizeInterior,
         bool doBoolean,
         bool clipTriangles,
+        bool computeDistances,
+        bool refineDistanceField,
+        bool useWindingNumber,
+        bool thinSurface,
         MStatus& status
     );
 
@@ -173,12 +206,13 @@ private:
         double voxelSize                         // edge length of a single voxel
     );
     
-    // Does a conservative surface voxelization
+    // Does a conservative surface voxelization, or a thin (6-separating) one if thinSurface is set.
     void getSurfaceVoxels(
         const std::vector<Triangle>& triangles, // triangles to check against
         const VoxelizationGrid& grid,           // grid parameters
         Voxels& voxels,
-        const MFnMesh& selectedMesh
+        const MFnMesh& selectedMesh,
+        bool thinSurface
     );
 
     // Does an interior voxelization
@@ -189,11 +223,43 @@ private:
         const MFnMesh& selectedMesh             // the original mesh to use for boolean operations
     );
 
+    // Does an interior voxelization by thresholding the generalized winding number at each voxel center.
+    // Unlike the parity fill above, this tolerates holes, overlaps and self-intersections in the input mesh.
+    void getInteriorVoxelsWindingNumber(
+        const FastWindingNumber& windingNumber,
+        const VoxelizationGrid& grid,
+        Voxels& voxels
+    );
+
+    // Payload for the winding number classification. One task per x-slab of the grid.
+    struct WindingNumberTaskData {
+        const FastWindingNumber* windingNumber;
+        const VoxelizationGrid* grid;
+        std::vector<uint8_t>* isInside;  // Not vector<bool>: threads write neighboring elements concurrently
+    };
+
+    struct WindingNumberThreadData {
+        const WindingNumberTaskData* taskData;
+        int x;
+    };
+
+    static void getWindingNumberClassification(void* taskData, MThreadRootTask* rootTask);
+    static MThreadRetVal getWindingNumberClassificationSlab(void* threadData);
+
     bool doesTriangleOverlapVoxel(
         const Triangle& triangle,  // triangle to check against
         const MVector& voxelMin    // min corner of the voxel
     );
 
+    // 6-separating test: the triangle must cross the voxel's center line along the dominant axis, 
+    // and its projection onto the dominant plane must overlap the voxel's 2D diamond. (Schwarz & Seidel, section 3.2)
+    // The tested region is contained in the voxel, so this passing implies doesTriangleOverlapVoxel passes.
+    bool doesTriangleOverlapVoxelThin(
+        const Triangle& triangle,  // triangle to check against
+        const MVector& voxelMin,   // min corner of the voxel
+        double voxelSize
+    );
+
     bool doesTriangleOverlapVoxelCenter(
         const Triangle& triangle,     // triangle to check against
         const MVector& voxelCenterYZ  // YZ coords of the voxel column center
@@ -220,6 +286,58 @@ private:
         const VoxelizationGrid& grid
     );
 
+    // Computes the distance from each occupied voxel to the mesh surface via an exact Euclidean distance transform
+    // over the voxel grid (separable passes, one thread task per chunk of grid lines). Optionally refines voxels
+    // within a narrow band of the surface with exact point-triangle distances.
+    void computeDistanceField(
+        const std::vector<Triangle>& triangles,
+        const VoxelizationGrid& grid,
+        Voxels& voxels,
+        const MFnMesh& selectedMesh,
+        bool refineNarrowBand
+    );
+
+    // Squared distance from a point to a triangle (closest point on triangle, see Ericson's Real-Time Collision Detection 5.1.5)
+    static double pointTriangleDistanceSquared(
+        const MPoint& p,
+        const MPoint& a,
+        const MPoint& b,
+        const MPoint& c
+    );
+
+    // Payload for one pass (one axis) of the separable distance transform.
+    struct DistanceTransformTaskData {
+        std::vector<float>* squaredDistances;  // Dense grid, updated in place
+        std::array<int, 3> voxelsPerEdge;
+        int axis;                              // The axis along which each grid line runs (0 = x, 1 = y, 2 = z)
+    };
+
+    struct DistanceTransformThreadData {
+        const DistanceTransformTaskData* taskData;
+        int firstLine;
+        int numLines;
+    };
+
+    // Payload for the narrow band refinement. One task per x-slab of the grid.
+    struct DistanceRefinementTaskData {
+        Voxels* voxels;
+        const std::vector<float>* squaredDistances;
+        const MPointArray* vertices;
+        const std::vector<Triangle>* triangles;
+        const VoxelizationGrid* grid;
+        int bandWidth;                          // In voxels
+    };
+
+    struct DistanceRefinementThreadData {
+        const DistanceRefinementTaskData* taskData;
+        int x;
+    };
+
+    static void getDistanceTransformPass(void* taskData, MThreadRootTask* rootTask);
+    static MThreadRetVal getDistanceTransformLines(void* threadData);
+    static void getDistanceRefinement(void* taskData, MThreadRootTask* rootTask);
+    static MThreadRetVal getDistanceRefinementSlab(void* threadData);
+
     // Sorts the voxels by their Morton code, which helps later on with efficient GPU memory access.
     Voxels sortVoxelsByMortonCode(
         const Voxels& voxels
@@ -236,19 +354,48 @@ private:
         const MString& newMeshName,
         const MMatrix& gridTransform,
         bool doBoolean,
-        bool clipTriangles
+        bool clipTriangles,
+        const FastWindingNumber* windingNumber, // If non-null, used for inside/outside tests instead of CGAL (and the mesh isn't required to be closed)
+        const VoxelizationGrid& grid
+    );
+
+    // Hashes what every voxel's boolean result depends on, used as the seed for the per-voxel keys: the grid parameters, the options,
+    // and the identity of the source mesh (so a different mesh voxelized into the same output name never matches).
+    static uint64_t hashVoxelizationInputs(
+        const VoxelizationGrid& grid,
+        const MFnMesh& originalMesh,
+        bool clipTriangles,
+        bool useWindingNumber
     );
 
+    // Hashes the grid-local positions of a voxel and of its contributing triangles, on top of the voxelization's hash.
+    // Only the geometry touching the voxel goes in, so a local edit only invalidates the voxels around it.
+    static uint64_t hashVoxelIntersectionInputs(
+        uint64_t voxelizationHash,
+        const MMatrix& voxelModelMatrix,   // grid-local
+        const std::vector<int>& containedTris,
+        const std::vector<int>& overlappingTris,
+        const MPointArray& vertices,
+        const std::vector<Triangle>& triangles
+    );
+
+    // Boolean results from the last voxelization of each mesh (by voxelized mesh name). Only the most recent voxelization of a given mesh is kept,
+    // and it's dropped when that mesh is deleted (see onNodeRemoved) or the scene changes.
+    inline static std::unordered_map<MString, VoxelIntersectionCache, Utils::MStringHash, Utils::MStringEq> intersectionCaches;
+
     // Payload for the function that sets up all threads.
     struct VoxelIntersectionTaskData {
         Voxels* voxels;
         const MPointArray* const originalVertices;
         const std::vector<Triangle>* const triangles;
         const SideTester* const sideTester;
+        const FastWindingNumber* const windingNumber;
         const MMatrix* const gridTransform;
         bool doBoolean;
         bool clipTriangles;
         MString newMeshName;
+        const VoxelIntersectionCache* previousResults; // From the last voxelization of this mesh (may be empty)
+        uint64_t voxelizationHash;                     // See hashVoxelizationInputs
     };
 
     struct VoxelIntersectionThreadData {
@@ -258,6 +405,7 @@ private:
         std::vector<MIntArray>* polyCountsAfterIntersection;
         std::vector<MIntArray>* polyConnectsAfterIntersection;
         std::vector<int>* numSurfaceFacesAfterIntersection;
+        std::vector<uint64_t>* intersectionKeys;        // Per voxel cache key (0 for voxels that don't need a boolean)
         int threadIdx;
     };
 
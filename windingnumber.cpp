@@ -0,0 +1,145 @@
+#include "windingnumber.h"
+#include "voxelizer.h" // needed for Triangle type definition
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cfloat>
+
+FastWindingNumber::FastWindingNumber(const MPointArray& vertices, const std::vector<Triangle>& triangles) {
+    int numTriangles = static_cast<int>(triangles.size());
+    triangleVertices.resize(numTriangles);
+    triangleCentroids.resize(numTriangles);
+    triangleAreaNormals.resize(numTriangles);
+
+    for (int i = 0; i < numTriangles; ++i) {
+        const std::array<int, 3>& indices = triangles[i].indices;
+        triangleVertices[i] = { vertices[indices[0]], vertices[indices[1]], vertices[indices[2]] };
+        const std::array<MPoint, 3>& v = triangleVertices[i];
+
+        triangleCentroids[i] = MPoint((MVector(v[0]) + MVector(v[1]) + MVector(v[2])) / 3.0);
+        // Half the cross product is the normal scaled by the triangle's area
+        triangleAreaNormals[i] = 0.5 * ((v[1] - v[0]) ^ (v[2] - v[0]));
+    }
+
+    triangleOrder.resize(numTriangles);
+    std::iota(triangleOrder.begin(), triangleOrder.end(), 0);
+    if (numTriangles == 0) return;
+
+    nodes.reserve(2 * Utils::divideRoundUp(numTriangles, maxTrianglesPerLeaf));
+    buildNode(0, numTriangles);
+}
+
+int FastWindingNumber::buildNode(int first, int count) {
+    int nodeIdx = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+
+    // Compute bounds and dipole over this node's triangles.
+    Node node;
+    node.boundsMin = MPoint(DBL_MAX, DBL_MAX, DBL_MAX);
+    node.boundsMax = MPoint(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+    MVector weightedCentroidSum;
+    double totalArea = 0.0;
+    for (int i = first; i < first + count; ++i) {
+        int tri = triangleOrder[i];
+        for (const MPoint& v : triangleVertices[tri]) {
+            node.boundsMin = MPoint(std::min(node.boundsMin.x, v.x), std::min(node.boundsMin.y, v.y), std::min(node.boundsMin.z, v.z));
+            node.boundsMax = MPoint(std::max(node.boundsMax.x, v.x), std::max(node.boundsMax.y, v.y), std::max(node.boundsMax.z, v.z));
+        }
+
+        double area = triangleAreaNormals[tri].length();
+        weightedCentroidSum += area * MVector(triangleCentroids[tri]);
+        totalArea += area;
+        node.dipole += triangleAreaNormals[tri];
+    }
+
+    // Degenerate (zero-area) nodes fall back to the bounding box center
+    node.centroid = (totalArea > 0.0) 
+        ? MPoint(weightedCentroidSum / totalArea) 
+        : MPoint(0.5 * (MVector(node.boundsMin) + MVector(node.boundsMax)));
+
+    node.radius = 0.0;
+    for (int corner = 0; corner < 8; ++corner) {
+        MPoint cornerPoint(
+            (corner & 1) ? node.boundsMax.x : node.boundsMin.x,
+            (corner & 2) ? node.boundsMax.y : node.boundsMin.y,
+            (corner & 4) ? node.boundsMax.z : node.boundsMin.z
+        );
+        node.radius = std::max(node.radius, node.centroid.distanceTo(cornerPoint));
+    }
+
+    if (count <= maxTrianglesPerLeaf) {
+        node.firstTriangle = first;
+        node.numTriangles = count;
+        nodes[nodeIdx] = node;
+        return nodeIdx;
+    }
+
+    // Median split along the longest axis of the bounding box (by triangle centroid)
+    MVector extent = node.boundsMax - node.boundsMin;
+    int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+    int half = count / 2;
+    std::nth_element(
+        triangleOrder.begin() + first,
+        triangleOrder.begin() + first + half,
+        triangleOrder.begin() + first + count,
+        [this, axis](int a, int b) {
+            return triangleCentroids[a][axis] < triangleCentroids[b][axis];
+        }
+    );
+
+    // Note: recursion may reallocate nodes, so don't hold references into it across these calls.
+    node.left = buildNode(first, half);
+    node.right = buildNode(first + half, count - half);
+    nodes[nodeIdx] = node;
+    return nodeIdx;
+}
+
+double FastWindingNumber::windingNumber(const MPoint& queryPoint) const {
+    if (nodes.empty()) return 0.0;
+
+    constexpr double fourPi = 4.0 * 3.14159265358979323846;
+    double solidAngle = 0.0;
+
+    // Tree depth is logarithmic in the number of triangles, so a small fixed-size stack would do, but a vector keeps this safe for pathological inputs.
+    std::vector<int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+
+        MVector toCentroid = node.centroid - queryPoint;
+        double distance = toCentroid.length();
+        if (distance > accuracyScale * node.radius) {
+            // Far field: the whole node acts like a single dipole.
+            solidAngle += (node.dipole * toCentroid) / (distance * distance * distance);
+            continue;
+        }
+
+        if (node.left < 0) {
+            for (int i = node.firstTriangle; i < node.firstTriangle + node.numTriangles; ++i) {
+                solidAngle += triangleSolidAngle(queryPoint, triangleOrder[i]);
+            }
+            continue;
+        }
+
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+
+    return solidAngle / fourPi;
+}
+
+double FastWindingNumber::triangleSolidAngle(const MPoint& queryPoint, int triangleIdx) const {
+    const std::array<MPoint, 3>& v = triangleVertices[triangleIdx];
+    MVector a = v[0] - queryPoint;
+    MVector b = v[1] - queryPoint;
+    MVector c = v[2] - queryPoint;
+    double la = a.length();
+    double lb = b.length();
+    double lc = c.length();
+
+    double numerator = a * (b ^ c);
+    double denominator = la * lb * lc + (a * b) * lc + (b * c) * la + (c * a) * lb;
+    return 2.0 * std::atan2(numerator, denominator);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <maya/MPoint.h>
+#include <maya/MPointArray.h>
+#include <maya/MVector.h>
+#include <vector>
+#include <array>
+
+// Forward declarations
+struct Triangle;
+
+/**
+ * Fast generalized winding number (see Barill et al., "Fast Winding Numbers for Soups and Clouds", SIGGRAPH 2018).
+ *
+ * The generalized winding number of a point is the (normalized) signed solid angle subtended by the mesh. It is 1 inside a closed mesh and 0 outside,
+ * but unlike a parity / ray test it degrades gracefully for meshes with holes, overlaps, or self-intersections - so it can be used to classify
+ * voxels as inside or outside for meshes that would otherwise need to be cleaned up first.
+ *
+ * Triangles are grouped into a bounding volume hierarchy. Far-away nodes are approximated by a single dipole (area-weighted normal at the node's centroid),
+ * so each query touches O(log n) nodes rather than every triangle. Queries are const and can be made from multiple threads at once.
+ */
+class FastWindingNumber {
+public:
+    FastWindingNumber() = default;
+    FastWindingNumber(const MPointArray& vertices, const std::vector<Triangle>& triangles);
+    ~FastWindingNumber() = default;
+
+    double windingNumber(const MPoint& queryPoint) const;
+
+    bool isInside(const MPoint& queryPoint) const {
+        return windingNumber(queryPoint) >= 0.5;
+    }
+
+private:
+    struct Node {
+        MPoint boundsMin;
+        MPoint boundsMax;
+        MPoint centroid;       // Area-weighted centroid of the triangles under this node (dipole location)
+        MVector dipole;        // Sum of area-weighted normals of the triangles under this node
+        double radius;         // Distance from the centroid to the farthest point of the node's bounding box
+        int left = -1;         // Child node indices (-1 for leaves)
+        int right = -1;
+        int firstTriangle = 0; // Range into triangleOrder (leaves only)
+        int numTriangles = 0;
+    };
+
+    // Recursively builds the tree over triangleOrder[first, first + count), returns the index of the created node.
+    int buildNode(int first, int count);
+
+    // Exact signed solid angle of a single triangle, as seen from queryPoint (Van Oosterom and Strackee)
+    double triangleSolidAngle(const MPoint& queryPoint, int triangleIdx) const;
+
+    std::vector<Node> nodes;
+    std::vector<int> triangleOrder;            // Triangle indices, permuted so each leaf references a contiguous range
+    std::vector<std::array<MPoint, 3>> triangleVertices;
+    std::vector<MPoint> triangleCentroids;
+    std::vector<MVector> triangleAreaNormals;  // Normal scaled by triangle area
+
+    inline static constexpr int maxTrianglesPerLeaf = 8;
+    // Nodes farther than accuracyScale * radius from the query point use the dipole approximation (2 is the value suggested by the paper)
+    inline static constexpr double accuracyScale = 2.0;
+};